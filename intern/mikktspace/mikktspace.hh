@@ -8,8 +8,11 @@
  */
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <unordered_map>
+#include <vector>
 
 #ifdef WITH_TBB
 #  include <tbb/parallel_for.h>
@@ -91,13 +94,6 @@ template<typename Mesh> class Mikktspace {
       tangent = tangent.normalize();
     }
 
-    void accumulateTSpaceAtomic(float3 v_tangent)
-    {
-      float_add_atomic(&tangent.x, v_tangent.x);
-      float_add_atomic(&tangent.y, v_tangent.y);
-      float_add_atomic(&tangent.z, v_tangent.z);
-    }
-
     void accumulateTSpace(float3 v_tangent)
     {
       tangent += v_tangent;
@@ -343,26 +339,69 @@ template<typename Mesh> class Mikktspace {
    * be moved next to each other. Since there might be hash collisions, the elements of each block
    * are then compared with each other and duplicates are merged.
    */
-  template<bool isAtomic> void generateSharedVerticesIndexList_impl()
+  void generateSharedVerticesIndexListSerial()
   {
     uint numVertices = nrTriangles * 3;
-    AtomicHashSet<uint, isAtomic, VertexHash, VertexEqual> set(numVertices, {this}, {this});
-    runParallel(0u, nrTriangles, [&](uint t) {
+    AtomicHashSet<uint, false, VertexHash, VertexEqual> set(numVertices, {this}, {this});
+    for (uint t = 0; t < nrTriangles; t++) {
       for (uint i = 0; i < 3; i++) {
         auto res = set.emplace(triangles[t].vertices[i]);
         if (!res.second) {
           triangles[t].vertices[i] = res.first;
         }
       }
+    }
+  }
+
+  /* When inserting in parallel, which of the identical vertices ends up in the set depends on
+   * timing. To get the same result as the serial version, every vertex is then replaced by the
+   * identical vertex that comes first in the triangle order, which is the one that the serial
+   * version keeps. */
+  void generateSharedVerticesIndexListParallel()
+  {
+    uint numVertices = nrTriangles * 3;
+    AtomicHashSet<uint, true, VertexHash, VertexEqual> set(numVertices, {this}, {this});
+
+    /* For every vertex in the set, the first triangle corner (3 * t + i) that uses it. */
+    std::vector<std::atomic<uint>> firstCorner(size_t(nrFaces) * 4);
+    runParallel(0u, nrTriangles, [&](uint t) {
+      for (uint i = 0; i < 3; i++) {
+        const uint vertex = triangles[t].vertices[i];
+        firstCorner[vertex].store(UNSET_ENTRY, std::memory_order_relaxed);
+      }
+    });
+
+    runParallel(0u, nrTriangles, [&](uint t) {
+      for (uint i = 0; i < 3; i++) {
+        const uint vertex = set.emplace(triangles[t].vertices[i]).first;
+        triangles[t].vertices[i] = vertex;
+        const uint corner = 3 * t + i;
+        uint prevCorner = firstCorner[vertex].load(std::memory_order_relaxed);
+        while (corner < prevCorner &&
+               !firstCorner[vertex].compare_exchange_weak(
+                   prevCorner, corner, std::memory_order_relaxed))
+        {
+        }
+      }
+    });
+
+    runParallel(0u, nrTriangles, [&](uint t) {
+      for (uint i = 0; i < 3; i++) {
+        const uint corner = firstCorner[triangles[t].vertices[i]].load(std::memory_order_relaxed);
+        const Triangle &firstTriangle = triangles[corner / 3];
+        triangles[t].vertices[i] = pack_index(firstTriangle.faceIdx,
+                                              firstTriangle.faceVertex[corner % 3]);
+      }
     });
   }
+
   void generateSharedVerticesIndexList()
   {
     if (isParallel) {
-      generateSharedVerticesIndexList_impl<true>();
+      generateSharedVerticesIndexListParallel();
     }
     else {
-      generateSharedVerticesIndexList_impl<false>();
+      generateSharedVerticesIndexListSerial();
     }
   }
 
@@ -589,11 +628,6 @@ template<typename Mesh> class Mikktspace {
     };
     std::vector<Entry> entries;
 
-    NeighborShard(size_t capacity)
-    {
-      entries.reserve(capacity);
-    }
-
     void buildNeighbors(Mikktspace<Mesh> *mikk)
     {
       /* Entries are added by iterating over t, so by using a stable sort,
@@ -646,7 +680,6 @@ template<typename Mesh> class Mikktspace {
      * key go into the same shard.
      * This is done by hashing the key to get the shard index of each vertex.
      */
-    // TODO: Two-step filling that first counts and then fills? Could be parallel then.
     uint targetNrShards = isParallel ? uint(4 * nrThreads) : 1;
     uint nrShards = 1, hashShift = 32;
     while (nrShards < targetNrShards) {
@@ -654,23 +687,52 @@ template<typename Mesh> class Mikktspace {
       hashShift -= 1;
     }
 
-    /* Reserve 25% extra to account for variation due to hashing. */
-    size_t reserveSize = size_t(double(3 * nrTriangles) * 1.25 / nrShards);
-    std::vector<NeighborShard> shards(nrShards, {reserveSize});
+    auto edgeHash = [&](const Triangle &triangle, const uint i) {
+      const uint i0 = triangle.vertices[i];
+      const uint i1 = triangle.vertices[(i != 2) ? (i + 1) : 0];
+      const uint high = std::max(i0, i1), low = std::min(i0, i1);
+      return hash_uint3(high, low, 0);
+    };
+    /* TODO: Reusing the hash here means less hash space inside each shard.
+     * Computing a second hash with a different seed it probably not worth it? */
+    auto edgeShard = [&](const uint hash) { return isParallel ? (hash >> hashShift) : 0; };
+
+    /* The shards are filled in two steps: first the entries of every chunk of triangles are
+     * counted per shard, then all chunks are written in parallel. This way the entries in every
+     * shard are still ordered by triangle like when filling them serially. */
+    const uint nrChunks = isParallel ? uint(4 * nrThreads) : 1;
+    const uint chunkSize = (nrTriangles + nrChunks - 1) / nrChunks;
+    std::vector<uint> chunkOffsets(size_t(nrChunks) * nrShards, 0);
+    runParallel(0u, nrChunks, [&](uint c) {
+      uint *counts = &chunkOffsets[size_t(c) * nrShards];
+      for (uint t = c * chunkSize; t < std::min(nrTriangles, (c + 1) * chunkSize); t++) {
+        for (uint i = 0; i < 3; i++) {
+          counts[edgeShard(edgeHash(triangles[t], i))]++;
+        }
+      }
+    });
 
-    for (uint t = 0; t < nrTriangles; t++) {
-      Triangle &triangle = triangles[t];
-      for (uint i = 0; i < 3; i++) {
-        const uint i0 = triangle.vertices[i];
-        const uint i1 = triangle.vertices[(i != 2) ? (i + 1) : 0];
-        const uint high = std::max(i0, i1), low = std::min(i0, i1);
-        const uint hash = hash_uint3(high, low, 0);
-        /* TODO: Reusing the hash here means less hash space inside each shard.
-         * Computing a second hash with a different seed it probably not worth it? */
-        const uint shard = isParallel ? (hash >> hashShift) : 0;
-        shards[shard].entries.emplace_back(hash, pack_index(t, i));
+    std::vector<NeighborShard> shards(nrShards);
+    runParallel(0u, nrShards, [&](uint s) {
+      uint offset = 0;
+      for (uint c = 0; c < nrChunks; c++) {
+        const uint count = chunkOffsets[size_t(c) * nrShards + s];
+        chunkOffsets[size_t(c) * nrShards + s] = offset;
+        offset += count;
       }
-    }
+      shards[s].entries.resize(offset, {0, 0});
+    });
+
+    runParallel(0u, nrChunks, [&](uint c) {
+      uint *offsets = &chunkOffsets[size_t(c) * nrShards];
+      for (uint t = c * chunkSize; t < std::min(nrTriangles, (c + 1) * chunkSize); t++) {
+        for (uint i = 0; i < 3; i++) {
+          const uint hash = edgeHash(triangles[t], i);
+          const uint shard = edgeShard(hash);
+          shards[shard].entries[offsets[shard]++] = {hash, pack_index(t, i)};
+        }
+      }
+    });
 
     runParallel(0u, nrShards, [&](uint s) { shards[s].buildNeighbors(this); });
   }
@@ -760,12 +822,14 @@ template<typename Mesh> class Mikktspace {
   ///////////////////////////////////////////////////////////////////////////////////////////////////
   ///////////////////////////////////////////////////////////////////////////////////////////////////
 
-  template<bool atomic> void accumulateTSpaces(uint t)
+  /* Computes the contribution of every vertex of the triangle to the tangent of its group. */
+  std::array<float3, 3> calcTSpaceContributions(uint t)
   {
     const Triangle &triangle = triangles[t];
+    std::array<float3, 3> contributions = {float3(0.0f), float3(0.0f), float3(0.0f)};
     // only valid triangles get to add their contribution
     if (triangle.groupWithAny) {
-      return;
+      return contributions;
     }
 
     /* TODO: Vectorize?
@@ -782,54 +846,68 @@ template<typename Mesh> class Mikktspace {
                                  dot(project(n[2], p[0] - p[2]), project(n[2], p[1] - p[2]))};
 
     for (uint i = 0; i < 3; i++) {
-      uint groupId = triangle.group[i];
-      if (groupId != UNSET_ENTRY) {
-        float3 tangent = project(n[i], triangle.tangent) *
-                         fast_acosf(std::clamp(fCos[i], -1.0f, 1.0f));
-        if constexpr (atomic) {
-          groups[groupId].accumulateTSpaceAtomic(tangent);
-        }
-        else {
-          groups[groupId].accumulateTSpace(tangent);
-        }
+      if (triangle.group[i] != UNSET_ENTRY) {
+        contributions[i] = project(n[i], triangle.tangent) *
+                           fast_acosf(std::clamp(fCos[i], -1.0f, 1.0f));
       }
     }
+    return contributions;
   }
 
   void generateTSpaces()
   {
-    if (isParallel) {
-      runParallel(0u, nrTriangles, [&](uint t) { accumulateTSpaces<true>(t); });
-    }
-    else {
-      for (uint t = 0; t < nrTriangles; t++) {
-        accumulateTSpaces<false>(t);
+    /* The contributions are computed in parallel, but they are added to the groups in triangle
+     * order, so that the result does not depend on the number of threads. This is done in blocks
+     * to limit the memory used by the temporary contributions. */
+    const uint blockSize = 1u << 16;
+    std::vector<std::array<float3, 3>> contributions(std::min(nrTriangles, blockSize));
+    for (uint blockStart = 0; blockStart < nrTriangles; blockStart += blockSize) {
+      const uint blockEnd = std::min(nrTriangles, blockStart + blockSize);
+      runParallel(blockStart, blockEnd, [&](uint t) {
+        contributions[t - blockStart] = calcTSpaceContributions(t);
+      });
+      for (uint t = blockStart; t < blockEnd; t++) {
+        const Triangle &triangle = triangles[t];
+        if (triangle.groupWithAny) {
+          continue;
+        }
+        for (uint i = 0; i < 3; i++) {
+          const uint groupId = triangle.group[i];
+          if (groupId != UNSET_ENTRY) {
+            groups[groupId].accumulateTSpace(contributions[t - blockStart][i]);
+          }
+        }
       }
     }
 
-    /* TODO: Worth parallelizing? Probably not. */
-    for (Group &group : groups) {
-      group.normalizeTSpace();
-    }
+    runParallel(0u, uint(groups.size()), [&](uint g) { groups[g].normalizeTSpace(); });
 
     tSpaces.resize(nrTSpaces);
 
-    for (uint t = 0; t < nrTriangles; t++) {
-      Triangle &triangle = triangles[t];
-      for (uint i = 0; i < 3; i++) {
-        uint groupId = triangle.group[i];
-        if (groupId == UNSET_ENTRY) {
-          continue;
-        }
-        const Group group = groups[groupId];
-        assert(triangle.orientPreserving == group.orientPreserving);
+    /* The triangles of a quad write to the same tangent spaces, so they are handled together.
+     * The good triangles of a face are always next to each other. */
+    runParallel(0u, nrTriangles, [&](uint t) {
+      if (t > 0 && triangles[t - 1].faceIdx == triangles[t].faceIdx) {
+        return;
+      }
+      const uint faceIdx = triangles[t].faceIdx;
+      for (uint tFace = t; tFace < nrTriangles && triangles[tFace].faceIdx == faceIdx; tFace++) {
+        const Triangle &triangle = triangles[tFace];
+        for (uint i = 0; i < 3; i++) {
+          uint groupId = triangle.group[i];
+          if (groupId == UNSET_ENTRY) {
+            continue;
+          }
+          const Group &group = groups[groupId];
+          assert(triangle.orientPreserving == group.orientPreserving);
 
-        // output tspace
-        const uint offset = triangle.tSpaceIdx;
-        const uint faceVertex = triangle.faceVertex[i];
-        tSpaces[offset + faceVertex].accumulateGroup(group);
+          // output tspace
+          const uint offset = triangle.tSpaceIdx;
+          const uint faceVertex = triangle.faceVertex[i];
+          tSpaces[offset + faceVertex].accumulateGroup(group);
+        }
       }
-    }
+    });
   }
 };
 
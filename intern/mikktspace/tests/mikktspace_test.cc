@@ -0,0 +1,170 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include <cstring>
+#include <vector>
+
+#ifdef WITH_TBB
+#  include <tbb/task_arena.h>
+#endif
+
+#include "BLI_sys_types.h"
+#include "BLI_utildefines.h"
+
+#include "mikktspace.hh"
+
+#include "testing/testing.h"
+
+namespace mikk::tests {
+
+/* Simple face-corner mesh that implements the interface expected by #Mikktspace. */
+struct TestMesh {
+  std::vector<uint> face_offsets = {0};
+  std::vector<float3> corner_positions;
+  std::vector<float3> corner_normals;
+  std::vector<float3> corner_uvs;
+
+  struct TangentSpace {
+    float3 tangent;
+    bool orientation;
+  };
+  std::vector<TangentSpace> corner_tangents;
+
+  uint GetNumFaces()
+  {
+    return uint(face_offsets.size() - 1);
+  }
+
+  uint GetNumVerticesOfFace(const uint face_num)
+  {
+    return face_offsets[face_num + 1] - face_offsets[face_num];
+  }
+
+  float3 GetPosition(const uint face_num, const uint vert_num)
+  {
+    return corner_positions[face_offsets[face_num] + vert_num];
+  }
+
+  float3 GetNormal(const uint face_num, const uint vert_num)
+  {
+    return corner_normals[face_offsets[face_num] + vert_num];
+  }
+
+  float3 GetTexCoord(const uint face_num, const uint vert_num)
+  {
+    return corner_uvs[face_offsets[face_num] + vert_num];
+  }
+
+  void SetTangentSpace(const uint face_num, const uint vert_num, float3 T, bool orientation)
+  {
+    corner_tangents[face_offsets[face_num] + vert_num] = {T, orientation};
+  }
+};
+
+static float3 cross(const float3 &a, const float3 &b)
+{
+  return float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+static float3 grid_position(const int x, const int y)
+{
+  return float3(float(x), float(y), sinf(float(x) * 0.3f) * cosf(float(y) * 0.2f));
+}
+
+static float3 grid_normal(const int x, const int y)
+{
+  const float dx = 0.3f * cosf(float(x) * 0.3f) * cosf(float(y) * 0.2f);
+  const float dy = -0.2f * sinf(float(x) * 0.3f) * sinf(float(y) * 0.2f);
+  return float3(-dx, -dy, 1.0f).normalize();
+}
+
+/**
+ * A bumpy grid with quads and triangles, a UV seam, flat shaded faces, mirrored UVs and
+ * degenerate faces, so that all code paths are used.
+ */
+static TestMesh create_test_mesh(const int size_x, const int size_y)
+{
+  TestMesh mesh;
+  auto add_face = [&](const std::vector<std::array<int, 2>> &corners, const int face_index) {
+    const bool flat = face_index % 13 == 0;
+    const bool mirror = face_index % 29 == 0;
+    const float3 face_normal = cross(grid_position(corners[1][0], corners[1][1]) -
+                                         grid_position(corners[0][0], corners[0][1]),
+                                     grid_position(corners[2][0], corners[2][1]) -
+                                         grid_position(corners[0][0], corners[0][1]))
+                                   .normalize();
+    for (const std::array<int, 2> &corner : corners) {
+      const int x = corner[0], y = corner[1];
+      mesh.corner_positions.push_back(grid_position(x, y));
+      mesh.corner_normals.push_back(flat ? face_normal : grid_normal(x, y));
+      /* Separate UV islands for the left and right half of the grid. */
+      float u = float(x) / float(size_x) + (corners[0][0] < size_x / 2 ? 0.0f : 0.5f);
+      if (mirror) {
+        u = -u;
+      }
+      mesh.corner_uvs.push_back(float3(u, float(y) / float(size_y), 1.0f));
+    }
+    mesh.face_offsets.push_back(uint(mesh.corner_positions.size()));
+  };
+
+  int face_index = 0;
+  for (int y = 0; y < size_y; y++) {
+    for (int x = 0; x < size_x; x++) {
+      if (face_index % 7 == 0) {
+        add_face({{x, y}, {x + 1, y}, {x + 1, y + 1}}, face_index++);
+        add_face({{x, y}, {x + 1, y + 1}, {x, y + 1}}, face_index++);
+      }
+      else if (face_index % 101 == 0) {
+        /* Quad with one degenerate triangle. */
+        add_face({{x, y}, {x + 1, y}, {x + 1, y + 1}, {x + 1, y + 1}}, face_index++);
+      }
+      else {
+        add_face({{x, y}, {x + 1, y}, {x + 1, y + 1}, {x, y + 1}}, face_index++);
+      }
+    }
+  }
+  mesh.corner_tangents.resize(mesh.corner_positions.size());
+  return mesh;
+}
+
+static std::vector<TestMesh::TangentSpace> calc_tangents(TestMesh mesh, const int threads_num)
+{
+  auto calc = [&]() {
+    Mikktspace<TestMesh> mikk(mesh);
+    mikk.genTangSpace();
+  };
+#ifdef WITH_TBB
+  tbb::task_arena arena(threads_num);
+  arena.execute(calc);
+#else
+  (void)threads_num;
+  calc();
+#endif
+  return mesh.corner_tangents;
+}
+
+static void expect_bit_identical(const std::vector<TestMesh::TangentSpace> &expected,
+                                 const std::vector<TestMesh::TangentSpace> &actual)
+{
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    EXPECT_EQ(std::memcmp(&expected[i].tangent, &actual[i].tangent, sizeof(float3)), 0);
+    EXPECT_EQ(expected[i].orientation, actual[i].orientation);
+  }
+}
+
+TEST(mikktspace, ParallelMatchesSerial)
+{
+  /* Enough faces to use the multi-threaded code path. */
+  const TestMesh mesh = create_test_mesh(200, 100);
+  const std::vector<TestMesh::TangentSpace> serial = calc_tangents(mesh, 1);
+  expect_bit_identical(serial, calc_tangents(mesh, 4));
+  expect_bit_identical(serial, calc_tangents(mesh, 7));
+
+  for (const TestMesh::TangentSpace &tangent_space : serial) {
+    EXPECT_NEAR(tangent_space.tangent.length(), 1.0f, 1e-4f);
+  }
+}
+
+}  // namespace mikk::tests
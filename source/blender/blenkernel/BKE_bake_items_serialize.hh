@@ -10,6 +10,8 @@
 
 #include "BKE_bake_items.hh"
 
+struct BLI_mmap_file;
+
 namespace blender::bke::bake {
 
 /**
@@ -43,6 +45,34 @@ class BlobReader {
    */
   [[nodiscard]] virtual bool read_as_stream(const BlobSlice &slice,
                                             FunctionRef<bool(std::istream &)> fn) const;
+
+  /**
+   * Get shared access to the data of the given slice without copying it. This is only supported
+   * by some readers, otherwise the data has to be copied with #read.
+   * \param alignment: Required alignment of the returned data.
+   * \return The referenced data and a new user of its owner, or none if not supported.
+   */
+  [[nodiscard]] virtual std::optional<ImplicitSharingInfoAndData> read_mapped(
+      const BlobSlice &slice, int64_t alignment) const;
+};
+
+/** Compression that is applied to blobs written with #BlobWriter::write_encoded. */
+enum class BlobCompression : int8_t {
+  None = 0,
+  Zstd = 1,
+};
+
+/**
+ * Describes the values in a blob, so that they can be transformed to compress better.
+ */
+struct BlobFilter {
+  /**
+   * Size of the scalar values the data consists of. When larger than one, the bytes with the same
+   * significance are grouped together (byte shuffle).
+   */
+  int64_t scalar_size = 1;
+  /** Store the difference between consecutive bytes, useful for slowly changing integers. */
+  bool delta = false;
 };
 
 /**
@@ -51,10 +81,16 @@ class BlobReader {
 class BlobWriter {
  protected:
   int64_t total_written_size_ = 0;
+  BlobCompression compression_ = BlobCompression::None;
 
  public:
   virtual ~BlobWriter() = default;
 
+  void set_compression(const BlobCompression compression)
+  {
+    compression_ = compression;
+  }
+
   /**
    * Write the provided binary data.
    * \return Slice where the data has been written to.
@@ -70,6 +106,14 @@ class BlobWriter {
   virtual BlobSlice write_as_stream(StringRef file_extension,
                                     FunctionRef<void(std::ostream &)> fn);
 
+  /**
+   * Write the provided binary data, compressed if enabled with #set_compression.
+   * \return Identifier of the written data, with information on how to decode it.
+   */
+  std::shared_ptr<io::serialize::DictionaryValue> write_encoded(const void *data,
+                                                                int64_t size,
+                                                                const BlobFilter &filter);
+
   int64_t written_size() const
   {
     return total_written_size_;
@@ -105,7 +149,7 @@ class BlobWriteSharing : NonCopyable, NonMovable {
    * Remembers where data was stored based on the hash of the data. This allows us to skip writing
    * the same array again if it has the same hash.
    */
-  Map<uint64_t, BlobSlice> slice_by_content_hash_;
+  Map<uint64_t, std::shared_ptr<io::serialize::DictionaryValue>> io_data_by_content_hash_;
 
  public:
   ~BlobWriteSharing();
@@ -126,7 +170,7 @@ class BlobWriteSharing : NonCopyable, NonMovable {
    * Its hash is remembered so that the same data won't be written again.
    */
   [[nodiscard]] std::shared_ptr<io::serialize::DictionaryValue> write_deduplicated(
-      BlobWriter &writer, const void *data, int64_t size_in_bytes);
+      BlobWriter &writer, const void *data, int64_t size_in_bytes, const BlobFilter &filter = {});
 };
 
 /**
@@ -160,7 +204,7 @@ class BlobReadSharing : NonCopyable, NonMovable {
  * A specific #BlobReader that reads from disk.
  */
 class DiskBlobReader : public BlobReader {
- private:
+ protected:
   const std::string blobs_dir_;
   mutable std::mutex mutex_;
   mutable Map<std::string, std::unique_ptr<fstream>> open_input_streams_;
@@ -170,6 +214,28 @@ class DiskBlobReader : public BlobReader {
   [[nodiscard]] bool read(const BlobSlice &slice, void *r_data) const override;
 };
 
+/**
+ * A specific #BlobReader that maps the blob files on disk into memory. Arrays are referenced
+ * directly in the mapping where possible, so that only the pages that are accessed are loaded.
+ * Falls back to reading like #DiskBlobReader when a file can't be mapped.
+ */
+class MappedDiskBlobReader : public DiskBlobReader {
+ private:
+  /** Mapped files by path. The reader owns one user of each, null if mapping failed. */
+  mutable Map<std::string, BLI_mmap_file *> mapped_files_;
+
+ public:
+  MappedDiskBlobReader(std::string blobs_dir);
+  ~MappedDiskBlobReader();
+
+  [[nodiscard]] bool read(const BlobSlice &slice, void *r_data) const override;
+  [[nodiscard]] std::optional<ImplicitSharingInfoAndData> read_mapped(
+      const BlobSlice &slice, int64_t alignment) const override;
+
+ private:
+  BLI_mmap_file *ensure_mapped(const BlobSlice &slice) const;
+};
+
 /**
  * A specific #BlobWriter that writes to a file on disk.
  */
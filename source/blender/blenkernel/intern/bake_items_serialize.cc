@@ -14,9 +14,13 @@
 #include "BKE_volume.hh"
 
 #include "BLI_endian_defines.h"
+#include "BLI_array.hh"
 #include "BLI_endian_switch.h"
+#include "BLI_fileops.h"
 #include "BLI_math_matrix_types.hh"
+#include "BLI_mmap.h"
 #include "BLI_path_utils.hh"
+#include "BLI_task.hh"
 
 #include "DNA_material_types.h"
 #include "DNA_modifier_types.h"
@@ -25,9 +29,15 @@
 #include "RNA_access.hh"
 #include "RNA_enum_types.hh"
 
+#include <fcntl.h>
 #include <fmt/format.h>
 #include <sstream>
 #include <xxhash.h>
+#include <zstd.h>
+
+#ifndef WIN32
+#  include <unistd.h>
+#endif
 
 #ifdef WITH_OPENVDB
 #  include <openvdb/io/Stream.h>
@@ -71,6 +81,157 @@ BlobSlice BlobWriter::write_as_stream(const StringRef /*file_extension*/,
   return this->write(data.data(), data.size());
 }
 
+/** Smaller blobs are not compressed, because the gain is not worth the decoding overhead. */
+static constexpr int64_t blob_compression_min_size = 1024;
+
+/** Group bytes with the same significance of all scalars together. */
+static void blob_shuffle_bytes(const Span<std::byte> src,
+                               const int64_t scalar_size,
+                               MutableSpan<std::byte> dst)
+{
+  const int64_t scalars_num = src.size() / scalar_size;
+  threading::parallel_for(IndexRange(scalar_size), 1, [&](const IndexRange range) {
+    for (const int64_t byte : range) {
+      std::byte *dst_bytes = dst.data() + byte * scalars_num;
+      for (const int64_t i : IndexRange(scalars_num)) {
+        dst_bytes[i] = src[i * scalar_size + byte];
+      }
+    }
+  });
+}
+
+static void blob_unshuffle_bytes(const Span<std::byte> src,
+                                 const int64_t scalar_size,
+                                 MutableSpan<std::byte> dst)
+{
+  const int64_t scalars_num = src.size() / scalar_size;
+  threading::parallel_for(IndexRange(scalar_size), 1, [&](const IndexRange range) {
+    for (const int64_t byte : range) {
+      const std::byte *src_bytes = src.data() + byte * scalars_num;
+      for (const int64_t i : IndexRange(scalars_num)) {
+        dst[i * scalar_size + byte] = src_bytes[i];
+      }
+    }
+  });
+}
+
+static void blob_delta_encode(MutableSpan<std::byte> data)
+{
+  for (int64_t i = data.size() - 1; i > 0; i--) {
+    data[i] = std::byte(uint8_t(data[i]) - uint8_t(data[i - 1]));
+  }
+}
+
+static void blob_delta_decode(MutableSpan<std::byte> data)
+{
+  for (const int64_t i : data.index_range().drop_front(1)) {
+    data[i] = std::byte(uint8_t(data[i]) + uint8_t(data[i - 1]));
+  }
+}
+
+std::shared_ptr<DictionaryValue> BlobWriter::write_encoded(const void *data,
+                                                           const int64_t size,
+                                                           const BlobFilter &filter)
+{
+  if (compression_ == BlobCompression::None || size < blob_compression_min_size) {
+    return this->write(data, size).serialize();
+  }
+
+  const Span<std::byte> src{static_cast<const std::byte *>(data), size};
+  const bool use_shuffle = filter.scalar_size > 1 && size % filter.scalar_size == 0;
+  Array<std::byte> filtered;
+  if (use_shuffle || filter.delta) {
+    filtered.reinitialize(size);
+    if (use_shuffle) {
+      blob_shuffle_bytes(src, filter.scalar_size, filtered);
+    }
+    else {
+      filtered.as_mutable_span().copy_from(src);
+    }
+    if (filter.delta) {
+      blob_delta_encode(filtered);
+    }
+  }
+  const void *uncompressed = filtered.is_empty() ? data : filtered.data();
+
+  Array<std::byte> compressed(ZSTD_compressBound(size), NoInitialization());
+  const size_t compressed_size = ZSTD_compress(
+      compressed.data(), compressed.size(), uncompressed, size, ZSTD_CLEVEL_DEFAULT);
+  if (ZSTD_isError(compressed_size) || compressed_size >= size_t(size)) {
+    /* Store data that doesn't compress uncompressed. */
+    return this->write(data, size).serialize();
+  }
+
+  std::shared_ptr<DictionaryValue> io_data = this->write(compressed.data(), compressed_size)
+                                                 .serialize();
+  io_data->append_str("compression", "zstd");
+  io_data->append_int("raw_size", size);
+  if (use_shuffle) {
+    io_data->append_int("shuffle", filter.scalar_size);
+  }
+  if (filter.delta) {
+    io_data->append_int("delta", 1);
+  }
+  return io_data;
+}
+
+/**
+ * Read the data referenced by `io_data`, and decompress it if it was written compressed.
+ */
+[[nodiscard]] static bool read_blob_decoded(const BlobReader &blob_reader,
+                                            const DictionaryValue &io_data,
+                                            const int64_t size_in_bytes,
+                                            void *r_data)
+{
+  const std::optional<BlobSlice> slice = BlobSlice::deserialize(io_data);
+  if (!slice) {
+    return false;
+  }
+  const std::optional<StringRefNull> compression = io_data.lookup_str("compression");
+  if (!compression) {
+    if (slice->range.size() != size_in_bytes) {
+      return false;
+    }
+    return blob_reader.read(*slice, r_data);
+  }
+  if (*compression != "zstd" || io_data.lookup_int("raw_size") != size_in_bytes) {
+    return false;
+  }
+
+  Array<std::byte> compressed(slice->range.size(), NoInitialization());
+  if (!blob_reader.read(*slice, compressed.data())) {
+    return false;
+  }
+  const int64_t scalar_size = io_data.lookup_int("shuffle").value_or(1);
+  const bool use_shuffle = scalar_size > 1;
+  const bool use_delta = io_data.lookup_int("delta").value_or(0) != 0;
+  if (use_shuffle && size_in_bytes % scalar_size != 0) {
+    return false;
+  }
+
+  Array<std::byte> filtered;
+  if (use_shuffle) {
+    filtered.reinitialize(size_in_bytes);
+  }
+  const MutableSpan<std::byte> uncompressed = use_shuffle ?
+                                                  filtered.as_mutable_span() :
+                                                  MutableSpan(static_cast<std::byte *>(r_data),
+                                                              size_in_bytes);
+  const size_t uncompressed_size = ZSTD_decompress(
+      uncompressed.data(), uncompressed.size(), compressed.data(), compressed.size());
+  if (uncompressed_size != size_t(size_in_bytes)) {
+    return false;
+  }
+  if (use_delta) {
+    blob_delta_decode(uncompressed);
+  }
+  if (use_shuffle) {
+    blob_unshuffle_bytes(
+        filtered, scalar_size, MutableSpan(static_cast<std::byte *>(r_data), size_in_bytes));
+  }
+  return true;
+}
+
 bool BlobReader::read_as_stream(const BlobSlice &slice, FunctionRef<bool(std::istream &)> fn) const
 {
   const int64_t size = slice.range.size();
@@ -109,6 +270,106 @@ DiskBlobReader::DiskBlobReader(std::string blobs_dir) : blobs_dir_(std::move(blo
   return true;
 }
 
+std::optional<ImplicitSharingInfoAndData> BlobReader::read_mapped(
+    const BlobSlice & /*slice*/, const int64_t /*alignment*/) const
+{
+  return std::nullopt;
+}
+
+/**
+ * Keeps a memory mapped blob file alive while a slice of it is referenced. Every slice has its own
+ * sharing info, because e.g. #BlobWriteSharing identifies arrays by their sharing info.
+ */
+class MappedBlobSliceSharingInfo : public ImplicitSharingInfo {
+ private:
+  BLI_mmap_file *mmap_file_;
+
+ public:
+  MappedBlobSliceSharingInfo(BLI_mmap_file *mmap_file) : mmap_file_(mmap_file)
+  {
+    BLI_mmap_add_user(mmap_file_);
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    BLI_mmap_free(mmap_file_);
+    MEM_delete(this);
+  }
+};
+
+MappedDiskBlobReader::MappedDiskBlobReader(std::string blobs_dir)
+    : DiskBlobReader(std::move(blobs_dir))
+{
+}
+
+MappedDiskBlobReader::~MappedDiskBlobReader()
+{
+  for (BLI_mmap_file *mmap_file : mapped_files_.values()) {
+    if (mmap_file) {
+      BLI_mmap_free(mmap_file);
+    }
+  }
+}
+
+BLI_mmap_file *MappedDiskBlobReader::ensure_mapped(const BlobSlice &slice) const
+{
+#ifdef WIN32
+  /* Mapped files can't be replaced or deleted on Windows, which would prevent baking again. */
+  UNUSED_VARS(slice);
+  return nullptr;
+#else
+  char blob_path[FILE_MAX];
+  BLI_path_join(blob_path, sizeof(blob_path), blobs_dir_.c_str(), slice.name.c_str());
+
+  std::lock_guard lock{mutex_};
+  return mapped_files_.lookup_or_add_cb(blob_path, [&]() -> BLI_mmap_file * {
+    const int file = BLI_open(blob_path, O_BINARY | O_RDONLY, 0);
+    if (file == -1) {
+      return nullptr;
+    }
+    /* Copy-on-write, because arrays with a single user are modified in place. */
+    BLI_mmap_file *mmap_file = BLI_mmap_open_copy_on_write(file);
+    close(file);
+    return mmap_file;
+  });
+#endif
+}
+
+bool MappedDiskBlobReader::read(const BlobSlice &slice, void *r_data) const
+{
+  if (slice.range.is_empty()) {
+    return true;
+  }
+  BLI_mmap_file *mmap_file = this->ensure_mapped(slice);
+  if (!mmap_file) {
+    return DiskBlobReader::read(slice, r_data);
+  }
+  return BLI_mmap_read(
+      mmap_file, r_data, size_t(slice.range.start()), size_t(slice.range.size()));
+}
+
+std::optional<ImplicitSharingInfoAndData> MappedDiskBlobReader::read_mapped(
+    const BlobSlice &slice, const int64_t alignment) const
+{
+  if (slice.range.is_empty()) {
+    return std::nullopt;
+  }
+  BLI_mmap_file *mmap_file = this->ensure_mapped(slice);
+  if (!mmap_file) {
+    return std::nullopt;
+  }
+  if (slice.range.one_after_last() > int64_t(BLI_mmap_get_length(mmap_file))) {
+    return std::nullopt;
+  }
+  const void *data = POINTER_OFFSET(BLI_mmap_get_pointer(mmap_file), slice.range.start());
+  if (uintptr_t(data) % alignment != 0) {
+    return std::nullopt;
+  }
+  return ImplicitSharingInfoAndData{MEM_new<MappedBlobSliceSharingInfo>(__func__, mmap_file),
+                                    data};
+}
+
 DiskBlobWriter::DiskBlobWriter(std::string blob_dir, std::string base_name)
     : blob_dir_(std::move(blob_dir)), base_name_(std::move(base_name))
 {
@@ -251,34 +512,49 @@ DictionaryValuePtr BlobWriteSharing::write_implicitly_shared(
 }
 
 std::shared_ptr<io::serialize::DictionaryValue> BlobWriteSharing::write_deduplicated(
-    BlobWriter &writer, const void *data, const int64_t size_in_bytes)
+    BlobWriter &writer, const void *data, const int64_t size_in_bytes, const BlobFilter &filter)
 {
   const uint64_t content_hash = XXH3_64bits(data, size_in_bytes);
-  const BlobSlice slice = slice_by_content_hash_.lookup_or_add_cb(
-      content_hash, [&]() { return writer.write(data, size_in_bytes); });
-  return slice.serialize();
+  const std::shared_ptr<DictionaryValue> &stored_io_data =
+      io_data_by_content_hash_.lookup_or_add_cb(
+          content_hash, [&]() { return writer.write_encoded(data, size_in_bytes, filter); });
+  /* Return a copy, because the caller may add more information. */
+  auto io_data = std::make_shared<DictionaryValue>();
+  for (const DictionaryValue::Item &item : stored_io_data->elements()) {
+    io_data->append(item.first, item.second);
+  }
+  return io_data;
 }
 
 std::optional<ImplicitSharingInfoAndData> BlobReadSharing::read_shared(
     const DictionaryValue &io_data,
     FunctionRef<std::optional<ImplicitSharingInfoAndData>()> read_fn) const
 {
-  std::lock_guard lock{mutex_};
-
   io::serialize::JsonFormatter formatter;
   std::stringstream ss;
   formatter.serialize(ss, io_data);
   const std::string key = ss.str();
 
-  if (const ImplicitSharingInfoAndData *shared_data = runtime_by_stored_.lookup_ptr(key)) {
-    shared_data->sharing_info->add_user();
-    return *shared_data;
+  {
+    std::lock_guard lock{mutex_};
+    if (const ImplicitSharingInfoAndData *shared_data = runtime_by_stored_.lookup_ptr(key)) {
+      shared_data->sharing_info->add_user();
+      return *shared_data;
+    }
   }
+  /* Don't hold the lock while reading, so that different data can be read in parallel. */
   std::optional<ImplicitSharingInfoAndData> data = read_fn();
   if (!data) {
     return std::nullopt;
   }
   if (data->sharing_info != nullptr) {
+    std::lock_guard lock{mutex_};
+    if (const ImplicitSharingInfoAndData *shared_data = runtime_by_stored_.lookup_ptr(key)) {
+      /* The same data has been read by another thread in the meantime. */
+      data->sharing_info->remove_user_and_delete_if_last();
+      shared_data->sharing_info->add_user();
+      return *shared_data;
+    }
     data->sharing_info->add_user();
     runtime_by_stored_.add_new(key, *data);
   }
@@ -333,9 +609,10 @@ static std::shared_ptr<DictionaryValue> write_blob_raw_data_with_endian(
     BlobWriter &blob_writer,
     BlobWriteSharing &blob_sharing,
     const void *data,
-    const int64_t size_in_bytes)
+    const int64_t size_in_bytes,
+    const BlobFilter &filter)
 {
-  auto io_data = blob_sharing.write_deduplicated(blob_writer, data, size_in_bytes);
+  auto io_data = blob_sharing.write_deduplicated(blob_writer, data, size_in_bytes, filter);
   if (ENDIAN_ORDER == B_ENDIAN) {
     io_data->append_str("endian", get_endian_io_name(ENDIAN_ORDER));
   }
@@ -351,14 +628,7 @@ static std::shared_ptr<DictionaryValue> write_blob_raw_data_with_endian(
                                                          const int64_t elements_num,
                                                          void *r_data)
 {
-  const std::optional<BlobSlice> slice = BlobSlice::deserialize(io_data);
-  if (!slice) {
-    return false;
-  }
-  if (slice->range.size() != element_size * elements_num) {
-    return false;
-  }
-  if (!blob_reader.read(*slice, r_data)) {
+  if (!read_blob_decoded(blob_reader, io_data, element_size * elements_num, r_data)) {
     return false;
   }
   const StringRefNull stored_endian = io_data.lookup_str("endian").value_or("little");
@@ -399,14 +669,7 @@ static std::shared_ptr<DictionaryValue> write_blob_raw_bytes(BlobWriter &blob_wr
                                               const int64_t bytes_num,
                                               void *r_data)
 {
-  const std::optional<BlobSlice> slice = BlobSlice::deserialize(io_data);
-  if (!slice) {
-    return false;
-  }
-  if (slice->range.size() != bytes_num) {
-    return false;
-  }
-  return blob_reader.read(*slice, r_data);
+  return read_blob_decoded(blob_reader, io_data, bytes_num, r_data);
 }
 
 static std::shared_ptr<DictionaryValue> write_blob_simple_gspan(BlobWriter &blob_writer,
@@ -418,8 +681,22 @@ static std::shared_ptr<DictionaryValue> write_blob_simple_gspan(BlobWriter &blob
   if (type.size() == 1 || type.is<ColorGeometry4b>()) {
     return write_blob_raw_bytes(blob_writer, blob_sharing, data.data(), data.size_in_bytes());
   }
+  BlobFilter filter;
+  if (type.is_any<int16_t, uint16_t, int32_t, uint32_t, int64_t, uint64_t>()) {
+    /* Integers are often indices or offsets, that change slowly. */
+    filter.scalar_size = type.size();
+    filter.delta = true;
+  }
+  else if (type.is<int2>()) {
+    filter.scalar_size = sizeof(int32_t);
+    filter.delta = true;
+  }
+  else {
+    /* Other types consist of floats. */
+    filter.scalar_size = sizeof(float);
+  }
   return write_blob_raw_data_with_endian(
-      blob_writer, blob_sharing, data.data(), data.size_in_bytes());
+      blob_writer, blob_sharing, data.data(), data.size_in_bytes(), filter);
 }
 
 [[nodiscard]] static bool read_blob_simple_gspan(const BlobReader &blob_reader,
@@ -468,6 +745,35 @@ static std::shared_ptr<DictionaryValue> write_blob_shared_simple_gspan(
       sharing_info, [&]() { return write_blob_simple_gspan(blob_writer, blob_sharing, data); });
 }
 
+/**
+ * Reference the data in the blob directly, if the reader supports it and no endian switch is
+ * necessary.
+ */
+static std::optional<ImplicitSharingInfoAndData> read_blob_mapped_simple_gspan(
+    const BlobReader &blob_reader,
+    const DictionaryValue &io_data,
+    const CPPType &cpp_type,
+    const int size)
+{
+  const std::optional<BlobSlice> slice = BlobSlice::deserialize(io_data);
+  if (!slice) {
+    return std::nullopt;
+  }
+  if (slice->range.size() != cpp_type.size() * size) {
+    return std::nullopt;
+  }
+  if (io_data.lookup("compression")) {
+    return std::nullopt;
+  }
+  if (!(cpp_type.size() == 1 || cpp_type.is<ColorGeometry4b>())) {
+    const StringRefNull stored_endian = io_data.lookup_str("endian").value_or("little");
+    if (stored_endian != get_endian_io_name(ENDIAN_ORDER)) {
+      return std::nullopt;
+    }
+  }
+  return blob_reader.read_mapped(*slice, cpp_type.alignment());
+}
+
 [[nodiscard]] static const void *read_blob_shared_simple_gspan(
     const DictionaryValue &io_data,
     const BlobReader &blob_reader,
@@ -479,6 +785,11 @@ static std::shared_ptr<DictionaryValue> write_blob_shared_simple_gspan(
   const char *func = __func__;
   const std::optional<ImplicitSharingInfoAndData> sharing_info_and_data = blob_sharing.read_shared(
       io_data, [&]() -> std::optional<ImplicitSharingInfoAndData> {
+        if (std::optional<ImplicitSharingInfoAndData> mapped_data = read_blob_mapped_simple_gspan(
+                blob_reader, io_data, cpp_type, size))
+        {
+          return mapped_data;
+        }
         void *data_mem = MEM_mallocN_aligned(size * cpp_type.size(), cpp_type.alignment(), func);
         if (!read_blob_simple_gspan(blob_reader, io_data, {cpp_type, data_mem, size})) {
           MEM_freeN(data_mem);
@@ -538,6 +849,18 @@ template<typename T>
                                           const BlobReader &blob_reader,
                                           const BlobReadSharing &blob_sharing)
 {
+  struct AttributeToLoad {
+    StringRefNull name;
+    AttrDomain domain;
+    eCustomDataType data_type;
+    const CPPType *cpp_type;
+    int domain_size;
+    const DictionaryValue *io_data;
+    const void *data = nullptr;
+    const ImplicitSharingInfo *sharing_info = nullptr;
+  };
+  Vector<AttributeToLoad> attributes_to_load;
+
   for (const auto &io_attribute_value : io_attributes.elements()) {
     const auto *io_attribute = io_attribute_value->as_dictionary_value();
     if (!io_attribute) {
@@ -560,31 +883,50 @@ template<typename T>
     if (!cpp_type) {
       return false;
     }
-    const int domain_size = attributes.domain_size(*domain);
-    const ImplicitSharingInfo *attribute_sharing_info;
-    const void *attribute_data = read_blob_shared_simple_gspan(
-        *io_data, blob_reader, blob_sharing, *cpp_type, domain_size, &attribute_sharing_info);
-    if (!attribute_data) {
-      return false;
+    attributes_to_load.append(
+        {*name, *domain, *data_type, cpp_type, attributes.domain_size(*domain), io_data});
+  }
+
+  /* Reading the attributes is independent, which is worth it when the data is compressed. */
+  threading::parallel_for(attributes_to_load.index_range(), 1, [&](const IndexRange range) {
+    for (AttributeToLoad &attribute : attributes_to_load.as_mutable_span().slice(range)) {
+      attribute.data = read_blob_shared_simple_gspan(*attribute.io_data,
+                                                     blob_reader,
+                                                     blob_sharing,
+                                                     *attribute.cpp_type,
+                                                     attribute.domain_size,
+                                                     &attribute.sharing_info);
+    }
+  });
+  BLI_SCOPED_DEFER([&]() {
+    for (const AttributeToLoad &attribute : attributes_to_load) {
+      if (attribute.sharing_info) {
+        attribute.sharing_info->remove_user_and_delete_if_last();
+      }
     }
-    BLI_SCOPED_DEFER([&]() { attribute_sharing_info->remove_user_and_delete_if_last(); });
+  });
 
-    if (attributes.contains(*name)) {
+  for (const AttributeToLoad &attribute : attributes_to_load) {
+    if (!attribute.data) {
+      return false;
+    }
+    if (attributes.contains(attribute.name)) {
       /* If the attribute exists already, copy the values over to the existing array. */
-      GSpanAttributeWriter attribute = attributes.lookup_or_add_for_write_only_span(
-          *name, *domain, *data_type);
-      if (!attribute) {
+      GSpanAttributeWriter attribute_writer = attributes.lookup_or_add_for_write_only_span(
+          attribute.name, attribute.domain, attribute.data_type);
+      if (!attribute_writer) {
         return false;
       }
-      cpp_type->copy_assign_n(attribute_data, attribute.span.data(), domain_size);
-      attribute.finish();
+      attribute.cpp_type->copy_assign_n(
+          attribute.data, attribute_writer.span.data(), attribute.domain_size);
+      attribute_writer.finish();
     }
     else {
       /* Add a new attribute that shares the data. */
-      if (!attributes.add(*name,
-                          *domain,
-                          *data_type,
-                          AttributeInitShared(attribute_data, *attribute_sharing_info)))
+      if (!attributes.add(attribute.name,
+                          attribute.domain,
+                          attribute.data_type,
+                          AttributeInitShared(attribute.data, *attribute.sharing_info)))
       {
         return false;
       }
@@ -0,0 +1,198 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_fileops.hh"
+#include "BLI_math_vector_types.hh"
+#include "BLI_path_utils.hh"
+#include "BLI_system.h"
+#include "BLI_tempfile.h"
+#include "BLI_timeit.hh"
+
+#include "BKE_bake_items_serialize.hh"
+#include "BKE_idtype.hh"
+#include "BKE_pointcloud.hh"
+
+#include "DNA_pointcloud_types.h"
+
+#include BLI_SYSTEM_PID_H
+
+namespace blender::bke::bake::tests {
+
+class BakeBlobTest : public testing::Test {
+ public:
+  std::string blobs_dir;
+
+  void SetUp() override
+  {
+    char temp_dir[FILE_MAX];
+    BLI_temp_directory_path_get(temp_dir, sizeof(temp_dir));
+    blobs_dir = std::string(temp_dir) + SEP_STR + "blender_bake_blob_test_" +
+                std::to_string(getpid());
+  }
+
+  void TearDown() override
+  {
+    if (BLI_exists(blobs_dir.c_str())) {
+      BLI_delete(blobs_dir.c_str(), true, true);
+    }
+  }
+};
+
+TEST_F(BakeBlobTest, MappedReader)
+{
+  Array<float3> positions(1000);
+  for (const int i : positions.index_range()) {
+    positions[i] = float3(i, i * 2, i * 3);
+  }
+  const uint8_t flag = 7;
+
+  BlobSlice flag_slice;
+  BlobSlice positions_slice;
+  BlobSlice misaligned_slice;
+  {
+    DiskBlobWriter writer{blobs_dir, "frame"};
+    positions_slice = writer.write(positions.data(), positions.as_span().size_in_bytes());
+    flag_slice = writer.write(&flag, sizeof(flag));
+    misaligned_slice = writer.write(positions.data(), positions.as_span().size_in_bytes());
+  }
+
+  const DiskBlobReader disk_reader{blobs_dir};
+  const MappedDiskBlobReader mapped_reader{blobs_dir};
+  EXPECT_FALSE(disk_reader.read_mapped(positions_slice, alignof(float3)).has_value());
+
+  Array<float3> read_positions(positions.size());
+  EXPECT_TRUE(mapped_reader.read(positions_slice, read_positions.data()));
+  EXPECT_EQ_ARRAY(positions.data(), read_positions.data(), positions.size());
+  uint8_t read_flag = 0;
+  EXPECT_TRUE(mapped_reader.read(flag_slice, &read_flag));
+  EXPECT_EQ(read_flag, flag);
+
+#ifndef WIN32
+  const std::optional<ImplicitSharingInfoAndData> mapped_positions = mapped_reader.read_mapped(
+      positions_slice, alignof(float3));
+  ASSERT_TRUE(mapped_positions.has_value());
+  EXPECT_EQ_ARRAY(positions.data(),
+                  static_cast<const float3 *>(mapped_positions->data),
+                  positions.size());
+  /* The array is the only user of its sharing info, the mapping is copy-on-write. */
+  EXPECT_TRUE(mapped_positions->sharing_info->is_mutable());
+  EXPECT_FALSE(mapped_reader.read_mapped(misaligned_slice, alignof(float3)).has_value());
+
+  /* Slices of the same file are different arrays, code like #BlobWriteSharing relies on that. */
+  const std::optional<ImplicitSharingInfoAndData> mapped_flag = mapped_reader.read_mapped(
+      flag_slice, alignof(uint8_t));
+  ASSERT_TRUE(mapped_flag.has_value());
+  EXPECT_NE(mapped_flag->sharing_info, mapped_positions->sharing_info);
+  EXPECT_EQ(*static_cast<const uint8_t *>(mapped_flag->data), flag);
+  mapped_flag->sharing_info->remove_user_and_delete_if_last();
+  mapped_positions->sharing_info->remove_user_and_delete_if_last();
+#endif
+
+  const BlobSlice missing_slice{"missing.blob", positions_slice.range};
+  EXPECT_FALSE(mapped_reader.read(missing_slice, read_positions.data()));
+  EXPECT_FALSE(mapped_reader.read_mapped(missing_slice, alignof(float3)).has_value());
+}
+
+static int64_t write_pointcloud_bake(const StringRefNull blobs_dir,
+                                     const StringRefNull name,
+                                     const BlobCompression compression)
+{
+  PointCloud *pointcloud = BKE_pointcloud_new_nomain(10000);
+  MutableSpan<float3> positions = pointcloud->positions_for_write();
+  for (const int i : positions.index_range()) {
+    positions[i] = float3(i * 0.1f, 1.0f, -i * 0.2f);
+  }
+  MutableAttributeAccessor attributes = pointcloud->attributes_for_write();
+  SpanAttributeWriter<int> ids = attributes.lookup_or_add_for_write_span<int>("id",
+                                                                             AttrDomain::Point);
+  for (const int i : ids.span.index_range()) {
+    ids.span[i] = i * 2;
+  }
+  ids.finish();
+
+  BakeState bake_state;
+  bake_state.items_by_id.add_new(
+      0, std::make_unique<GeometryBakeItem>(GeometrySet::from_pointcloud(pointcloud)));
+  DiskBlobWriter blob_writer{blobs_dir, name};
+  blob_writer.set_compression(compression);
+  BlobWriteSharing blob_sharing;
+  fstream meta_file{blobs_dir + SEP_STR + name + ".json", std::ios::out};
+  serialize_bake(bake_state, blob_writer, blob_sharing, meta_file);
+  return blob_writer.written_size();
+}
+
+TEST_F(BakeBlobTest, Compression)
+{
+  BKE_idtype_init();
+  BLI_dir_create_recursive(blobs_dir.c_str());
+  const int64_t raw_size = write_pointcloud_bake(blobs_dir, "raw", BlobCompression::None);
+  const int64_t compressed_size = write_pointcloud_bake(blobs_dir, "zstd", BlobCompression::Zstd);
+  EXPECT_LT(compressed_size, raw_size / 2);
+
+  fstream meta_file{blobs_dir + SEP_STR + "zstd.json", std::ios::in};
+  const DiskBlobReader blob_reader{blobs_dir};
+  const BlobReadSharing blob_sharing;
+  std::optional<BakeState> bake_state = deserialize_bake(meta_file, blob_reader, blob_sharing);
+  ASSERT_TRUE(bake_state.has_value());
+  const auto &item = static_cast<const GeometryBakeItem &>(*bake_state->items_by_id.lookup(0));
+  const PointCloud &pointcloud = *item.geometry.get_pointcloud();
+  const Span<float3> positions = pointcloud.positions();
+  const VArraySpan<int> ids = *pointcloud.attributes().lookup<int>("id", AttrDomain::Point);
+  ASSERT_EQ(positions.size(), 10000);
+  for (const int i : positions.index_range()) {
+    EXPECT_EQ(positions[i], float3(i * 0.1f, 1.0f, -i * 0.2f));
+    EXPECT_EQ(ids[i], i * 2);
+  }
+}
+
+/* Disable benchmark by default. */
+#if 0
+template<typename Reader> static void benchmark_frame_change(const StringRefNull blobs_dir)
+{
+  for (const int frame : IndexRange(10)) {
+    fstream meta_file{blobs_dir + SEP_STR + std::to_string(frame) + ".json", std::ios::in};
+    const Reader blob_reader{blobs_dir};
+    const BlobReadSharing blob_sharing;
+    SCOPED_TIMER("frame change");
+    std::optional<BakeState> bake_state = deserialize_bake(meta_file, blob_reader, blob_sharing);
+    const auto &item = static_cast<const GeometryBakeItem &>(*bake_state->items_by_id.lookup(0));
+    /* Only a few points are accessed, like when drawing a subset of the points. */
+    const Span<float3> positions = item.geometry.get_pointcloud()->positions();
+    float3 sum(0);
+    for (int64_t i = 0; i < positions.size(); i += positions.size() / 100) {
+      sum += positions[i];
+    }
+    UNUSED_VARS(sum);
+  }
+}
+
+TEST_F(BakeBlobTest, BenchmarkFrameChange)
+{
+  BKE_idtype_init();
+  BLI_dir_create_recursive(blobs_dir.c_str());
+  const int points_num = 20'000'000;
+  for (const int frame : IndexRange(10)) {
+    PointCloud *pointcloud = BKE_pointcloud_new_nomain(points_num);
+    pointcloud->positions_for_write().fill(float3(frame));
+    BakeState bake_state;
+    bake_state.items_by_id.add_new(
+        0, std::make_unique<GeometryBakeItem>(GeometrySet::from_pointcloud(pointcloud)));
+
+    DiskBlobWriter blob_writer{blobs_dir, std::to_string(frame)};
+    BlobWriteSharing blob_sharing;
+    fstream meta_file{blobs_dir + SEP_STR + std::to_string(frame) + ".json", std::ios::out};
+    serialize_bake(bake_state, blob_writer, blob_sharing, meta_file);
+  }
+
+  std::cout << "DiskBlobReader\n";
+  benchmark_frame_change<DiskBlobReader>(blobs_dir);
+  std::cout << "MappedDiskBlobReader\n";
+  benchmark_frame_change<MappedDiskBlobReader>(blobs_dir);
+}
+#endif
+
+}  // namespace blender::bke::bake::tests
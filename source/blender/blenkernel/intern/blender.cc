@@ -39,6 +39,7 @@
 #include "BKE_writeffmpeg.hh"
 
 #include "DEG_depsgraph.hh"
+#include "DEG_depsgraph_debug.hh"
 
 #include "RE_texture.h"
 
@@ -69,6 +70,7 @@ void BKE_blender_free()
   IMB_exit();
   BKE_cachefiles_exit();
   DEG_free_node_types();
+  DEG_debug_eval_trace_end();
 
   BKE_brush_system_exit();
   RE_texture_rng_exit();
@@ -150,11 +150,19 @@ static void bvhtree_balance_isolated(void *userdata)
   BLI_bvhtree_balance((BVHTree *)userdata);
 }
 
-static void bvhtree_balance(BVHTree *tree, const bool isolate)
+static void bvhtree_balance_sah_isolated(void *userdata)
+{
+  BLI_bvhtree_balance_sah((BVHTree *)userdata);
+}
+
+static void bvhtree_balance(BVHTree *tree, const bool isolate, const bool use_sah = false)
 {
   if (tree) {
     if (isolate) {
-      BLI_task_isolate(bvhtree_balance_isolated, tree);
+      BLI_task_isolate(use_sah ? bvhtree_balance_sah_isolated : bvhtree_balance_isolated, tree);
+    }
+    else if (use_sah) {
+      BLI_bvhtree_balance_sah(tree);
     }
     else {
       BLI_bvhtree_balance(tree);
@@ -162,6 +170,30 @@ static void bvhtree_balance(BVHTree *tree, const bool isolate)
   }
 }
 
+/**
+ * Cached trees of surfaces are mostly used for ray-casts and nearest surface queries (snapping,
+ * shrink-wrap, baking, etc.), which are faster with the surface area heuristic. Its slower build
+ * is paid once per evaluated mesh. Trees of vertices and edges keep the faster median build.
+ */
+static bool bvhtree_cache_type_use_sah(const BVHCacheType bvh_cache_type)
+{
+  switch (bvh_cache_type) {
+    case BVHTREE_FROM_FACES:
+    case BVHTREE_FROM_CORNER_TRIS:
+    case BVHTREE_FROM_CORNER_TRIS_NO_HIDDEN:
+      return true;
+    case BVHTREE_FROM_VERTS:
+    case BVHTREE_FROM_EDGES:
+    case BVHTREE_FROM_LOOSEVERTS:
+    case BVHTREE_FROM_LOOSEEDGES:
+    case BVHTREE_FROM_LOOSEVERTS_NO_HIDDEN:
+    case BVHTREE_FROM_LOOSEEDGES_NO_HIDDEN:
+    case BVHTREE_MAX_ITEM:
+      break;
+  }
+  return false;
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
@@ -1008,7 +1040,7 @@ BVHTree *BKE_bvhtree_from_mesh_get(BVHTreeFromMesh *data,
       break;
   }
 
-  bvhtree_balance(data->tree, lock_started);
+  bvhtree_balance(data->tree, lock_started, bvhtree_cache_type_use_sah(bvh_cache_type));
 
   /* Save on cache for later use */
   // printf("BVHTree built and saved on cache\n");
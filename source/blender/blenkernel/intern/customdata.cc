@@ -36,6 +36,7 @@
 #include "BLI_string_ref.hh"
 #include "BLI_string_utf8.h"
 #include "BLI_string_utils.hh"
+#include "BLI_task.hh"
 #include "BLI_utildefines.h"
 
 #ifndef NDEBUG
@@ -2378,17 +2379,26 @@ static bool customdata_typemap_is_valid(const CustomData *data)
 }
 #endif
 
-static void *copy_layer_data(const eCustomDataType type, const void *data, const int totelem)
+static void copy_layer_data_to(const eCustomDataType type,
+                               const void *data,
+                               void *new_data,
+                               const int totelem)
 {
   const LayerTypeInfo &type_info = *layerType_getInfo(type);
-  const int64_t size_in_bytes = int64_t(totelem) * type_info.size;
-  void *new_data = MEM_mallocN_aligned(size_in_bytes, type_info.alignment, __func__);
   if (type_info.copy) {
     type_info.copy(data, new_data, totelem);
   }
   else {
-    memcpy(new_data, data, size_in_bytes);
+    memcpy(new_data, data, int64_t(totelem) * type_info.size);
   }
+}
+
+static void *copy_layer_data(const eCustomDataType type, const void *data, const int totelem)
+{
+  const LayerTypeInfo &type_info = *layerType_getInfo(type);
+  const int64_t size_in_bytes = int64_t(totelem) * type_info.size;
+  void *new_data = MEM_mallocN_aligned(size_in_bytes, type_info.alignment, __func__);
+  copy_layer_data_to(type, data, new_data, totelem);
   return new_data;
 }
 
@@ -2417,6 +2427,16 @@ static bool customdata_merge_internal(const CustomData *source,
   int current_type_layer_count = 0;
   int max_current_type_layer_count = -1;
 
+  /* Layers which can't be shared are allocated while building the layout, but only copied
+   * afterwards, so that large layers can be copied in parallel. */
+  struct LayerCopy {
+    eCustomDataType type;
+    const void *src_data;
+    void *dst_data;
+  };
+  Vector<LayerCopy> layer_copies;
+  int64_t layer_copies_size_in_bytes = 0;
+
   for (int i = 0; i < source->totlayer; i++) {
     const CustomDataLayer &src_layer = source->layers[i];
     const eCustomDataType type = eCustomDataType(src_layer.type);
@@ -2462,7 +2482,17 @@ static bool customdata_merge_internal(const CustomData *source,
       if (src_layer.data != nullptr) {
         if (src_layer.sharing_info == nullptr) {
           /* Can't share the layer, duplicate it instead. */
-          layer_data_to_assign = copy_layer_data(type, src_layer.data, totelem);
+          if (totelem > 0) {
+            const LayerTypeInfo &type_info = *layerType_getInfo(type);
+            const int64_t size_in_bytes = int64_t(totelem) * type_info.size;
+            layer_data_to_assign = MEM_mallocN_aligned(
+                size_in_bytes, type_info.alignment, __func__);
+            layer_copies.append({type, src_layer.data, layer_data_to_assign});
+            layer_copies_size_in_bytes += size_in_bytes;
+          }
+          else {
+            layer_data_to_assign = copy_layer_data(type, src_layer.data, totelem);
+          }
         }
         else {
           /* Share the layer. */
@@ -2489,6 +2519,16 @@ static bool customdata_merge_internal(const CustomData *source,
     changed = true;
   }
 
+  /* Avoid threading overhead when there is little to copy. */
+  const int64_t grain_size = layer_copies_size_in_bytes < 4 * 1024 * 1024 ? layer_copies.size() :
+                                                                            1;
+  blender::threading::parallel_for(
+      layer_copies.index_range(), grain_size, [&](const IndexRange range) {
+        for (const LayerCopy &layer_copy : layer_copies.as_span().slice(range)) {
+          copy_layer_data_to(layer_copy.type, layer_copy.src_data, layer_copy.dst_data, totelem);
+        }
+      });
+
   CustomData_update_typemap(dest);
   return changed;
 }
@@ -4684,7 +4724,9 @@ bool CustomData_layer_validate(CustomDataLayer *layer, const uint totitems, cons
   }
 
   BLI_assert((totitems == 0) || layer->data);
-  BLI_assert(MEM_allocN_len(layer->data) >= totitems * typeInfo->size);
+  /* Data in the memory-mapped blend-file has no allocation length to check. */
+  BLI_assert(BLO_read_is_mapped(layer->sharing_info) ||
+             MEM_allocN_len(layer->data) >= totitems * typeInfo->size);
 
   if (typeInfo->validate != nullptr) {
     return typeInfo->validate(layer->data, totitems, do_fixes);
@@ -5463,6 +5505,37 @@ static void blend_read_layer_data(BlendDataReader *reader, CustomDataLayer &laye
   }
 }
 
+/**
+ * Reference the layer data in the memory-mapped blend-file directly instead of reading a copy.
+ * Only possible for trivial types whose stored data is used without any conversion.
+ */
+static const ImplicitSharingInfo *blend_read_layer_data_mapped(BlendDataReader *reader,
+                                                               CustomDataLayer &layer,
+                                                               const int count)
+{
+  switch (layer.type) {
+    case CD_PROP_FLOAT:
+    case CD_PROP_FLOAT2:
+    case CD_PROP_FLOAT3:
+    case CD_PROP_FLOAT4X4:
+    case CD_PROP_INT8:
+    case CD_PROP_INT32:
+    case CD_PROP_INT32_2D:
+    case CD_PROP_BOOL:
+    case CD_PROP_COLOR:
+    case CD_PROP_BYTE_COLOR:
+    case CD_PROP_QUATERNION:
+      break;
+    default:
+      return nullptr;
+  }
+  const LayerTypeInfo *type_info = layerType_getInfo(eCustomDataType(layer.type));
+  return BLO_read_mapped(reader,
+                         const_cast<const void **>(&layer.data),
+                         size_t(count) * size_t(type_info->size),
+                         size_t(type_info->alignment));
+}
+
 void CustomData_blend_read(BlendDataReader *reader, CustomData *data, const int count)
 {
   BLO_read_struct_array(reader, CustomDataLayer, data->totlayer, &data->layers);
@@ -5488,6 +5561,11 @@ void CustomData_blend_read(BlendDataReader *reader, CustomData *data, const int
     if (CustomData_verify_versions(data, i)) {
       layer->sharing_info = BLO_read_shared(
           reader, &layer->data, [&]() -> const ImplicitSharingInfo * {
+            if (const ImplicitSharingInfo *sharing_info = blend_read_layer_data_mapped(
+                    reader, *layer, count))
+            {
+              return sharing_info;
+            }
             blend_read_layer_data(reader, *layer, count);
             if (layer->data == nullptr) {
               return nullptr;
@@ -45,6 +45,7 @@
 #include "BLI_string.h"
 #include "BLI_string_ref.hh"
 #include "BLI_string_utils.hh"
+#include "BLI_task.hh"
 #include "BLI_utildefines.h"
 #include "BLI_vector_set.hh"
 #include "BLI_virtual_array.hh"
@@ -913,25 +914,31 @@ void copy_drawing_array(Span<const GreasePencilDrawingBase *> src_drawings,
                         MutableSpan<GreasePencilDrawingBase *> dst_drawings)
 {
   BLI_assert(src_drawings.size() == dst_drawings.size());
-  for (const int i : src_drawings.index_range()) {
-    const GreasePencilDrawingBase *src_drawing_base = src_drawings[i];
-    switch (src_drawing_base->type) {
-      case GP_DRAWING: {
-        const GreasePencilDrawing *src_drawing = reinterpret_cast<const GreasePencilDrawing *>(
-            src_drawing_base);
-        dst_drawings[i] = reinterpret_cast<GreasePencilDrawingBase *>(
-            MEM_new<bke::greasepencil::Drawing>(__func__, src_drawing->wrap()));
-        break;
-      }
-      case GP_DRAWING_REFERENCE: {
-        const GreasePencilDrawingReference *src_drawing_reference =
-            reinterpret_cast<const GreasePencilDrawingReference *>(src_drawing_base);
-        dst_drawings[i] = reinterpret_cast<GreasePencilDrawingBase *>(
-            MEM_new<bke::greasepencil::DrawingReference>(__func__, src_drawing_reference->wrap()));
-        break;
+  /* Drawings are independent from each other, and their geometry arrays are shared with the
+   * source. Copying many of them is still dominated by allocations and reference counting, which
+   * is distributed over multiple threads. */
+  threading::parallel_for(src_drawings.index_range(), 64, [&](const IndexRange range) {
+    for (const int i : range) {
+      const GreasePencilDrawingBase *src_drawing_base = src_drawings[i];
+      switch (src_drawing_base->type) {
+        case GP_DRAWING: {
+          const GreasePencilDrawing *src_drawing = reinterpret_cast<const GreasePencilDrawing *>(
+              src_drawing_base);
+          dst_drawings[i] = reinterpret_cast<GreasePencilDrawingBase *>(
+              MEM_new<bke::greasepencil::Drawing>(__func__, src_drawing->wrap()));
+          break;
+        }
+        case GP_DRAWING_REFERENCE: {
+          const GreasePencilDrawingReference *src_drawing_reference =
+              reinterpret_cast<const GreasePencilDrawingReference *>(src_drawing_base);
+          dst_drawings[i] = reinterpret_cast<GreasePencilDrawingBase *>(
+              MEM_new<bke::greasepencil::DrawingReference>(__func__,
+                                                           src_drawing_reference->wrap()));
+          break;
+        }
       }
     }
-  }
+  });
 }
 
 TreeNode::TreeNode()
@@ -87,6 +87,8 @@ enum {
 enum {
   /* calculate IsectRayPrecalc data */
   BVH_RAYCAST_WATERTIGHT = (1 << 0),
+  /* Trace the rays of #BLI_bvhtree_ray_cast_batch on multiple threads. */
+  BVH_RAYCAST_USE_THREADING = (1 << 1),
 };
 #define BVH_RAYCAST_DEFAULT (BVH_RAYCAST_WATERTIGHT)
 #define BVH_RAYCAST_DIST_MAX (FLT_MAX / 2.0f)
@@ -138,6 +140,12 @@ void BLI_bvhtree_free(BVHTree *tree);
  */
 void BLI_bvhtree_insert(BVHTree *tree, int index, const float co[3], int numpoints);
 void BLI_bvhtree_balance(BVHTree *tree);
+/**
+ * Alternative to #BLI_bvhtree_balance that splits nodes using the surface area heuristic.
+ * This is slower to build, but gives faster ray-casts and other queries on surfaces.
+ * Falls back to #BLI_bvhtree_balance for k-DOP types that don't have the X, Y and Z axes.
+ */
+void BLI_bvhtree_balance_sah(BVHTree *tree);
 
 /**
  * Update: first update points/nodes, then call update_tree to refit the bounding volumes.
@@ -154,7 +162,11 @@ bool BLI_bvhtree_update_node(
 void BLI_bvhtree_update_tree(BVHTree *tree);
 
 /**
- * Use to check the total number of threads #BLI_bvhtree_overlap will use.
+ * Use to check the total number of threads #BLI_bvhtree_overlap will use,
+ * the `thread` argument of #BVHTree_OverlapCallback is always below this number.
+ *
+ * The traversal is split into many small tasks that are shared by all threads of the pool,
+ * so this doesn't depend on the number of children of the root node.
  *
  * \warning Must be the first tree passed to #BLI_bvhtree_overlap!
  */
@@ -247,6 +259,25 @@ int BLI_bvhtree_ray_cast(const BVHTree *tree,
                          BVHTree_RayCastCallback callback,
                          void *userdata);
 
+/**
+ * Cast \a rays_num rays, like calling #BLI_bvhtree_ray_cast_ex for each of them.
+ * Coherent rays should be next to each other, they are traced in small packets that share
+ * the tree traversal.
+ *
+ * \param hits: One hit per ray. Like the single ray-cast, the input `index` and `dist` are used
+ * as the initial state, so `dist` limits the ray length.
+ * \param flag: With #BVH_RAYCAST_USE_THREADING the \a callback must be thread-safe.
+ */
+void BLI_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                int rays_num,
+                                float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                int flag);
+
 /**
  * Calls the callback for every ray intersection
  *
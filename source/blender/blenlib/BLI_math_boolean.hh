@@ -39,6 +39,15 @@ int incircle_fast(const double2 &a, const double2 &b, const double2 &c, const do
 int orient3d(const double3 &a, const double3 &b, const double3 &c, const double3 &d);
 int orient3d_fast(const double3 &a, const double3 &b, const double3 &c, const double3 &d);
 
+/**
+ * Floating point filter for the exact #orient3d of points whose exact (e.g. multi-precision)
+ * coordinates have been rounded to the given doubles. Returns the sign the exact #orient3d
+ * would give for the unrounded points, or 0 when the double computation can't decide it.
+ * A result of 0 therefore means "unknown", not "on the plane"; callers must fall back to
+ * an exact predicate in that case.
+ */
+int orient3d_filter(const double3 &a, const double3 &b, const double3 &c, const double3 &d);
+
 int insphere(
     const double3 &a, const double3 &b, const double3 &c, const double3 &d, const double3 &e);
 int insphere_fast(
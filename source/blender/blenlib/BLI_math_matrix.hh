@@ -397,6 +397,37 @@ template<typename MatT, typename VectorT>
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Batch Transform functions.
+ *
+ * Transform many elements with the same matrix. This gives the same result as calling the
+ * functions above in a loop, but several elements are processed at once with SIMD instructions
+ * when they are available. The source and destination may be the same span, but they must not
+ * overlap otherwise. The functions are not multi-threaded, the caller is expected to split large
+ * spans into chunks.
+ * \{ */
+
+/**
+ * Same as #transform_point for every point.
+ */
+void transform_points(const float4x4 &transform, Span<float3> src, MutableSpan<float3> dst);
+void transform_points(const float4x4 &transform, MutableSpan<float3> points);
+
+/**
+ * Same as #transform_direction for every direction. Normals can be transformed with the inverse
+ * transposed matrix.
+ */
+void transform_directions(const float3x3 &transform, Span<float3> src, MutableSpan<float3> dst);
+void transform_directions(const float3x3 &transform, MutableSpan<float3> directions);
+
+/**
+ * Multiply every matrix by \a transform, i.e. `dst[i] = transform * src[i]`.
+ */
+void transform_matrices(const float4x4 &transform, Span<float4x4> src, MutableSpan<float4x4> dst);
+void transform_matrices(const float4x4 &transform, MutableSpan<float4x4> matrices);
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Projection Matrices.
  * \{ */
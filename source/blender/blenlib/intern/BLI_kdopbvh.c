@@ -15,6 +15,8 @@
  *
  * - Ray-cast:
  *   #BLI_bvhtree_ray_cast, #BVHRayCastData
+ * - Batched ray-cast of ray packets:
+ *   #BLI_bvhtree_ray_cast_batch, #BVHRayPacket
  * - Nearest point on surface:
  *   #BLI_bvhtree_find_nearest, #BVHNearestData
  * - Overlapping 2 trees:
@@ -25,6 +27,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_alloca.h"
 #include "BLI_heap_simple.h"
 #include "BLI_kdopbvh.h"
@@ -35,6 +39,11 @@
 
 #include "BLI_strict_flags.h" /* Keep last. */
 
+#if defined(__SSE2__) || defined(_M_X64)
+#  include <emmintrin.h>
+#  define KDOPBVH_USE_SSE2
+#endif
+
 /* used for iterative_raycast */
 // #define USE_SKIP_LINKS
 
@@ -92,6 +101,17 @@ BLI_STATIC_ASSERT((sizeof(void *) == 8 && sizeof(BVHTree) <= 48) ||
                       (sizeof(void *) == 4 && sizeof(BVHTree) <= 32),
                   "over sized")
 
+/**
+ * A pair of sub-trees to test for overlap, the threaded overlap splits the traversal into many
+ * of these so that all threads of the pool can take part.
+ */
+typedef struct BVHOverlapTask {
+  /* When `node2` is NULL, this is the self-overlap of `node1`. */
+  const BVHNode *node1, *node2;
+  /* The overlaps found by this task, `len` items from `start` in the stack of `thread`. */
+  uint thread, start, len;
+} BVHOverlapTask;
+
 /* avoid duplicating vars in BVHOverlapData_Thread */
 typedef struct BVHOverlapData_Shared {
   const BVHTree *tree1, *tree2;
@@ -101,6 +121,12 @@ typedef struct BVHOverlapData_Shared {
   /* use for callbacks */
   BVHTree_OverlapCallback callback;
   void *userdata;
+
+  /* Used by the threaded traversal, the threads take the next task until all are done. */
+  BVHOverlapTask *tasks;
+  uint tasks_num;
+  uint task_next;
+  uint max_interactions;
 } BVHOverlapData_Shared;
 
 typedef struct BVHOverlapData_Thread {
@@ -856,6 +882,458 @@ static void non_recursive_bvh_div_nodes(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name SAH Build
+ *
+ * Top-down build that splits nodes using the surface area heuristic (SAH), which gives faster
+ * ray-casts than splitting at the median of the largest axis. The split candidates are the
+ * boundaries of equally sized bins along the X, Y and Z axes, see
+ * "On fast Construction of SAH-based Bounding Volume Hierarchies" by Ingo Wald.
+ *
+ * Nodes are split until they have `tree_type` children, by splitting the child with the highest
+ * cost again. Unlike the implicit tree, the number of branches depends on the splits, so
+ * branches are allocated from a counter. Children are always allocated after their parent, which
+ * #BLI_bvhtree_update_tree relies on.
+ * \{ */
+
+#define SAH_BINS_NUM 16
+
+/* Use multiple threads to fill the bins of nodes with more leafs. */
+#define SAH_THREAD_BINNING_THRESHOLD 65536
+
+typedef struct SAHBounds {
+  float min[3];
+  float max[3];
+} SAHBounds;
+
+typedef struct SAHRangeBounds {
+  SAHBounds bounds;
+  SAHBounds centroid_bounds;
+} SAHRangeBounds;
+
+typedef struct SAHBin {
+  SAHBounds bounds;
+  int count;
+} SAHBin;
+
+typedef struct SAHBinning {
+  SAHBin bins[3][SAH_BINS_NUM];
+} SAHBinning;
+
+typedef struct SAHSplit {
+  int mid;
+  int axis;
+  float area_left;
+  float area_right;
+} SAHSplit;
+
+typedef struct BVHSAHBuildData {
+  BVHTree *tree;
+  BVHNode **leafs_array;
+  int branch_num;
+} BVHSAHBuildData;
+
+typedef struct BVHSAHRangeData {
+  BVHNode **leafs_array;
+  /* Binning parameters. */
+  float bin_min[3];
+  float bin_scale[3];
+} BVHSAHRangeData;
+
+static void sah_bounds_init(SAHBounds *bounds)
+{
+  copy_v3_fl(bounds->min, FLT_MAX);
+  copy_v3_fl(bounds->max, -FLT_MAX);
+}
+
+static void sah_bounds_join(SAHBounds *bounds, const SAHBounds *other)
+{
+  for (int axis = 0; axis < 3; axis++) {
+    bounds->min[axis] = min_ff(bounds->min[axis], other->min[axis]);
+    bounds->max[axis] = max_ff(bounds->max[axis], other->max[axis]);
+  }
+}
+
+static void sah_bounds_add_leaf(SAHBounds *bounds, const BVHNode *leaf)
+{
+  for (int axis = 0; axis < 3; axis++) {
+    bounds->min[axis] = min_ff(bounds->min[axis], leaf->bv[2 * axis]);
+    bounds->max[axis] = max_ff(bounds->max[axis], leaf->bv[2 * axis + 1]);
+  }
+}
+
+/** Half of the surface area, the factor doesn't matter when comparing costs. */
+static float sah_bounds_half_area(const SAHBounds *bounds)
+{
+  float size[3];
+  sub_v3_v3v3(size, bounds->max, bounds->min);
+  if (size[0] < 0.0f) {
+    return 0.0f;
+  }
+  return size[0] * size[1] + size[1] * size[2] + size[2] * size[0];
+}
+
+static float sah_leaf_centroid(const BVHNode *leaf, const int axis)
+{
+  return (leaf->bv[2 * axis] + leaf->bv[2 * axis + 1]) * 0.5f;
+}
+
+static int sah_leaf_bin(const BVHSAHRangeData *data, const BVHNode *leaf, const int axis)
+{
+  const int bin = (int)((sah_leaf_centroid(leaf, axis) - data->bin_min[axis]) *
+                        data->bin_scale[axis]);
+  return clamp_i(bin, 0, SAH_BINS_NUM - 1);
+}
+
+static void sah_range_bounds_task_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict tls)
+{
+  const BVHSAHRangeData *data = userdata;
+  SAHRangeBounds *range_bounds = tls->userdata_chunk;
+  const BVHNode *leaf = data->leafs_array[i];
+  float centroid[3];
+  for (int axis = 0; axis < 3; axis++) {
+    centroid[axis] = sah_leaf_centroid(leaf, axis);
+  }
+  sah_bounds_add_leaf(&range_bounds->bounds, leaf);
+  minmax_v3v3_v3(range_bounds->centroid_bounds.min, range_bounds->centroid_bounds.max, centroid);
+}
+
+static void sah_range_bounds_reduce(const void *__restrict UNUSED(userdata),
+                                    void *__restrict chunk_join,
+                                    void *__restrict chunk)
+{
+  SAHRangeBounds *join = chunk_join;
+  const SAHRangeBounds *range_bounds = chunk;
+  sah_bounds_join(&join->bounds, &range_bounds->bounds);
+  sah_bounds_join(&join->centroid_bounds, &range_bounds->centroid_bounds);
+}
+
+static void sah_binning_task_cb(void *__restrict userdata,
+                                const int i,
+                                const TaskParallelTLS *__restrict tls)
+{
+  const BVHSAHRangeData *data = userdata;
+  SAHBinning *binning = tls->userdata_chunk;
+  const BVHNode *leaf = data->leafs_array[i];
+  for (int axis = 0; axis < 3; axis++) {
+    SAHBin *bin = &binning->bins[axis][sah_leaf_bin(data, leaf, axis)];
+    sah_bounds_add_leaf(&bin->bounds, leaf);
+    bin->count++;
+  }
+}
+
+static void sah_binning_reduce(const void *__restrict UNUSED(userdata),
+                               void *__restrict chunk_join,
+                               void *__restrict chunk)
+{
+  SAHBinning *join = chunk_join;
+  const SAHBinning *binning = chunk;
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < SAH_BINS_NUM; i++) {
+      sah_bounds_join(&join->bins[axis][i].bounds, &binning->bins[axis][i].bounds);
+      join->bins[axis][i].count += binning->bins[axis][i].count;
+    }
+  }
+}
+
+/**
+ * Find the split of the leafs in the given range with the lowest cost, and partition them.
+ */
+static SAHSplit sah_split_leafs(BVHNode **leafs_array, const int begin, const int end)
+{
+  const int leafs_num = end - begin;
+  BVHSAHRangeData data = {.leafs_array = leafs_array};
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (leafs_num > SAH_THREAD_BINNING_THRESHOLD);
+  settings.min_iter_per_thread = 4096;
+
+  SAHRangeBounds range_bounds;
+  sah_bounds_init(&range_bounds.bounds);
+  sah_bounds_init(&range_bounds.centroid_bounds);
+  settings.userdata_chunk = &range_bounds;
+  settings.userdata_chunk_size = sizeof(range_bounds);
+  settings.func_reduce = sah_range_bounds_reduce;
+  BLI_task_parallel_range(begin, end, &data, sah_range_bounds_task_cb, &settings);
+
+  bool use_axis[3];
+  for (int axis = 0; axis < 3; axis++) {
+    const float extent = range_bounds.centroid_bounds.max[axis] -
+                         range_bounds.centroid_bounds.min[axis];
+    use_axis[axis] = extent > 0.0f;
+    data.bin_min[axis] = range_bounds.centroid_bounds.min[axis];
+    data.bin_scale[axis] = use_axis[axis] ? (float)SAH_BINS_NUM * (1.0f - FLT_EPSILON) / extent :
+                                            0.0f;
+  }
+
+  SAHSplit split = {
+      .mid = begin + leafs_num / 2,
+      .axis = 0,
+      .area_left = sah_bounds_half_area(&range_bounds.bounds),
+      .area_right = sah_bounds_half_area(&range_bounds.bounds),
+  };
+  if (!(use_axis[0] || use_axis[1] || use_axis[2])) {
+    /* All centroids are the same, any split is as good as another. */
+    return split;
+  }
+  if (leafs_num == 2) {
+    /* There is only one possible split, order the leafs along the largest axis. */
+    const float *centroid_min = range_bounds.centroid_bounds.min;
+    const float *centroid_max = range_bounds.centroid_bounds.max;
+    for (int axis = 1; axis < 3; axis++) {
+      if (centroid_max[axis] - centroid_min[axis] >
+          centroid_max[split.axis] - centroid_min[split.axis])
+      {
+        split.axis = axis;
+      }
+    }
+    if (sah_leaf_centroid(leafs_array[begin], split.axis) >
+        sah_leaf_centroid(leafs_array[begin + 1], split.axis))
+    {
+      SWAP(BVHNode *, leafs_array[begin], leafs_array[begin + 1]);
+    }
+    return split;
+  }
+
+  SAHBinning binning;
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < SAH_BINS_NUM; i++) {
+      sah_bounds_init(&binning.bins[axis][i].bounds);
+      binning.bins[axis][i].count = 0;
+    }
+  }
+  settings.userdata_chunk = &binning;
+  settings.userdata_chunk_size = sizeof(binning);
+  settings.func_reduce = sah_binning_reduce;
+  BLI_task_parallel_range(begin, end, &data, sah_binning_task_cb, &settings);
+
+  /* Evaluate the cost of splitting at every bin boundary, by sweeping from both sides. */
+  float best_cost = FLT_MAX;
+  int best_bin = 0;
+  for (int axis = 0; axis < 3; axis++) {
+    if (!use_axis[axis]) {
+      continue;
+    }
+    const SAHBin *bins = binning.bins[axis];
+    float right_area[SAH_BINS_NUM];
+    int right_count[SAH_BINS_NUM];
+    SAHBounds bounds;
+    sah_bounds_init(&bounds);
+    int count = 0;
+    for (int i = SAH_BINS_NUM - 1; i > 0; i--) {
+      sah_bounds_join(&bounds, &bins[i].bounds);
+      count += bins[i].count;
+      right_area[i] = sah_bounds_half_area(&bounds);
+      right_count[i] = count;
+    }
+    sah_bounds_init(&bounds);
+    count = 0;
+    for (int i = 1; i < SAH_BINS_NUM; i++) {
+      sah_bounds_join(&bounds, &bins[i - 1].bounds);
+      count += bins[i - 1].count;
+      if (count == 0 || right_count[i] == 0) {
+        continue;
+      }
+      const float left_area = sah_bounds_half_area(&bounds);
+      const float cost = left_area * (float)count + right_area[i] * (float)right_count[i];
+      if (cost < best_cost) {
+        best_cost = cost;
+        best_bin = i;
+        split.mid = begin + count;
+        split.axis = axis;
+        split.area_left = left_area;
+        split.area_right = right_area[i];
+      }
+    }
+  }
+
+  /* Move the leafs in the bins before the split to the front. */
+  int i = begin;
+  int j = end - 1;
+  while (i <= j) {
+    if (sah_leaf_bin(&data, leafs_array[i], split.axis) < best_bin) {
+      i++;
+    }
+    else {
+      SWAP(BVHNode *, leafs_array[i], leafs_array[j]);
+      j--;
+    }
+  }
+  BLI_assert(i == split.mid);
+  return split;
+}
+
+static BVHNode *sah_branch_alloc(BVHSAHBuildData *data)
+{
+  const int index = (int)atomic_fetch_and_add_int32(&data->branch_num, 1);
+  return &data->tree->nodearray[data->tree->leaf_num + index];
+}
+
+static void sah_build_branch(BVHSAHBuildData *data, BVHNode *node, int begin, int end);
+
+typedef struct BVHSAHChildrenData {
+  BVHSAHBuildData *data;
+  BVHNode *node;
+  const int *group_begin;
+  const int *group_end;
+} BVHSAHChildrenData;
+
+static void sah_build_children_task_cb(void *__restrict userdata,
+                                       const int i,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHSAHChildrenData *children_data = userdata;
+  const int begin = children_data->group_begin[i];
+  const int end = children_data->group_end[i];
+  if (end - begin > 1) {
+    sah_build_branch(children_data->data, children_data->node->children[i], begin, end);
+  }
+}
+
+static void sah_build_branch(BVHSAHBuildData *data, BVHNode *node, int begin, int end)
+{
+  BVHTree *tree = data->tree;
+  int group_begin[MAX_TREETYPE];
+  int group_end[MAX_TREETYPE];
+  float group_cost[MAX_TREETYPE];
+  int groups_num = 1;
+  group_begin[0] = begin;
+  group_end[0] = end;
+  group_cost[0] = FLT_MAX;
+  node->main_axis = 0;
+
+  while (groups_num < tree->tree_type) {
+    int split_group = -1;
+    for (int i = 0; i < groups_num; i++) {
+      if (group_end[i] - group_begin[i] > 1 &&
+          (split_group == -1 || group_cost[i] > group_cost[split_group]))
+      {
+        split_group = i;
+      }
+    }
+    if (split_group == -1) {
+      break;
+    }
+
+    const SAHSplit split = sah_split_leafs(
+        data->leafs_array, group_begin[split_group], group_end[split_group]);
+    if (groups_num == 1) {
+      /* The children are ordered along this axis, which is used to order ray-cast traversal. */
+      node->main_axis = (char)split.axis;
+    }
+
+    /* Keep the groups in order, the new group comes right after the split one. */
+    for (int i = groups_num; i > split_group + 1; i--) {
+      group_begin[i] = group_begin[i - 1];
+      group_end[i] = group_end[i - 1];
+      group_cost[i] = group_cost[i - 1];
+    }
+    group_begin[split_group + 1] = split.mid;
+    group_end[split_group + 1] = group_end[split_group];
+    group_cost[split_group + 1] = split.area_right * (float)(group_end[split_group] - split.mid);
+    group_end[split_group] = split.mid;
+    group_cost[split_group] = split.area_left * (float)(split.mid - group_begin[split_group]);
+    groups_num++;
+  }
+
+  for (int i = 0; i < groups_num; i++) {
+    BVHNode *child = (group_end[i] - group_begin[i] == 1) ? data->leafs_array[group_begin[i]] :
+                                                            sah_branch_alloc(data);
+    child->parent = node;
+    node->children[i] = child;
+  }
+  node->node_num = (char)groups_num;
+
+  BVHSAHChildrenData children_data = {
+      .data = data,
+      .node = node,
+      .group_begin = group_begin,
+      .group_end = group_end,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (end - begin > KDOPBVH_THREAD_LEAF_THRESHOLD);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, groups_num, &children_data, sah_build_children_task_cb, &settings);
+
+  node_join(tree, node);
+}
+
+/**
+ * Make sure there are slots for the given number of nodes, the implicit tree needs fewer
+ * branches than the SAH build for trees with more than two children per node.
+ */
+static void bvhtree_ensure_nodes_num(BVHTree *tree, const int nodes_num)
+{
+  const int nodes_num_prev = (int)(MEM_allocN_len(tree->nodes) / sizeof(*tree->nodes));
+  if (nodes_num <= nodes_num_prev) {
+    return;
+  }
+  tree->nodes = MEM_recallocN(tree->nodes, sizeof(BVHNode *) * (size_t)nodes_num);
+  tree->nodebv = MEM_recallocN(tree->nodebv, sizeof(float) * (size_t)(tree->axis * nodes_num));
+  tree->nodechild = MEM_recallocN(tree->nodechild,
+                                  sizeof(BVHNode *) * (size_t)(tree->tree_type * nodes_num));
+  tree->nodearray = MEM_recallocN(tree->nodearray, sizeof(BVHNode) * (size_t)nodes_num);
+
+  /* Re-link the dynamic bv and child links, and the inserted leafs. */
+  for (int i = 0; i < nodes_num; i++) {
+    tree->nodearray[i].bv = &tree->nodebv[i * tree->axis];
+    tree->nodearray[i].children = &tree->nodechild[i * tree->tree_type];
+  }
+  for (int i = 0; i < tree->leaf_num; i++) {
+    tree->nodes[i] = &tree->nodearray[i];
+  }
+}
+
+/**
+ * Free the node slots that were not used by the SAH build, which usually needs far fewer branches
+ * than the upper bound reserved by #bvhtree_ensure_nodes_num.
+ */
+static void bvhtree_shrink_nodes_num(BVHTree *tree)
+{
+  const int nodes_num = tree->leaf_num + tree->branch_num;
+  const int nodes_num_prev = (int)(MEM_allocN_len(tree->nodes) / sizeof(*tree->nodes));
+  if (nodes_num >= nodes_num_prev) {
+    return;
+  }
+
+  BVHNode *nodearray_prev = tree->nodearray;
+  BVHNode *nodearray = MEM_mallocN(sizeof(BVHNode) * (size_t)nodes_num, "BVHNodeArray");
+  float *nodebv = MEM_mallocN(sizeof(float) * (size_t)(tree->axis * nodes_num), "BVHNodeBV");
+  BVHNode **nodechild = MEM_callocN(sizeof(BVHNode *) * (size_t)(tree->tree_type * nodes_num),
+                                    "BVHNodeBV");
+  memcpy(nodebv, tree->nodebv, sizeof(float) * (size_t)(tree->axis * nodes_num));
+
+  /* Nodes keep their index, so links are remapped to the same index in the new array. */
+  for (int i = 0; i < nodes_num; i++) {
+    const BVHNode *node_prev = &nodearray_prev[i];
+    BVHNode *node = &nodearray[i];
+    *node = *node_prev;
+    node->bv = &nodebv[i * tree->axis];
+    node->children = &nodechild[i * tree->tree_type];
+    node->parent = node_prev->parent ? &nodearray[node_prev->parent - nodearray_prev] : NULL;
+    for (int j = 0; j < node_prev->node_num; j++) {
+      node->children[j] = &nodearray[node_prev->children[j] - nodearray_prev];
+    }
+  }
+  for (int i = 0; i < nodes_num; i++) {
+    tree->nodes[i] = &nodearray[tree->nodes[i] - nodearray_prev];
+  }
+  tree->nodes = MEM_reallocN(tree->nodes, sizeof(BVHNode *) * (size_t)nodes_num);
+
+  MEM_freeN(tree->nodearray);
+  MEM_freeN(tree->nodebv);
+  MEM_freeN(tree->nodechild);
+  tree->nodearray = nodearray;
+  tree->nodebv = nodebv;
+  tree->nodechild = nodechild;
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree API
  * \{ */
@@ -975,6 +1453,43 @@ void BLI_bvhtree_balance(BVHTree *tree)
 #endif
 }
 
+void BLI_bvhtree_balance_sah(BVHTree *tree)
+{
+  /* The SAH is computed from the X, Y and Z axes. */
+  if (tree->leaf_num < 2 || tree->start_axis != 0 || tree->stop_axis < 3) {
+    BLI_bvhtree_balance(tree);
+    return;
+  }
+
+  BLI_assert(tree->branch_num == 0);
+
+  /* Every branch has at least two children. */
+  bvhtree_ensure_nodes_num(tree, tree->leaf_num * 2 - 1);
+
+  BVHSAHBuildData data = {
+      .tree = tree,
+      .leafs_array = tree->nodes,
+      .branch_num = 0,
+  };
+  BVHNode *root = sah_branch_alloc(&data);
+  root->parent = NULL;
+  sah_build_branch(&data, root, 0, tree->leaf_num);
+
+  tree->branch_num = data.branch_num;
+  for (int i = 0; i < tree->branch_num; i++) {
+    tree->nodes[tree->leaf_num + i] = &tree->nodearray[tree->leaf_num + i];
+  }
+  bvhtree_shrink_nodes_num(tree);
+
+#ifdef USE_SKIP_LINKS
+  build_skip_links(tree, tree->nodes[tree->leaf_num], NULL, NULL);
+#endif
+
+#ifdef USE_VERIFY_TREE
+  bvhtree_verify(tree);
+#endif
+}
+
 static void bvhtree_node_inflate(const BVHTree *tree, BVHNode *node, const float dist)
 {
   axis_t axis_iter;
@@ -1297,9 +1812,71 @@ static void tree_overlap_invoke_traverse_self(BVHOverlapData_Thread *data_thread
   }
 }
 
-int BLI_bvhtree_overlap_thread_num(const BVHTree *tree)
+int BLI_bvhtree_overlap_thread_num(const BVHTree *UNUSED(tree))
 {
-  return (int)MIN2(tree->tree_type, tree->nodes[tree->leaf_num]->node_num);
+  return BLI_task_scheduler_num_threads();
+}
+
+/* Number of tasks the threaded overlap aims for per thread, so that threads which finish early
+ * can pick up the remaining work. */
+#define BVH_OVERLAP_TASKS_PER_THREAD 8
+
+/**
+ * Split the overlap traversal of two sub-trees into tasks, descending \a depth levels.
+ * Tasks are added in the order the recursive traversal would visit them, so processing them in
+ * order gives the same result as a single threaded traversal.
+ *
+ * \param node2: NULL for the self-overlap of \a node1.
+ * \param split_node2: When false, only descend into \a node1,
+ * the interaction limit of #tree_overlap_traverse_num is only reset for the children of node1.
+ */
+static void bvhtree_overlap_tasks_split(const BVHOverlapData_Shared *data,
+                                        BLI_Stack *tasks,
+                                        const BVHNode *node1,
+                                        const BVHNode *node2,
+                                        const bool split_node2,
+                                        const int depth)
+{
+  if (node2 == NULL) {
+    if (depth == 0) {
+      BVHOverlapTask *task = BLI_stack_push_r(tasks);
+      task->node1 = node1;
+      task->node2 = NULL;
+      return;
+    }
+    /* This matches #tree_overlap_traverse_self. */
+    for (int i = 0; i < node1->node_num; i++) {
+      bvhtree_overlap_tasks_split(data, tasks, node1->children[i], NULL, split_node2, depth - 1);
+      for (int j = i + 1; j < node1->node_num; j++) {
+        bvhtree_overlap_tasks_split(
+            data, tasks, node1->children[i], node1->children[j], split_node2, depth - 1);
+      }
+    }
+    return;
+  }
+
+  if (!tree_overlap_test(node1, node2, data->start_axis, data->stop_axis)) {
+    return;
+  }
+
+  if (depth == 0 || (!node1->node_num && (!node2->node_num || !split_node2))) {
+    BVHOverlapTask *task = BLI_stack_push_r(tasks);
+    task->node1 = node1;
+    task->node2 = node2;
+    return;
+  }
+
+  /* This matches #tree_overlap_traverse. */
+  if (node1->node_num) {
+    for (int j = 0; j < node1->node_num; j++) {
+      bvhtree_overlap_tasks_split(data, tasks, node1->children[j], node2, split_node2, depth - 1);
+    }
+  }
+  else {
+    for (int j = 0; j < node2->node_num; j++) {
+      bvhtree_overlap_tasks_split(data, tasks, node1, node2->children[j], split_node2, depth - 1);
+    }
+  }
 }
 
 static void bvhtree_overlap_task_cb(void *__restrict userdata,
@@ -1309,20 +1886,25 @@ static void bvhtree_overlap_task_cb(void *__restrict userdata,
   BVHOverlapData_Thread *data = &((BVHOverlapData_Thread *)userdata)[j];
   BVHOverlapData_Shared *data_shared = data->shared;
 
-  const BVHNode *root1 = data_shared->tree1->nodes[data_shared->tree1->leaf_num];
-
-  if (data_shared->use_self) {
-    /* This code matches one outer loop iteration within traverse_self. */
-    tree_overlap_invoke_traverse_self(data, root1->children[j]);
+  uint task_index;
+  while ((task_index = atomic_fetch_and_add_uint32(&data_shared->task_next, 1)) <
+         data_shared->tasks_num)
+  {
+    BVHOverlapTask *task = &data_shared->tasks[task_index];
+    task->thread = (uint)j;
+    task->start = data->overlap ? (uint)BLI_stack_count(data->overlap) : 0;
 
-    for (int k = j + 1; k < root1->node_num; k++) {
-      tree_overlap_invoke_traverse(data, root1->children[j], root1->children[k]);
+    /* Each task starts with the full limit, like the children of a node in the recursion
+     * with a limit of one. */
+    data->max_interactions = data_shared->max_interactions;
+    if (task->node2 == NULL) {
+      tree_overlap_invoke_traverse_self(data, task->node1);
+    }
+    else {
+      tree_overlap_invoke_traverse(data, task->node1, task->node2);
     }
-  }
-  else {
-    const BVHNode *root2 = data_shared->tree2->nodes[data_shared->tree2->leaf_num];
 
-    tree_overlap_invoke_traverse(data, root1->children[j], root2);
+    task->len = data->overlap ? (uint)BLI_stack_count(data->overlap) - task->start : 0;
   }
 }
 
@@ -1337,8 +1919,11 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
     const int flag)
 {
   bool overlap_pairs = (flag & BVH_OVERLAP_RETURN_PAIRS) != 0;
+  /* With a limit above one, the interactions left over by a child of a node carry over to its
+   * next sibling, so the traversal can't be split into independent tasks. */
   bool use_threading = (flag & BVH_OVERLAP_USE_THREADING) != 0 &&
-                       (tree1->leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD);
+                       (tree1->leaf_num > KDOPBVH_THREAD_LEAF_THRESHOLD) &&
+                       (max_interactions <= 1);
   bool use_self = (flag & BVH_OVERLAP_SELF) != 0;
 
   /* 'RETURN_PAIRS' was not implemented without 'max_interactions'. */
@@ -1346,13 +1931,12 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
   /* Self-overlap does not support max interactions (it's not symmetrical). */
   BLI_assert(!use_self || (tree1 == tree2 && !max_interactions));
 
-  const int root_node_len = BLI_bvhtree_overlap_thread_num(tree1);
-  const int thread_num = use_threading ? root_node_len : 1;
+  int thread_num = use_threading ? BLI_bvhtree_overlap_thread_num(tree1) : 1;
   int j;
   size_t total = 0;
   BVHTreeOverlap *overlap = NULL, *to = NULL;
   BVHOverlapData_Shared data_shared;
-  BVHOverlapData_Thread *data = BLI_array_alloca(data, (size_t)thread_num);
+  BVHOverlapData_Thread *data;
   axis_t start_axis, stop_axis;
 
   /* check for compatibility of both trees (can't compare 14-DOP with 18-DOP) */
@@ -1388,11 +1972,41 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
   data_shared.callback = callback;
   data_shared.userdata = userdata;
 
+  data_shared.tasks = NULL;
+  data_shared.tasks_num = 0;
+  data_shared.task_next = 0;
+  data_shared.max_interactions = use_self ? 0 : max_interactions;
+
+  if (use_threading) {
+    /* Split the traversal deep enough to get a few tasks for every thread,
+     * instead of only the children of the root. */
+    const int tasks_num_min = thread_num * BVH_OVERLAP_TASKS_PER_THREAD;
+    int depth = 0;
+    for (int tasks_num = 1; tasks_num < tasks_num_min; tasks_num *= tree1->tree_type) {
+      depth++;
+    }
+    BLI_Stack *tasks = BLI_stack_new(sizeof(BVHOverlapTask), __func__);
+    bvhtree_overlap_tasks_split(&data_shared,
+                                tasks,
+                                root1,
+                                use_self ? NULL : root2,
+                                data_shared.max_interactions == 0,
+                                depth);
+    data_shared.tasks_num = (uint)BLI_stack_count(tasks);
+    data_shared.tasks = MEM_mallocN(sizeof(BVHOverlapTask) * MAX2(data_shared.tasks_num, 1),
+                                    __func__);
+    BLI_stack_pop_n_reverse(tasks, data_shared.tasks, data_shared.tasks_num);
+    BLI_stack_free(tasks);
+
+    thread_num = (int)MIN2((uint)thread_num, MAX2(data_shared.tasks_num, 1));
+  }
+
+  data = BLI_array_alloca(data, (size_t)thread_num);
   for (j = 0; j < thread_num; j++) {
     /* init BVHOverlapData_Thread */
     data[j].shared = &data_shared;
     data[j].overlap = overlap_pairs ? BLI_stack_new(sizeof(BVHTreeOverlap), __func__) : NULL;
-    data[j].max_interactions = use_self ? 0 : max_interactions;
+    data[j].max_interactions = data_shared.max_interactions;
 
     /* for callback */
     data[j].thread = j;
@@ -1402,7 +2016,7 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
     TaskParallelSettings settings;
     BLI_parallel_range_settings_defaults(&settings);
     settings.min_iter_per_thread = 1;
-    BLI_task_parallel_range(0, root_node_len, data, bvhtree_overlap_task_cb, &settings);
+    BLI_task_parallel_range(0, thread_num, data, bvhtree_overlap_task_cb, &settings);
   }
   else if (use_self) {
     tree_overlap_invoke_traverse_self(data, root1);
@@ -1418,15 +2032,45 @@ BVHTreeOverlap *BLI_bvhtree_overlap_ex(
 
     to = overlap = MEM_mallocN(sizeof(BVHTreeOverlap) * total, "BVHTreeOverlap");
 
-    for (j = 0; j < thread_num; j++) {
-      uint count = (uint)BLI_stack_count(data[j].overlap);
-      BLI_stack_pop_n(data[j].overlap, to, count);
-      BLI_stack_free(data[j].overlap);
-      to += count;
+    if (use_threading) {
+      /* Gather the results in reverse task order, so they don't depend on the thread scheduling
+       * and match the single threaded result, which is popped from the end of the traversal.
+       * Popping reverses every thread, so a task ends at `thread_end - task->start`. */
+      BVHTreeOverlap *thread_overlap = MEM_mallocN(sizeof(BVHTreeOverlap) * MAX2(total, 1),
+                                                   __func__);
+      uint *thread_end = BLI_array_alloca(thread_end, (size_t)thread_num);
+      uint offset = 0;
+      for (j = 0; j < thread_num; j++) {
+        uint count = (uint)BLI_stack_count(data[j].overlap);
+        BLI_stack_pop_n(data[j].overlap, thread_overlap + offset, count);
+        BLI_stack_free(data[j].overlap);
+        offset += count;
+        thread_end[j] = offset;
+      }
+      for (uint i = data_shared.tasks_num; i--;) {
+        const BVHOverlapTask *task = &data_shared.tasks[i];
+        memcpy(to,
+               thread_overlap + thread_end[task->thread] - task->start - task->len,
+               sizeof(BVHTreeOverlap) * task->len);
+        to += task->len;
+      }
+      MEM_freeN(thread_overlap);
+    }
+    else {
+      for (j = 0; j < thread_num; j++) {
+        uint count = (uint)BLI_stack_count(data[j].overlap);
+        BLI_stack_pop_n(data[j].overlap, to, count);
+        BLI_stack_free(data[j].overlap);
+        to += count;
+      }
     }
     *r_overlap_num = (uint)total;
   }
 
+  if (data_shared.tasks) {
+    MEM_freeN(data_shared.tasks);
+  }
+
   return overlap;
 }
 
@@ -2119,6 +2763,257 @@ void BLI_bvhtree_ray_cast_all(const BVHTree *tree,
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name BLI_bvhtree_ray_cast_batch
+ *
+ * Casts many rays at once. Rays are grouped in packets of #BVH_RAY_PACKET_SIZE which traverse
+ * the tree together, so every node is loaded once for the whole packet and the box tests of
+ * all lanes run in a single SIMD pass. This pays off for coherent rays (neighboring pixels of a
+ * bake, vertices of a modifier), packets of diverging rays just visit the union of their nodes.
+ *
+ * \{ */
+
+#define BVH_RAY_PACKET_SIZE 4
+
+/* Number of packets handled by one task. */
+#define BVH_RAY_PACKET_GRAIN_SIZE 64
+
+typedef struct BVHRayPacket {
+  /* Scalar data of each lane, passed to the callback at leaf nodes. */
+  BVHRayCastData rays[BVH_RAY_PACKET_SIZE];
+
+  /* Lanes stored per axis, for the SIMD box test. */
+  float origin[3][BVH_RAY_PACKET_SIZE];
+  float idot_axis[3][BVH_RAY_PACKET_SIZE];
+  /* Copy of `rays[lane].hit.dist`, kept in sync after every leaf. */
+  float hit_dist[BVH_RAY_PACKET_SIZE];
+} BVHRayPacket;
+
+typedef struct BVHRayCastBatchData {
+  const BVHTree *tree;
+  const float (*co)[3];
+  const float (*dir)[3];
+  int rays_num;
+  float radius;
+  BVHTreeRayHit *hits;
+  BVHTree_RayCastCallback callback;
+  void *userdata;
+  int flag;
+} BVHRayCastBatchData;
+
+/**
+ * Slab test of all lanes of the packet against an axis aligned box.
+ * Like #fast_ray_nearest_hit, but the near and far planes are sorted with min/max
+ * instead of a per ray index, so lanes with different directions share the same code.
+ *
+ * \return A bit-mask of the lanes which enter the box before their current hit distance.
+ */
+static int ray_packet_nearest_hit(const BVHRayPacket *packet,
+                                  const float bv[6],
+                                  float r_dist[BVH_RAY_PACKET_SIZE])
+{
+#ifdef KDOPBVH_USE_SSE2
+  __m128 t_near = _mm_set1_ps(-FLT_MAX);
+  __m128 t_far = _mm_set1_ps(FLT_MAX);
+  for (int axis = 0; axis < 3; axis++) {
+    const __m128 origin = _mm_loadu_ps(packet->origin[axis]);
+    const __m128 idot = _mm_loadu_ps(packet->idot_axis[axis]);
+    const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[2 * axis]), origin), idot);
+    const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(bv[2 * axis + 1]), origin), idot);
+    t_near = _mm_max_ps(t_near, _mm_min_ps(t1, t2));
+    t_far = _mm_min_ps(t_far, _mm_max_ps(t1, t2));
+  }
+  const __m128 is_hit = _mm_and_ps(
+      _mm_and_ps(_mm_cmple_ps(t_near, t_far), _mm_cmpge_ps(t_far, _mm_setzero_ps())),
+      _mm_cmplt_ps(t_near, _mm_loadu_ps(packet->hit_dist)));
+  _mm_storeu_ps(r_dist, t_near);
+  return _mm_movemask_ps(is_hit);
+#else
+  int mask = 0;
+  for (int lane = 0; lane < BVH_RAY_PACKET_SIZE; lane++) {
+    float t_near = -FLT_MAX;
+    float t_far = FLT_MAX;
+    for (int axis = 0; axis < 3; axis++) {
+      const float t1 = (bv[2 * axis] - packet->origin[axis][lane]) *
+                       packet->idot_axis[axis][lane];
+      const float t2 = (bv[2 * axis + 1] - packet->origin[axis][lane]) *
+                       packet->idot_axis[axis][lane];
+      t_near = max_ff(t_near, min_ff(t1, t2));
+      t_far = min_ff(t_far, max_ff(t1, t2));
+    }
+    r_dist[lane] = t_near;
+    if (t_near <= t_far && t_far >= 0.0f && t_near < packet->hit_dist[lane]) {
+      mask |= 1 << lane;
+    }
+  }
+  return mask;
+#endif
+}
+
+static void dfs_raycast_packet(BVHRayPacket *packet, const BVHNode *node, int mask)
+{
+  float dist[BVH_RAY_PACKET_SIZE];
+  mask &= ray_packet_nearest_hit(packet, node->bv, dist);
+  if (mask == 0) {
+    return;
+  }
+
+  if (node->node_num == 0) {
+    for (int lane = 0; lane < BVH_RAY_PACKET_SIZE; lane++) {
+      if ((mask & (1 << lane)) == 0) {
+        continue;
+      }
+      BVHRayCastData *data = &packet->rays[lane];
+      if (data->callback) {
+        data->callback(data->userdata, node->index, &data->ray, &data->hit);
+      }
+      else {
+        data->hit.index = node->index;
+        data->hit.dist = dist[lane];
+        madd_v3_v3v3fl(data->hit.co, data->ray.origin, data->ray.direction, dist[lane]);
+      }
+      packet->hit_dist[lane] = data->hit.dist;
+    }
+  }
+  else {
+    /* Pick the loop direction from the first active lane,
+     * rays in a coherent packet mostly agree on it. */
+    int lead = 0;
+    while ((mask & (1 << lead)) == 0) {
+      lead++;
+    }
+    if (packet->rays[lead].ray_dot_axis[node->main_axis] > 0.0f) {
+      for (int i = 0; i != node->node_num; i++) {
+        dfs_raycast_packet(packet, node->children[i], mask);
+      }
+    }
+    else {
+      for (int i = node->node_num - 1; i >= 0; i--) {
+        dfs_raycast_packet(packet, node->children[i], mask);
+      }
+    }
+  }
+}
+
+static void bvhtree_ray_cast_batch_ray_init(const BVHRayCastBatchData *batch_data,
+                                            BVHRayCastData *data,
+                                            const int ray_index)
+{
+  BLI_ASSERT_UNIT_V3(batch_data->dir[ray_index]);
+
+  data->tree = batch_data->tree;
+  data->callback = batch_data->callback;
+  data->userdata = batch_data->userdata;
+
+  copy_v3_v3(data->ray.origin, batch_data->co[ray_index]);
+  copy_v3_v3(data->ray.direction, batch_data->dir[ray_index]);
+  data->ray.radius = batch_data->radius;
+
+  bvhtree_ray_cast_data_precalc(data, batch_data->flag);
+
+  memcpy(&data->hit, &batch_data->hits[ray_index], sizeof(data->hit));
+}
+
+static void bvhtree_ray_cast_batch_packet_cb(void *__restrict userdata,
+                                             const int packet_index,
+                                             const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *batch_data = (const BVHRayCastBatchData *)userdata;
+  const BVHTree *tree = batch_data->tree;
+  BVHNode *root = tree->nodes[tree->leaf_num];
+
+  const int ray_start = packet_index * BVH_RAY_PACKET_SIZE;
+  const int rays_num = min_ii(BVH_RAY_PACKET_SIZE, batch_data->rays_num - ray_start);
+
+  BVHRayPacket packet;
+  int mask = 0;
+  for (int lane = 0; lane < BVH_RAY_PACKET_SIZE; lane++) {
+    if (lane >= rays_num) {
+      /* Unused lanes get a ray that never hits anything. */
+      for (int axis = 0; axis < 3; axis++) {
+        packet.origin[axis][lane] = 0.0f;
+        packet.idot_axis[axis][lane] = 0.0f;
+      }
+      packet.hit_dist[lane] = -FLT_MAX;
+      continue;
+    }
+    BVHRayCastData *data = &packet.rays[lane];
+    bvhtree_ray_cast_batch_ray_init(batch_data, data, ray_start + lane);
+    for (int axis = 0; axis < 3; axis++) {
+      packet.origin[axis][lane] = data->ray.origin[axis];
+      packet.idot_axis[axis][lane] = data->idot_axis[axis];
+    }
+    packet.hit_dist[lane] = data->hit.dist;
+    mask |= 1 << lane;
+  }
+
+  dfs_raycast_packet(&packet, root, mask);
+
+  for (int lane = 0; lane < rays_num; lane++) {
+    memcpy(&batch_data->hits[ray_start + lane], &packet.rays[lane].hit, sizeof(BVHTreeRayHit));
+  }
+}
+
+static void bvhtree_ray_cast_batch_single_cb(void *__restrict userdata,
+                                             const int ray_index,
+                                             const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const BVHRayCastBatchData *batch_data = (const BVHRayCastBatchData *)userdata;
+  const BVHTree *tree = batch_data->tree;
+
+  BVHRayCastData data;
+  bvhtree_ray_cast_batch_ray_init(batch_data, &data, ray_index);
+  dfs_raycast(&data, tree->nodes[tree->leaf_num]);
+  memcpy(&batch_data->hits[ray_index], &data.hit, sizeof(data.hit));
+}
+
+void BLI_bvhtree_ray_cast_batch(const BVHTree *tree,
+                                const float (*co)[3],
+                                const float (*dir)[3],
+                                const int rays_num,
+                                const float radius,
+                                BVHTreeRayHit *hits,
+                                BVHTree_RayCastCallback callback,
+                                void *userdata,
+                                const int flag)
+{
+  if (rays_num == 0 || tree->nodes[tree->leaf_num] == NULL) {
+    return;
+  }
+
+  BVHRayCastBatchData batch_data = {
+      .tree = tree,
+      .co = co,
+      .dir = dir,
+      .rays_num = rays_num,
+      .radius = radius,
+      .hits = hits,
+      .callback = callback,
+      .userdata = userdata,
+      .flag = flag,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.use_threading = (flag & BVH_RAYCAST_USE_THREADING) != 0;
+
+  /* The packet box test only handles infinitely thin rays and needs the XYZ slabs,
+   * other rays are traced one by one (still threaded). */
+  if (radius != 0.0f || tree->start_axis != 0 || tree->stop_axis < 3) {
+    settings.min_iter_per_thread = BVH_RAY_PACKET_GRAIN_SIZE * BVH_RAY_PACKET_SIZE;
+    BLI_task_parallel_range(
+        0, rays_num, &batch_data, bvhtree_ray_cast_batch_single_cb, &settings);
+    return;
+  }
+
+  const int packets_num = (rays_num + BVH_RAY_PACKET_SIZE - 1) / BVH_RAY_PACKET_SIZE;
+  settings.min_iter_per_thread = BVH_RAY_PACKET_GRAIN_SIZE;
+  BLI_task_parallel_range(
+      0, packets_num, &batch_data, bvhtree_ray_cast_batch_packet_cb, &settings);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name BLI_bvhtree_range_query
  *
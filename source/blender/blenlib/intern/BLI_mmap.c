@@ -8,9 +8,11 @@
 
 #include "BLI_mmap.h"
 #include "BLI_fileops.h"
-#include "BLI_listbase.h"
+#include "BLI_threads.h"
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include <string.h>
 
 #ifndef WIN32
@@ -33,6 +35,17 @@ struct BLI_mmap_file {
   /* Platform-specific handle for the mapping. */
   void *handle;
 
+  /* Whether the mapped memory is writable, with changes kept private to the process. */
+  bool copy_on_write;
+
+  /* Number of users, the file is unmapped when the last one is removed by #BLI_mmap_free. */
+  int users;
+
+#ifndef WIN32
+  /* Entry of the file in the list checked by the error handler. */
+  struct MappedRegion *region;
+#endif
+
   /* Flag to indicate IO errors. Needs to be volatile since it's being set from
    * within the signal handler, which is not part of the normal execution flow. */
   volatile bool io_error;
@@ -50,14 +63,66 @@ struct BLI_mmap_file {
  * set after it's done reading.
  * If the error occurred outside of a memory-mapped region, we call the previous
  * handler if one was configured and abort the process otherwise.
+ *
+ * Files may be opened and freed from multiple threads while the signal handler runs, but the
+ * handler itself can't lock. Therefore, regions are never removed from the list, unused regions
+ * are reused for other files instead. Changes to a region are tracked by a version counter, so
+ * the handler can skip regions that change while it reads them. Skipping them is fine, because
+ * the region of a file that is being read can't change.
  */
 
+typedef struct MappedRegion {
+  /* Never changes once the region is added to the list. */
+  struct MappedRegion *next;
+  /* Incremented before and after every change, so it is odd while the region is changed. */
+  uint32_t version;
+  /* The file mapped to this region, null when the region is unused. */
+  BLI_mmap_file *file;
+  char *memory;
+  size_t length;
+} MappedRegion;
+
 static struct error_handler_data {
-  ListBase open_mmaps;
+  MappedRegion *regions;
   char configured;
   void (*next_handler)(int, siginfo_t *, void *);
 } error_handler = {0};
 
+/* Guards changes to the regions and the handler setup. */
+static ThreadMutex error_handler_lock = BLI_MUTEX_INITIALIZER;
+
+static void mapped_region_set_file(MappedRegion *region, BLI_mmap_file *file)
+{
+  atomic_add_and_fetch_uint32(&region->version, 1);
+  atomic_store_ptr((void **)&region->memory, file ? file->memory : NULL);
+  atomic_store_z(&region->length, file ? file->length : 0);
+  atomic_store_ptr((void **)&region->file, file);
+  atomic_add_and_fetch_uint32(&region->version, 1);
+}
+
+/* Find the file that the address is mapped to, without locking. */
+static BLI_mmap_file *mapped_file_find(const char *address)
+{
+  for (MappedRegion *region = atomic_load_ptr((void *const *)&error_handler.regions); region;
+       region = region->next)
+  {
+    const uint32_t version = atomic_load_uint32(&region->version);
+    if (version % 2 != 0) {
+      continue;
+    }
+    BLI_mmap_file *file = atomic_load_ptr((void *const *)&region->file);
+    const char *memory = atomic_load_ptr((void *const *)&region->memory);
+    const size_t length = atomic_load_z(&region->length);
+    if (file == NULL || address < memory || address >= memory + length) {
+      continue;
+    }
+    if (atomic_load_uint32(&region->version) == version) {
+      return file;
+    }
+  }
+  return NULL;
+}
+
 static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
 {
   /* We only handle SIGBUS here for now. */
@@ -65,22 +130,19 @@ static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
 
   const char *error_addr = (const char *)siginfo->si_addr;
   /* Find the file that this error belongs to. */
-  LISTBASE_FOREACH (LinkData *, link, &error_handler.open_mmaps) {
-    BLI_mmap_file *file = link->data;
-
-    /* Is the address where the error occurred in this file's mapped range? */
-    if (error_addr >= file->memory && error_addr < file->memory + file->length) {
-      file->io_error = true;
-
-      /* Replace the mapped memory with zeroes. */
-      const void *mapped_memory = mmap(
-          file->memory, file->length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
-      if (mapped_memory == MAP_FAILED) {
-        fprintf(stderr, "SIGBUS handler: Error replacing mapped file with zeros\n");
-      }
+  BLI_mmap_file *file = mapped_file_find(error_addr);
+  if (file) {
+    file->io_error = true;
 
-      return;
+    /* Replace the mapped memory with zeroes. */
+    const int prot = file->copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    const void *mapped_memory = mmap(
+        file->memory, file->length, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if (mapped_memory == MAP_FAILED) {
+      fprintf(stderr, "SIGBUS handler: Error replacing mapped file with zeros\n");
     }
+
+    return;
   }
 
   /* Fall back to other handler if there was one. */
@@ -96,6 +158,7 @@ static void sigbus_handler(int sig, siginfo_t *siginfo, void *ptr)
 /* Ensures that the error handler is set up and ready. */
 static bool sigbus_handler_setup(void)
 {
+  BLI_mutex_lock(&error_handler_lock);
   if (!error_handler.configured) {
     struct sigaction newact = {0}, oldact = {0};
 
@@ -103,6 +166,7 @@ static bool sigbus_handler_setup(void)
     newact.sa_flags = SA_SIGINFO;
 
     if (sigaction(SIGBUS, &newact, &oldact)) {
+      BLI_mutex_unlock(&error_handler_lock);
       return false;
     }
 
@@ -111,6 +175,7 @@ static bool sigbus_handler_setup(void)
     error_handler.next_handler = oldact.sa_sigaction;
     error_handler.configured = 1;
   }
+  BLI_mutex_unlock(&error_handler_lock);
 
   return true;
 }
@@ -118,18 +183,34 @@ static bool sigbus_handler_setup(void)
 /* Adds a file to the list that the error handler checks. */
 static void sigbus_handler_add(BLI_mmap_file *file)
 {
-  BLI_addtail(&error_handler.open_mmaps, BLI_genericNodeN(file));
+  BLI_mutex_lock(&error_handler_lock);
+  MappedRegion *region = error_handler.regions;
+  while (region && region->file) {
+    region = region->next;
+  }
+  if (region == NULL) {
+    /* Regions are never freed, so they are not allocated with the guarded allocator, which would
+     * report them as leaked. */
+    region = calloc(1, sizeof(MappedRegion));
+    region->next = error_handler.regions;
+    atomic_store_ptr((void **)&error_handler.regions, region);
+  }
+  mapped_region_set_file(region, file);
+  file->region = region;
+  BLI_mutex_unlock(&error_handler_lock);
 }
 
 /* Removes a file from the list that the error handler checks. */
 static void sigbus_handler_remove(BLI_mmap_file *file)
 {
-  LinkData *link = BLI_findptr(&error_handler.open_mmaps, file, offsetof(LinkData, data));
-  BLI_freelinkN(&error_handler.open_mmaps, link);
+  BLI_mutex_lock(&error_handler_lock);
+  mapped_region_set_file(file->region, NULL);
+  file->region = NULL;
+  BLI_mutex_unlock(&error_handler_lock);
 }
 #endif
 
-BLI_mmap_file *BLI_mmap_open(int fd)
+static BLI_mmap_file *mmap_open_impl(int fd, const bool copy_on_write)
 {
   void *memory, *handle = NULL;
   const size_t length = BLI_lseek(fd, 0, SEEK_END);
@@ -143,8 +224,9 @@ BLI_mmap_file *BLI_mmap_open(int fd)
     return NULL;
   }
 
-  /* Map the given file to memory. */
-  memory = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  /* Map the given file to memory. With #MAP_PRIVATE, writes never reach the file. */
+  const int prot = copy_on_write ? (PROT_READ | PROT_WRITE) : PROT_READ;
+  memory = mmap(NULL, length, prot, MAP_PRIVATE, fd, 0);
   if (memory == MAP_FAILED) {
     return NULL;
   }
@@ -154,11 +236,12 @@ BLI_mmap_file *BLI_mmap_open(int fd)
   /* Memory mapping on Windows is a two-step process - first we create a mapping,
    * then we create a view into that mapping.
    * In our case, one view that spans the entire file is enough. */
-  handle = CreateFileMapping(file_handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  handle = CreateFileMapping(
+      file_handle, NULL, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
   if (handle == NULL) {
     return NULL;
   }
-  memory = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+  memory = MapViewOfFile(handle, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
   if (memory == NULL) {
     CloseHandle(handle);
     return NULL;
@@ -170,6 +253,8 @@ BLI_mmap_file *BLI_mmap_open(int fd)
   file->memory = memory;
   file->handle = handle;
   file->length = length;
+  file->copy_on_write = copy_on_write;
+  file->users = 1;
 
 #ifndef WIN32
   /* Register the file with the error handler. */
@@ -179,6 +264,16 @@ BLI_mmap_file *BLI_mmap_open(int fd)
   return file;
 }
 
+BLI_mmap_file *BLI_mmap_open(int fd)
+{
+  return mmap_open_impl(fd, false);
+}
+
+BLI_mmap_file *BLI_mmap_open_copy_on_write(int fd)
+{
+  return mmap_open_impl(fd, true);
+}
+
 bool BLI_mmap_read(BLI_mmap_file *file, void *dest, size_t offset, size_t length)
 {
   /* If a previous read has already failed or we try to read past the end,
@@ -218,11 +313,20 @@ size_t BLI_mmap_get_length(const BLI_mmap_file *file)
   return file->length;
 }
 
+void BLI_mmap_add_user(BLI_mmap_file *file)
+{
+  atomic_add_and_fetch_int32(&file->users, 1);
+}
+
 void BLI_mmap_free(BLI_mmap_file *file)
 {
+  if (atomic_sub_and_fetch_int32(&file->users, 1) > 0) {
+    return;
+  }
 #ifndef WIN32
-  munmap((void *)file->memory, file->length);
+  /* Remove the file from the error handler first, the address range may be reused once unmapped. */
   sigbus_handler_remove(file);
+  munmap((void *)file->memory, file->length);
 #else
   UnmapViewOfFile(file->memory);
   CloseHandle(file->handle);
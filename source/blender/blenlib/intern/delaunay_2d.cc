@@ -18,6 +18,7 @@
 #include "BLI_math_mpq.hh"
 #include "BLI_math_vector_mpq_types.hh"
 #include "BLI_set.hh"
+#include "BLI_sort.hh"
 #include "BLI_task.hh"
 #include "BLI_vector.hh"
 
@@ -1215,6 +1216,58 @@ inline bool dc_tri_valid(SymEdge<T> *se, SymEdge<T> *basel, SymEdge<T> *basel_sy
   return filtered_orient2d(se->next->vert->co, basel_sym->vert->co, basel->vert->co) > 0;
 }
 
+/**
+ * Number of sites above which #dc_tri triangulates its two halves in parallel.
+ * Below this, the overhead of the separate arrangements outweighs the gain.
+ */
+constexpr int dc_tri_parallel_sites_num = 4096;
+
+template<typename T>
+void dc_tri(CDTArrangement<T> *cdt,
+            Array<SiteInfo<T>> &sites,
+            int start,
+            int end,
+            SymEdge<T> **r_le,
+            SymEdge<T> **r_re);
+
+/**
+ * Do the two recursive #dc_tri calls for the halves `[start, mid)` and `[mid, end)` in parallel.
+ * Each half builds its edges and faces in a separate arrangement, which are afterwards appended
+ * to \a cdt in the order the serial recursion would have created them. So the result is
+ * identical to the serial one.
+ *
+ * The halves only share the vertices (which are disjoint) and the outer face. The outer face
+ * is never replaced during #dc_tri: the edges it deletes always have the outer face on the
+ * side that is kept, so no arrangement changes its `outer_face`.
+ */
+template<typename T>
+static void dc_tri_parallel(CDTArrangement<T> *cdt,
+                            Array<SiteInfo<T>> &sites,
+                            int start,
+                            int mid,
+                            int end,
+                            SymEdge<T> **r_ldo,
+                            SymEdge<T> **r_ldi,
+                            SymEdge<T> **r_rdi,
+                            SymEdge<T> **r_rdo)
+{
+  CDTArrangement<T> left_cdt;
+  CDTArrangement<T> right_cdt;
+  left_cdt.outer_face = cdt->outer_face;
+  right_cdt.outer_face = cdt->outer_face;
+  threading::parallel_invoke(
+      [&]() { dc_tri(&left_cdt, sites, start, mid, r_ldo, r_ldi); },
+      [&]() { dc_tri(&right_cdt, sites, mid, end, r_rdi, r_rdo); });
+  BLI_assert(left_cdt.outer_face == cdt->outer_face && right_cdt.outer_face == cdt->outer_face);
+  for (CDTArrangement<T> *part : {&left_cdt, &right_cdt}) {
+    cdt->edges.extend(part->edges);
+    cdt->faces.extend(part->faces);
+    /* Ownership moved to cdt. */
+    part->edges.clear();
+    part->faces.clear();
+  }
+}
+
 /**
  * Delaunay triangulate sites[start} to sites[end-1].
  * Assume sites are lexicographically sorted by coordinate.
@@ -1281,8 +1334,13 @@ void dc_tri(CDTArrangement<T> *cdt,
   SymEdge<T> *ldi;
   SymEdge<T> *rdi;
   SymEdge<T> *rdo;
-  dc_tri(cdt, sites, start, start + n2, &ldo, &ldi);
-  dc_tri(cdt, sites, start + n2, end, &rdi, &rdo);
+  if (n >= dc_tri_parallel_sites_num) {
+    dc_tri_parallel(cdt, sites, start, start + n2, end, &ldo, &ldi, &rdi, &rdo);
+  }
+  else {
+    dc_tri(cdt, sites, start, start + n2, &ldo, &ldi);
+    dc_tri(cdt, sites, start + n2, end, &rdi, &rdo);
+  }
   if (dbg_level > 0) {
     std::cout << "\nDC_TRI merge step for start=" << start << ", end=" << end << "\n";
     std::cout << "ldo " << ldo << "\n"
@@ -1476,7 +1534,8 @@ template<typename T> void initial_triangulation(CDTArrangement<T> *cdt)
     sites[i].v = cdt->verts[i];
     sites[i].orig_index = i;
   }
-  std::sort(sites.begin(), sites.end(), site_lexicographic_sort<T>);
+  /* The comparison is a total order (ties are broken by index), so this is deterministic. */
+  parallel_sort(sites.begin(), sites.end(), site_lexicographic_sort<T>);
   find_site_merges(sites);
   dc_triangulate(cdt, sites);
 }
@@ -110,21 +110,30 @@ static void memory_close_mmap(FileReader *reader)
   MEM_freeN(mem);
 }
 
-FileReader *BLI_filereader_new_mmap(int filedes)
+FileReader *BLI_filereader_new_mmap_file(BLI_mmap_file *mmap_file)
 {
-  BLI_mmap_file *mmap = BLI_mmap_open(filedes);
-  if (mmap == NULL) {
-    return NULL;
-  }
-
   MemoryReader *mem = MEM_callocN(sizeof(MemoryReader), __func__);
 
-  mem->mmap = mmap;
-  mem->length = BLI_mmap_get_length(mmap);
+  mem->mmap = mmap_file;
+  mem->length = BLI_mmap_get_length(mmap_file);
 
   mem->reader.read = memory_read_mmap;
   mem->reader.seek = memory_seek;
-  mem->reader.close = memory_close_mmap;
+  mem->reader.close = memory_close_raw;
 
   return (FileReader *)mem;
 }
+
+FileReader *BLI_filereader_new_mmap(int filedes)
+{
+  BLI_mmap_file *mmap = BLI_mmap_open(filedes);
+  if (mmap == NULL) {
+    return NULL;
+  }
+
+  FileReader *reader = BLI_filereader_new_mmap_file(mmap);
+  /* Unlike #BLI_filereader_new_mmap_file, this reader owns the mapping. */
+  reader->close = memory_close_mmap;
+
+  return reader;
+}
@@ -11,6 +11,8 @@
 
 #include "BLI_filereader.h"
 #include "BLI_math_base.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #ifdef __BIG_ENDIAN__
 #  include "BLI_endian_switch.h"
@@ -18,6 +20,25 @@
 
 #include "MEM_guardedalloc.h"
 
+/* Upper bound for the number of frames that are decompressed ahead of the reading position. */
+#define ZSTD_PREFETCH_FRAMES_MAX 32
+
+/* A frame that is queued for decompression or already decompressed by the prefetching. */
+typedef struct ZstdFrameSlot {
+  /* Index of the frame stored in this slot, -1 when unused. */
+  int frame;
+  /* Set by the decompression task, protected by the prefetch mutex. */
+  bool done;
+  bool failed;
+
+  ZSTD_DCtx *ctx;
+  char *compressed_data;
+  size_t compressed_size;
+  char *uncompressed_data;
+  size_t uncompressed_size;
+  size_t uncompressed_alloc_size;
+} ZstdFrameSlot;
+
 typedef struct {
   FileReader reader;
 
@@ -35,6 +56,18 @@ typedef struct {
     char *cached_content;
     int cached_frame;
   } seek;
+
+  /* Decompression of the following frames on the task scheduler, used for seekable files
+   * when multiple threads are available. Frame `i` is stored in `slots[i % slots_num]`. */
+  struct {
+    TaskPool *pool;
+    ThreadMutex mutex;
+    ThreadCondition condition;
+    ZstdFrameSlot *slots;
+    int slots_num;
+    /* First frame that has not been queued for decompression yet. */
+    int next_frame;
+  } prefetch;
 } ZstdReader;
 
 static bool zstd_read_u32(FileReader *base, uint32_t *val)
@@ -195,6 +228,148 @@ static const char *zstd_ensure_cache(ZstdReader *zstd, int frame)
   return uncompressed_data;
 }
 
+static void zstd_prefetch_task(TaskPool *__restrict pool, void *taskdata)
+{
+  ZstdReader *zstd = BLI_task_pool_user_data(pool);
+  ZstdFrameSlot *slot = taskdata;
+
+  size_t res = ZSTD_decompressDCtx(slot->ctx,
+                                   slot->uncompressed_data,
+                                   slot->uncompressed_size,
+                                   slot->compressed_data,
+                                   slot->compressed_size);
+
+  BLI_mutex_lock(&zstd->prefetch.mutex);
+  slot->failed = ZSTD_isError(res) || res < slot->uncompressed_size;
+  slot->done = true;
+  BLI_condition_notify_all(&zstd->prefetch.condition);
+  BLI_mutex_unlock(&zstd->prefetch.mutex);
+}
+
+static void zstd_prefetch_wait(ZstdReader *zstd, ZstdFrameSlot *slot)
+{
+  BLI_mutex_lock(&zstd->prefetch.mutex);
+  while (!slot->done) {
+    BLI_condition_wait(&zstd->prefetch.condition, &zstd->prefetch.mutex);
+  }
+  BLI_mutex_unlock(&zstd->prefetch.mutex);
+}
+
+/* Read the compressed data of the frame and queue its decompression into the slot.
+ * The slot must not be in use by a running task. */
+static void zstd_prefetch_queue(ZstdReader *zstd, ZstdFrameSlot *slot, int frame)
+{
+  size_t compressed_size = zstd->seek.compressed_ofs[frame + 1] - zstd->seek.compressed_ofs[frame];
+  size_t uncompressed_size = zstd->seek.uncompressed_ofs[frame + 1] -
+                             zstd->seek.uncompressed_ofs[frame];
+
+  slot->frame = frame;
+  slot->done = false;
+  slot->failed = false;
+
+  MEM_SAFE_FREE(slot->compressed_data);
+  slot->compressed_data = MEM_mallocN(compressed_size, __func__);
+  slot->compressed_size = compressed_size;
+  if (slot->uncompressed_alloc_size < uncompressed_size) {
+    MEM_SAFE_FREE(slot->uncompressed_data);
+    slot->uncompressed_data = MEM_mallocN(uncompressed_size, __func__);
+    slot->uncompressed_alloc_size = uncompressed_size;
+  }
+  slot->uncompressed_size = uncompressed_size;
+
+  /* Reading from the base reader is not thread-safe, so it happens on the reading thread.
+   * Only the decompression runs in the task. */
+  if (zstd->base->seek(zstd->base, zstd->seek.compressed_ofs[frame], SEEK_SET) < 0 ||
+      zstd->base->read(zstd->base, slot->compressed_data, compressed_size) < compressed_size)
+  {
+    slot->failed = true;
+    slot->done = true;
+    return;
+  }
+
+  BLI_task_pool_push(zstd->prefetch.pool, zstd_prefetch_task, slot, false, NULL);
+}
+
+/* Prefetching counterpart of #zstd_ensure_cache: return the decompressed frame and
+ * keep the following frames queued for decompression. */
+static const char *zstd_ensure_prefetched(ZstdReader *zstd, int frame)
+{
+  const int slots_num = zstd->prefetch.slots_num;
+  ZstdFrameSlot *slot = &zstd->prefetch.slots[frame % slots_num];
+
+  if (slot->frame != frame) {
+    /* Not a sequential read, discard everything that was prefetched and restart here. */
+    BLI_task_pool_work_and_wait(zstd->prefetch.pool);
+    for (int i = 0; i < slots_num; i++) {
+      zstd->prefetch.slots[i].frame = -1;
+    }
+    zstd->prefetch.next_frame = frame;
+  }
+
+  /* Fill the window of frames following the requested one. The slots that are reused
+   * belong to frames before the requested one, which may still be in progress when
+   * the reading position jumped ahead. */
+  while (zstd->prefetch.next_frame < zstd->seek.frames_num &&
+         zstd->prefetch.next_frame < frame + slots_num)
+  {
+    ZstdFrameSlot *next_slot = &zstd->prefetch.slots[zstd->prefetch.next_frame % slots_num];
+    if (next_slot->frame != -1) {
+      zstd_prefetch_wait(zstd, next_slot);
+    }
+    zstd_prefetch_queue(zstd, next_slot, zstd->prefetch.next_frame);
+    zstd->prefetch.next_frame++;
+  }
+
+  zstd_prefetch_wait(zstd, slot);
+  MEM_SAFE_FREE(slot->compressed_data);
+  if (slot->failed) {
+    /* Retry the frame on the next access instead of keeping the error. */
+    slot->frame = -1;
+    return NULL;
+  }
+  return slot->uncompressed_data;
+}
+
+static void zstd_prefetch_init(ZstdReader *zstd)
+{
+  const int threads_num = BLI_task_scheduler_num_threads();
+  /* When there is only one thread, tasks would only run when the pool is waited on. */
+  if (threads_num < 2 || zstd->seek.frames_num < 2) {
+    return;
+  }
+
+  zstd->prefetch.slots_num = min_ii(min_ii(2 * threads_num, ZSTD_PREFETCH_FRAMES_MAX),
+                                    zstd->seek.frames_num);
+  zstd->prefetch.slots = MEM_calloc_arrayN(
+      zstd->prefetch.slots_num, sizeof(ZstdFrameSlot), __func__);
+  for (int i = 0; i < zstd->prefetch.slots_num; i++) {
+    zstd->prefetch.slots[i].frame = -1;
+    zstd->prefetch.slots[i].ctx = ZSTD_createDCtx();
+  }
+  BLI_mutex_init(&zstd->prefetch.mutex);
+  BLI_condition_init(&zstd->prefetch.condition);
+  zstd->prefetch.pool = BLI_task_pool_create_background(zstd, TASK_PRIORITY_HIGH);
+}
+
+static void zstd_prefetch_free(ZstdReader *zstd)
+{
+  if (zstd->prefetch.pool == NULL) {
+    return;
+  }
+
+  BLI_task_pool_work_and_wait(zstd->prefetch.pool);
+  BLI_task_pool_free(zstd->prefetch.pool);
+  for (int i = 0; i < zstd->prefetch.slots_num; i++) {
+    ZstdFrameSlot *slot = &zstd->prefetch.slots[i];
+    ZSTD_freeDCtx(slot->ctx);
+    MEM_SAFE_FREE(slot->compressed_data);
+    MEM_SAFE_FREE(slot->uncompressed_data);
+  }
+  MEM_freeN(zstd->prefetch.slots);
+  BLI_mutex_end(&zstd->prefetch.mutex);
+  BLI_condition_end(&zstd->prefetch.condition);
+}
+
 static int64_t zstd_read_seekable(FileReader *reader, void *buffer, size_t size)
 {
   ZstdReader *zstd = (ZstdReader *)reader;
@@ -207,7 +382,8 @@ static int64_t zstd_read_seekable(FileReader *reader, void *buffer, size_t size)
       break;
     }
 
-    const char *framedata = zstd_ensure_cache(zstd, frame);
+    const char *framedata = zstd->prefetch.pool ? zstd_ensure_prefetched(zstd, frame) :
+                                                  zstd_ensure_cache(zstd, frame);
     if (framedata == NULL) {
       /* Error while reading the frame, so return as much as we can. */
       break;
@@ -283,6 +459,7 @@ static void zstd_close(FileReader *reader)
 
   ZSTD_freeDCtx(zstd->ctx);
   if (zstd->reader.seek) {
+    zstd_prefetch_free(zstd);
     MEM_freeN(zstd->seek.uncompressed_ofs);
     MEM_freeN(zstd->seek.compressed_ofs);
     /* When an error has occurred this may be NULL, see: #99744. */
@@ -308,6 +485,7 @@ FileReader *BLI_filereader_new_zstd(FileReader *base)
   if (zstd_read_seek_table(zstd)) {
     zstd->reader.read = zstd_read_seekable;
     zstd->reader.seek = zstd_seek;
+    zstd_prefetch_init(zstd);
   }
   else {
     zstd->reader.read = zstd_read;
@@ -10,6 +10,7 @@
 
 #include "BLI_kdtree_impl.h"
 #include "BLI_math_base.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include <string.h>
@@ -48,6 +49,11 @@ struct KDTree {
 #define KD_NEAR_ALLOC_INC 100 /* alloc increment for collecting nearest */
 #define KD_FOUND_ALLOC_INC 50 /* alloc increment for collecting nearest */
 
+/** Sub-trees with at least this many nodes are balanced in a separate task. */
+#define KD_BALANCE_PARALLEL_MIN 8192
+/** Minimum number of queries handled by a thread in batched queries. */
+#define KD_BATCH_GRAIN_SIZE 256
+
 #define KD_NODE_UNSET ((uint)-1)
 
 /**
@@ -139,7 +145,36 @@ void BLI_kdtree_nd_(insert)(KDTree *tree, int index, const float co[KD_DIMS])
 #endif
 }
 
-static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
+/** Index of the root node of a balanced (sub-)tree, see #kdtree_balance. */
+static uint kdtree_balance_root(const uint nodes_len, const uint ofs)
+{
+  if (nodes_len == 0) {
+    return KD_NODE_UNSET;
+  }
+  return nodes_len / 2 + ofs;
+}
+
+typedef struct KDTreeBalanceTask {
+  KDTreeNode *nodes;
+  uint nodes_len;
+  uint axis;
+  uint ofs;
+} KDTreeBalanceTask;
+
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs);
+
+static void kdtree_balance_task(TaskPool *__restrict pool, void *taskdata)
+{
+  const KDTreeBalanceTask *task = taskdata;
+  kdtree_balance(pool, task->nodes, task->nodes_len, task->axis, task->ofs);
+}
+
+/**
+ * \param pool: When not null, large sub-trees are balanced in separate tasks in this pool.
+ */
+static uint kdtree_balance(
+    TaskPool *pool, KDTreeNode *nodes, uint nodes_len, uint axis, const uint ofs)
 {
   KDTreeNode *node;
   float co;
@@ -188,9 +223,21 @@ static uint kdtree_balance(KDTreeNode *nodes, uint nodes_len, uint axis, const u
   node = &nodes[median];
   node->d = axis;
   axis = (axis + 1) % KD_DIMS;
-  node->left = kdtree_balance(nodes, median, axis, ofs);
+  if (pool && median >= KD_BALANCE_PARALLEL_MIN) {
+    /* The sub-trees are independent, the index of their root is known before balancing. */
+    KDTreeBalanceTask *task = MEM_mallocN(sizeof(*task), __func__);
+    task->nodes = nodes;
+    task->nodes_len = median;
+    task->axis = axis;
+    task->ofs = ofs;
+    BLI_task_pool_push(pool, kdtree_balance_task, task, true, NULL);
+    node->left = kdtree_balance_root(median, ofs);
+  }
+  else {
+    node->left = kdtree_balance(pool, nodes, median, axis, ofs);
+  }
   node->right = kdtree_balance(
-      nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
+      pool, nodes + median + 1, (nodes_len - (median + 1)), axis, (median + 1) + ofs);
 
   return median + ofs;
 }
@@ -204,7 +251,15 @@ void BLI_kdtree_nd_(balance)(KDTree *tree)
     }
   }
 
-  tree->root = kdtree_balance(tree->nodes, tree->nodes_len, 0, 0);
+  if (tree->nodes_len >= KD_BALANCE_PARALLEL_MIN * 2) {
+    TaskPool *pool = BLI_task_pool_create(NULL, TASK_PRIORITY_HIGH);
+    tree->root = kdtree_balance(pool, tree->nodes, tree->nodes_len, 0, 0);
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+  else {
+    tree->root = kdtree_balance(NULL, tree->nodes, tree->nodes_len, 0, 0);
+  }
 
 #ifndef NDEBUG
   tree->is_balanced = true;
@@ -800,6 +855,161 @@ finally:
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Batched Queries
+ * \{ */
+
+typedef struct KDTreeBatchData {
+  const KDTree *tree;
+  const float (*co)[KD_DIMS];
+  float range;
+  int *offsets;
+  int *indices;
+  float *dists;
+} KDTreeBatchData;
+
+static void kdtree_find_nearest_batch_fn(void *__restrict userdata,
+                                         const int i,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  KDTreeNearest nearest;
+  const int index = BLI_kdtree_nd_(find_nearest)(data->tree, data->co[i], &nearest);
+  data->indices[i] = index;
+  if (data->dists) {
+    data->dists[i] = (index == -1) ? FLT_MAX : nearest.dist;
+  }
+}
+
+/**
+ * Find the nearest point for each of the given coordinates, using multiple threads.
+ *
+ * \param r_indices: Index of the nearest point for every coordinate, -1 if the tree is empty.
+ * \param r_dists: Distance to the nearest point for every coordinate (optional).
+ */
+void BLI_kdtree_nd_(find_nearest_batch)(const KDTree *tree,
+                                        const float (*co)[KD_DIMS],
+                                        const uint co_len,
+                                        int *r_indices,
+                                        float *r_dists)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .indices = r_indices,
+      .dists = r_dists,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = KD_BATCH_GRAIN_SIZE;
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_find_nearest_batch_fn, &settings);
+}
+
+static bool kdtree_range_count_cb(void *user_data,
+                                  int UNUSED(index),
+                                  const float UNUSED(co[KD_DIMS]),
+                                  float UNUSED(dist_sq))
+{
+  (*(int *)user_data)++;
+  return true;
+}
+
+static void kdtree_range_count_batch_fn(void *__restrict userdata,
+                                        const int i,
+                                        const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  int count = 0;
+  BLI_kdtree_nd_(range_search_cb)(
+      data->tree, data->co[i], data->range, kdtree_range_count_cb, &count);
+  data->offsets[i] = count;
+}
+
+typedef struct KDTreeRangeFill {
+  int *indices;
+  float *dists;
+} KDTreeRangeFill;
+
+static bool kdtree_range_fill_cb(void *user_data,
+                                 int index,
+                                 const float UNUSED(co[KD_DIMS]),
+                                 float dist_sq)
+{
+  KDTreeRangeFill *fill = user_data;
+  *fill->indices++ = index;
+  if (fill->dists) {
+    *fill->dists++ = sqrtf(dist_sq);
+  }
+  return true;
+}
+
+static void kdtree_range_fill_batch_fn(void *__restrict userdata,
+                                       const int i,
+                                       const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const KDTreeBatchData *data = userdata;
+  const int offset = data->offsets[i];
+  KDTreeRangeFill fill = {
+      .indices = data->indices + offset,
+      .dists = data->dists ? data->dists + offset : NULL,
+  };
+  BLI_kdtree_nd_(range_search_cb)(
+      data->tree, data->co[i], data->range, kdtree_range_fill_cb, &fill);
+  BLI_assert(fill.indices == data->indices + data->offsets[i + 1]);
+}
+
+/**
+ * Find all points in \a range of each of the given coordinates, using multiple threads.
+ * The results are stored in flat arrays, the results for coordinate `i` are in the range
+ * `r_offsets[i]` to `r_offsets[i + 1]`. They are not sorted by distance.
+ *
+ * \param r_offsets: Array of `co_len + 1` offsets into the result arrays.
+ * \param r_indices: Allocated array of the found point indices, to be freed by the caller.
+ * \param r_dists: Allocated array of the distances to the found points (optional),
+ * to be freed by the caller.
+ * \return The total number of results.
+ */
+int BLI_kdtree_nd_(range_search_batch)(const KDTree *tree,
+                                       const float (*co)[KD_DIMS],
+                                       const uint co_len,
+                                       const float range,
+                                       int *r_offsets,
+                                       int **r_indices,
+                                       float **r_dists)
+{
+  KDTreeBatchData data = {
+      .tree = tree,
+      .co = co,
+      .range = range,
+      .offsets = r_offsets,
+  };
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = KD_BATCH_GRAIN_SIZE;
+
+  /* Count the results first, so that they can be written in parallel without locking. */
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_range_count_batch_fn, &settings);
+  int total = 0;
+  for (uint i = 0; i < co_len; i++) {
+    const int count = r_offsets[i];
+    r_offsets[i] = total;
+    total += count;
+  }
+  r_offsets[co_len] = total;
+
+  data.indices = MEM_mallocN(sizeof(int) * (size_t)MAX2(total, 1), __func__);
+  data.dists = r_dists ? MEM_mallocN(sizeof(float) * (size_t)MAX2(total, 1), __func__) : NULL;
+  BLI_task_parallel_range(0, (int)co_len, &data, kdtree_range_fill_batch_fn, &settings);
+
+  *r_indices = data.indices;
+  if (r_dists) {
+    *r_dists = data.dists;
+  }
+  return total;
+}
+
+/** \} */
+
 /**
  * Use when we want to loop over nodes ordered by index.
  * Requires indices to be aligned with nodes.
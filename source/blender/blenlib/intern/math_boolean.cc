@@ -6,8 +6,12 @@
  * \ingroup bli
  */
 
+#include <cfloat>
+#include <cmath>
+
 #include "BLI_math_boolean.hh"
 #include "BLI_math_mpq.hh"
+#include "BLI_math_vector.hh"
 #include "BLI_math_vector_types.hh"
 #include "BLI_span.hh"
 #include "BLI_utildefines.h"
@@ -2495,6 +2499,39 @@ int orient3d_fast(const double3 &a, const double3 &b, const double3 &c, const do
   return sgn(robust_pred::orient3dfast(a, b, c, d));
 }
 
+/**
+ * Error bound from the supremum and index functions of Burnikel, Funke and Seel,
+ * "Exact Geometric Computation Using Cascading" (see also `mesh_intersect.cc`).
+ * The inputs are assumed to be rounded values, so have index 1. The determinant
+ * `dot(a - d, cross(b - d, c - d))` then has index 11, and its supremum is the same
+ * expression evaluated with absolute values and only additions.
+ */
+constexpr int index_orient3d_filter = 11;
+
+int orient3d_filter(const double3 &a, const double3 &b, const double3 &c, const double3 &d)
+{
+  const double3 ad = a - d;
+  const double3 bd = b - d;
+  const double3 cd = c - d;
+  const double det = ad.z * (bd.x * cd.y - cd.x * bd.y) + bd.z * (cd.x * ad.y - ad.x * cd.y) +
+                     cd.z * (ad.x * bd.y - bd.x * ad.y);
+  if (det == 0.0) {
+    return 0;
+  }
+  const double3 abs_d = math::abs(d);
+  const double3 sup_ad = math::abs(a) + abs_d;
+  const double3 sup_bd = math::abs(b) + abs_d;
+  const double3 sup_cd = math::abs(c) + abs_d;
+  const double supremum = sup_ad.z * (sup_bd.x * sup_cd.y + sup_cd.x * sup_bd.y) +
+                          sup_bd.z * (sup_cd.x * sup_ad.y + sup_ad.x * sup_cd.y) +
+                          sup_cd.z * (sup_ad.x * sup_bd.y + sup_bd.x * sup_ad.y);
+  const double err_bound = supremum * index_orient3d_filter * DBL_EPSILON;
+  if (fabs(det) > err_bound) {
+    return det > 0.0 ? 1 : -1;
+  }
+  return 0;
+}
+
 int insphere(
     const double3 &a, const double3 &b, const double3 &c, const double3 &d, const double3 &e)
 {
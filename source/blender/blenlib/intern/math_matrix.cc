@@ -427,6 +427,154 @@ template double4x4 interpolate_fast(const double4x4 &a, const double4x4 &b, doub
 
 /** \} */
 
+/* -------------------------------------------------------------------- */
+/** \name Batch Transform
+ * \{ */
+
+#if BLI_HAVE_SSE2
+/** Load four consecutive #float3 and split them into their x, y and z components. */
+BLI_INLINE void load_float3_x4(const float *src, __m128 &r_x, __m128 &r_y, __m128 &r_z)
+{
+  const __m128 a0 = _mm_loadu_ps(src);     /* x0 y0 z0 x1 */
+  const __m128 a1 = _mm_loadu_ps(src + 4); /* y1 z1 x2 y2 */
+  const __m128 a2 = _mm_loadu_ps(src + 8); /* z2 x3 y3 z3 */
+  const __m128 x0x1y1z1 = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 0, 3, 0));
+  const __m128 x2y2x3y3 = _mm_shuffle_ps(a1, a2, _MM_SHUFFLE(2, 1, 3, 2));
+  r_x = _mm_shuffle_ps(x0x1y1z1, x2y2x3y3, _MM_SHUFFLE(2, 0, 1, 0));
+  const __m128 y0y0y1y1 = _mm_shuffle_ps(a0, x0x1y1z1, _MM_SHUFFLE(2, 2, 1, 1));
+  r_y = _mm_shuffle_ps(y0y0y1y1, x2y2x3y3, _MM_SHUFFLE(3, 1, 2, 0));
+  const __m128 z0z0z1z1 = _mm_shuffle_ps(a0, a1, _MM_SHUFFLE(1, 1, 2, 2));
+  const __m128 z2z2z3z3 = _mm_shuffle_ps(a2, a2, _MM_SHUFFLE(3, 3, 0, 0));
+  r_z = _mm_shuffle_ps(z0z0z1z1, z2z2z3z3, _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/** Inverse of #load_float3_x4. */
+BLI_INLINE void store_float3_x4(const __m128 x, const __m128 y, const __m128 z, float *dst)
+{
+  const __m128 x0y0x1y1 = _mm_unpacklo_ps(x, y);
+  const __m128 x2y2x3y3 = _mm_unpackhi_ps(x, y);
+  const __m128 z0z0x1x1 = _mm_shuffle_ps(z, x0y0x1y1, _MM_SHUFFLE(2, 2, 0, 0));
+  const __m128 y1y1z1z1 = _mm_shuffle_ps(x0y0x1y1, z, _MM_SHUFFLE(1, 1, 3, 3));
+  const __m128 z2z2x3x3 = _mm_shuffle_ps(z, x2y2x3y3, _MM_SHUFFLE(2, 2, 2, 2));
+  const __m128 y3y3z3z3 = _mm_shuffle_ps(x2y2x3y3, z, _MM_SHUFFLE(3, 3, 3, 3));
+  _mm_storeu_ps(dst, _mm_shuffle_ps(x0y0x1y1, z0z0x1x1, _MM_SHUFFLE(2, 0, 1, 0)));
+  _mm_storeu_ps(dst + 4, _mm_shuffle_ps(y1y1z1z1, x2y2x3y3, _MM_SHUFFLE(1, 0, 2, 0)));
+  _mm_storeu_ps(dst + 8, _mm_shuffle_ps(z2z2x3x3, y3y3z3z3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+#endif
+
+template<bool UseLocation>
+static void transform_float3_batch(const float3x3 &mat,
+                                   const float3 &location,
+                                   const Span<float3> src,
+                                   MutableSpan<float3> dst)
+{
+  BLI_assert(src.size() == dst.size());
+  int64_t i = 0;
+#if BLI_HAVE_SSE2
+  /* Work on four vectors at once, every lane contains a different vector. The order of operations
+   * is the same as in the scalar code below to get the same results. */
+  const __m128 m00 = _mm_set1_ps(mat[0][0]);
+  const __m128 m01 = _mm_set1_ps(mat[0][1]);
+  const __m128 m02 = _mm_set1_ps(mat[0][2]);
+  const __m128 m10 = _mm_set1_ps(mat[1][0]);
+  const __m128 m11 = _mm_set1_ps(mat[1][1]);
+  const __m128 m12 = _mm_set1_ps(mat[1][2]);
+  const __m128 m20 = _mm_set1_ps(mat[2][0]);
+  const __m128 m21 = _mm_set1_ps(mat[2][1]);
+  const __m128 m22 = _mm_set1_ps(mat[2][2]);
+  const __m128 loc_x = _mm_set1_ps(location.x);
+  const __m128 loc_y = _mm_set1_ps(location.y);
+  const __m128 loc_z = _mm_set1_ps(location.z);
+  const float *src_ptr = reinterpret_cast<const float *>(src.data());
+  float *dst_ptr = reinterpret_cast<float *>(dst.data());
+  for (; i + 4 <= src.size(); i += 4) {
+    __m128 x, y, z;
+    load_float3_x4(src_ptr + i * 3, x, y, z);
+    __m128 rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)),
+                           _mm_mul_ps(z, m20));
+    __m128 ry = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)),
+                           _mm_mul_ps(z, m21));
+    __m128 rz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)),
+                           _mm_mul_ps(z, m22));
+    if constexpr (UseLocation) {
+      rx = _mm_add_ps(rx, loc_x);
+      ry = _mm_add_ps(ry, loc_y);
+      rz = _mm_add_ps(rz, loc_z);
+    }
+    store_float3_x4(rx, ry, rz, dst_ptr + i * 3);
+  }
+#endif
+  for (; i < src.size(); i++) {
+    if constexpr (UseLocation) {
+      dst[i] = mat * src[i] + location;
+    }
+    else {
+      dst[i] = mat * src[i];
+    }
+  }
+}
+
+void transform_points(const float4x4 &transform, const Span<float3> src, MutableSpan<float3> dst)
+{
+  transform_float3_batch<true>(float3x3(transform), transform.location(), src, dst);
+}
+
+void transform_points(const float4x4 &transform, MutableSpan<float3> points)
+{
+  transform_points(transform, points, points);
+}
+
+void transform_directions(const float3x3 &transform,
+                          const Span<float3> src,
+                          MutableSpan<float3> dst)
+{
+  transform_float3_batch<false>(transform, float3(0.0f), src, dst);
+}
+
+void transform_directions(const float3x3 &transform, MutableSpan<float3> directions)
+{
+  transform_directions(transform, directions, directions);
+}
+
+void transform_matrices(const float4x4 &transform,
+                        const Span<float4x4> src,
+                        MutableSpan<float4x4> dst)
+{
+  BLI_assert(src.size() == dst.size());
+#if BLI_HAVE_SSE2
+  /* Same as the #float4x4 multiplication, but the left matrix is only loaded once. */
+  const __m128 A0 = _mm_loadu_ps(transform[0]);
+  const __m128 A1 = _mm_loadu_ps(transform[1]);
+  const __m128 A2 = _mm_loadu_ps(transform[2]);
+  const __m128 A3 = _mm_loadu_ps(transform[3]);
+  for (const int64_t i : src.index_range()) {
+    const float4x4 &b = src[i];
+    float4x4 &result = dst[i];
+    for (int col = 0; col < 4; col++) {
+      const __m128 B0 = _mm_set1_ps(b[col][0]);
+      const __m128 B1 = _mm_set1_ps(b[col][1]);
+      const __m128 B2 = _mm_set1_ps(b[col][2]);
+      const __m128 B3 = _mm_set1_ps(b[col][3]);
+      const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_mul_ps(B0, A0), _mm_mul_ps(B1, A1)),
+                                    _mm_add_ps(_mm_mul_ps(B2, A2), _mm_mul_ps(B3, A3)));
+      _mm_storeu_ps(result[col], sum);
+    }
+  }
+#else
+  for (const int64_t i : src.index_range()) {
+    dst[i] = transform * src[i];
+  }
+#endif
+}
+
+void transform_matrices(const float4x4 &transform, MutableSpan<float4x4> matrices)
+{
+  transform_matrices(transform, matrices, matrices);
+}
+
+/** \} */
+
 /* -------------------------------------------------------------------- */
 /** \name Legacy
  * \{ */
@@ -22,6 +22,7 @@
 #  include "BLI_hash.hh"
 #  include "BLI_kdopbvh.h"
 #  include "BLI_map.hh"
+#  include "BLI_math_boolean.hh"
 #  include "BLI_math_geom.h"
 #  include "BLI_math_matrix.h"
 #  include "BLI_math_mpq.hh"
@@ -1133,45 +1134,92 @@ static int filter_plane_side(const double3 &p,
 
 /**
  * Return the point on ab where the plane with normal n containing point c intersects it.
+ * The plane is that of triangle (c, c_q, c_r), whose other vertices are only used to recognize
+ * shared vertices without any exact arithmetic.
  * Assumes ab is not perpendicular to n.
  * This works because the ratio of the projections of ab and ac onto n is the same as
  * the ratio along the line ab of the intersection point to the whole of ab.
  * The ab, ac, and dotbuf arguments are used as a temporaries; declaring them
  * in the caller can avoid many allocations and frees of mpq3 and mpq_class structures.
  */
-static inline mpq3 tti_interp(
-    const mpq3 &a, const mpq3 &b, const mpq3 &c, const mpq3 &n, mpq3 &ab, mpq3 &ac, mpq3 &dotbuf)
-{
-  ab = a;
-  ab -= b;
-  ac = a;
-  ac -= c;
+static inline mpq3 tti_interp(const Vert *a,
+                              const Vert *b,
+                              const Vert *c,
+                              const Vert *c_q,
+                              const Vert *c_r,
+                              const mpq3 &n,
+                              mpq3 &ab,
+                              mpq3 &ac,
+                              mpq3 &dotbuf)
+{
+  /* An end point that is a vertex of the triangle defining the plane is the intersection. */
+  if (ELEM(a, c, c_q, c_r)) {
+#  ifdef PERFDEBUG
+    incperfcount(7); /* Triangle-triangle interpolations decided by shared vertices. */
+#  endif
+    return a->co_exact;
+  }
+  if (ELEM(b, c, c_q, c_r)) {
+#  ifdef PERFDEBUG
+    incperfcount(7); /* Triangle-triangle interpolations decided by shared vertices. */
+#  endif
+    return b->co_exact;
+  }
+#  ifdef PERFDEBUG
+  incperfcount(8); /* Triangle-triangle interpolations computed exactly. */
+#  endif
+  ab = a->co_exact;
+  ab -= b->co_exact;
+  ac = a->co_exact;
+  ac -= c->co_exact;
   mpq_class den = math::dot_with_buffer(ab, n, dotbuf);
   BLI_assert(den != 0);
   mpq_class alpha = math::dot_with_buffer(ac, n, dotbuf) / den;
-  return a - alpha * ab;
+  return a->co_exact - alpha * ab;
 }
 
 /**
- * Return +1, 0, -1 as a + ad is above, on, or below the oriented plane containing a, b, c in CCW
- * order. This is the same as -oriented(a, b, c, a + ad), but uses fewer arithmetic operations.
- * TODO: change arguments to `const Vert *` and use floating filters.
- * The ba, ca, n, and dotbuf arguments are used as temporaries; declaring them
+ * Return +1, 0, -1 as d is above, on, or below the oriented plane containing a, b, c in CCW
+ * order. This is the same as -oriented(a, b, c, d), but uses fewer arithmetic operations.
+ * The sign is first tried with a floating point filter on the rounded coordinates,
+ * only falling back to exact arithmetic when the filter can't decide.
+ * The ba, ca, n, ad, and dotbuf arguments are used as temporaries; declaring them
  * in the caller can avoid many allocations and frees of mpq3 and mpq_class structures.
  */
-static inline int tti_above(const mpq3 &a,
-                            const mpq3 &b,
-                            const mpq3 &c,
-                            const mpq3 &ad,
+static inline int tti_above(const Vert *a,
+                            const Vert *b,
+                            const Vert *c,
+                            const Vert *d,
                             mpq3 &ba,
                             mpq3 &ca,
                             mpq3 &n,
+                            mpq3 &ad,
                             mpq3 &dotbuf)
 {
-  ba = b;
-  ba -= a;
-  ca = c;
-  ca -= a;
+  /* Adjacent triangles share vertices, which makes the four points trivially coplanar. */
+  if (ELEM(d, a, b, c) || ELEM(a, b, c) || b == c) {
+#  ifdef PERFDEBUG
+    incperfcount(5); /* Triangle-triangle above tests decided by the filter. */
+#  endif
+    return 0;
+  }
+  /* `dot(d - a, cross(b - a, c - a))` is the orient3d determinant of (d, b, c, a). */
+  const int filter_side = orient3d_filter(d->co, b->co, c->co, a->co);
+  if (filter_side != 0) {
+#  ifdef PERFDEBUG
+    incperfcount(5); /* Triangle-triangle above tests decided by the filter. */
+#  endif
+    return filter_side;
+  }
+#  ifdef PERFDEBUG
+  incperfcount(6); /* Triangle-triangle above tests decided exactly. */
+#  endif
+  ba = b->co_exact;
+  ba -= a->co_exact;
+  ca = c->co_exact;
+  ca -= a->co_exact;
+  ad = d->co_exact;
+  ad -= a->co_exact;
 
   n.x = ba.y * ca.z - ba.z * ca.y;
   n.y = ba.z * ca.x - ba.x * ca.z;
@@ -1193,12 +1241,12 @@ static inline int tti_above(const mpq3 &a,
  *   of the plane and at least one of q1 and r1 are off the plane.
  * Similarly for p2, q2, r2 with respect to the first triangle's plane.
  */
-static ITT_value itt_canon2(const mpq3 &p1,
-                            const mpq3 &q1,
-                            const mpq3 &r1,
-                            const mpq3 &p2,
-                            const mpq3 &q2,
-                            const mpq3 &r2,
+static ITT_value itt_canon2(const Vert *p1,
+                            const Vert *q1,
+                            const Vert *r1,
+                            const Vert *p2,
+                            const Vert *q2,
+                            const Vert *r2,
                             const mpq3 &n1,
                             const mpq3 &n2)
 {
@@ -1209,33 +1257,28 @@ static ITT_value itt_canon2(const mpq3 &p1,
     std::cout << "p2=" << p2 << " q2=" << q2 << " r2=" << r2 << "\n";
     std::cout << "n1=" << n1 << " n2=" << n2 << "\n";
     std::cout << "approximate values:\n";
-    std::cout << "p1=(" << p1[0].get_d() << "," << p1[1].get_d() << "," << p1[2].get_d() << ")\n";
-    std::cout << "q1=(" << q1[0].get_d() << "," << q1[1].get_d() << "," << q1[2].get_d() << ")\n";
-    std::cout << "r1=(" << r1[0].get_d() << "," << r1[1].get_d() << "," << r1[2].get_d() << ")\n";
-    std::cout << "p2=(" << p2[0].get_d() << "," << p2[1].get_d() << "," << p2[2].get_d() << ")\n";
-    std::cout << "q2=(" << q2[0].get_d() << "," << q2[1].get_d() << "," << q2[2].get_d() << ")\n";
-    std::cout << "r2=(" << r2[0].get_d() << "," << r2[1].get_d() << "," << r2[2].get_d() << ")\n";
+    std::cout << "p1=" << p1->co << " q1=" << q1->co << " r1=" << r1->co << "\n";
+    std::cout << "p2=" << p2->co << " q2=" << q2->co << " r2=" << r2->co << "\n";
     std::cout << "n1=(" << n1[0].get_d() << "," << n1[1].get_d() << "," << n1[2].get_d() << ")\n";
     std::cout << "n2=(" << n2[0].get_d() << "," << n2[1].get_d() << "," << n2[2].get_d() << ")\n";
   }
-  mpq3 p1p2 = p2 - p1;
   mpq3 intersect_1;
   mpq3 intersect_2;
-  mpq3 buf[4];
+  mpq3 buf[5];
   bool no_overlap = false;
   /* Top test in classification tree. */
-  if (tti_above(p1, q1, r2, p1p2, buf[0], buf[1], buf[2], buf[3]) > 0) {
+  if (tti_above(p1, q1, r2, p2, buf[0], buf[1], buf[2], buf[3], buf[4]) > 0) {
     /* Middle right test in classification tree. */
-    if (tti_above(p1, r1, r2, p1p2, buf[0], buf[1], buf[2], buf[3]) <= 0) {
+    if (tti_above(p1, r1, r2, p2, buf[0], buf[1], buf[2], buf[3], buf[4]) <= 0) {
       /* Bottom right test in classification tree. */
-      if (tti_above(p1, r1, q2, p1p2, buf[0], buf[1], buf[2], buf[3]) > 0) {
+      if (tti_above(p1, r1, q2, p2, buf[0], buf[1], buf[2], buf[3], buf[4]) > 0) {
         /* Overlap is [k [i l] j]. */
         if (dbg_level > 0) {
           std::cout << "overlap [k [i l] j]\n";
         }
         /* i is intersect with p1r1. l is intersect with p2r2. */
-        intersect_1 = tti_interp(p1, r1, p2, n2, buf[0], buf[1], buf[2]);
-        intersect_2 = tti_interp(p2, r2, p1, n1, buf[0], buf[1], buf[2]);
+        intersect_1 = tti_interp(p1, r1, p2, q2, r2, n2, buf[0], buf[1], buf[2]);
+        intersect_2 = tti_interp(p2, r2, p1, q1, r1, n1, buf[0], buf[1], buf[2]);
       }
       else {
         /* Overlap is [i [k l] j]. */
@@ -1243,8 +1286,8 @@ static ITT_value itt_canon2(const mpq3 &p1,
           std::cout << "overlap [i [k l] j]\n";
         }
         /* k is intersect with p2q2. l is intersect is p2r2. */
-        intersect_1 = tti_interp(p2, q2, p1, n1, buf[0], buf[1], buf[2]);
-        intersect_2 = tti_interp(p2, r2, p1, n1, buf[0], buf[1], buf[2]);
+        intersect_1 = tti_interp(p2, q2, p1, q1, r1, n1, buf[0], buf[1], buf[2]);
+        intersect_2 = tti_interp(p2, r2, p1, q1, r1, n1, buf[0], buf[1], buf[2]);
       }
     }
     else {
@@ -1257,7 +1300,7 @@ static ITT_value itt_canon2(const mpq3 &p1,
   }
   else {
     /* Middle left test in classification tree. */
-    if (tti_above(p1, q1, q2, p1p2, buf[0], buf[1], buf[2], buf[3]) < 0) {
+    if (tti_above(p1, q1, q2, p2, buf[0], buf[1], buf[2], buf[3], buf[4]) < 0) {
       /* No overlap: [i j] [k l]. */
       if (dbg_level > 0) {
         std::cout << "no overlap: [i j] [k l]\n";
@@ -1266,14 +1309,14 @@ static ITT_value itt_canon2(const mpq3 &p1,
     }
     else {
       /* Bottom left test in classification tree. */
-      if (tti_above(p1, r1, q2, p1p2, buf[0], buf[1], buf[2], buf[3]) >= 0) {
+      if (tti_above(p1, r1, q2, p2, buf[0], buf[1], buf[2], buf[3], buf[4]) >= 0) {
         /* Overlap is [k [i j] l]. */
         if (dbg_level > 0) {
           std::cout << "overlap [k [i j] l]\n";
         }
         /* i is intersect with p1r1. j is intersect with p1q1. */
-        intersect_1 = tti_interp(p1, r1, p2, n2, buf[0], buf[1], buf[2]);
-        intersect_2 = tti_interp(p1, q1, p2, n2, buf[0], buf[1], buf[2]);
+        intersect_1 = tti_interp(p1, r1, p2, q2, r2, n2, buf[0], buf[1], buf[2]);
+        intersect_2 = tti_interp(p1, q1, p2, q2, r2, n2, buf[0], buf[1], buf[2]);
       }
       else {
         /* Overlap is [i [k j] l]. */
@@ -1281,8 +1324,8 @@ static ITT_value itt_canon2(const mpq3 &p1,
           std::cout << "overlap [i [k j] l]\n";
         }
         /* k is intersect with p2q2. j is intersect with p1q1. */
-        intersect_1 = tti_interp(p2, q2, p1, n1, buf[0], buf[1], buf[2]);
-        intersect_2 = tti_interp(p1, q1, p2, n2, buf[0], buf[1], buf[2]);
+        intersect_1 = tti_interp(p2, q2, p1, q1, r1, n1, buf[0], buf[1], buf[2]);
+        intersect_2 = tti_interp(p1, q1, p2, q2, r2, n2, buf[0], buf[1], buf[2]);
       }
     }
   }
@@ -1303,12 +1346,12 @@ static ITT_value itt_canon2(const mpq3 &p1,
 
 /* Helper function for intersect_tri_tri. Arguments have been canonicalized for triangle 1. */
 
-static ITT_value itt_canon1(const mpq3 &p1,
-                            const mpq3 &q1,
-                            const mpq3 &r1,
-                            const mpq3 &p2,
-                            const mpq3 &q2,
-                            const mpq3 &r2,
+static ITT_value itt_canon1(const Vert *p1,
+                            const Vert *q1,
+                            const Vert *r1,
+                            const Vert *p2,
+                            const Vert *q2,
+                            const Vert *r2,
                             const mpq3 &n1,
                             const mpq3 &n2,
                             int sp2,
@@ -1441,18 +1484,20 @@ static ITT_value intersect_tri_tri(const IMesh &tm, int t1, int t2)
   const mpq3 &q2 = vq2->co_exact;
   const mpq3 &r2 = vr2->co_exact;
 
+  /* A vertex shared with the other triangle is exactly on its plane, which the filter can never
+   * decide. Shared vertices are common because most overlapping pairs are adjacent triangles. */
   const mpq3 &n2 = tri2.plane->norm_exact;
-  if (sp1 == 0) {
+  if (sp1 == 0 && !ELEM(vp1, vp2, vq2, vr2)) {
     buf[0] = p1;
     buf[0] -= r2;
     sp1 = sgn(math::dot_with_buffer(buf[0], n2, buf[1]));
   }
-  if (sq1 == 0) {
+  if (sq1 == 0 && !ELEM(vq1, vp2, vq2, vr2)) {
     buf[0] = q1;
     buf[0] -= r2;
     sq1 = sgn(math::dot_with_buffer(buf[0], n2, buf[1]));
   }
-  if (sr1 == 0) {
+  if (sr1 == 0 && !ELEM(vr1, vp2, vq2, vr2)) {
     buf[0] = r1;
     buf[0] -= r2;
     sr1 = sgn(math::dot_with_buffer(buf[0], n2, buf[1]));
@@ -1474,17 +1519,17 @@ static ITT_value intersect_tri_tri(const IMesh &tm, int t1, int t2)
 
   /* Repeat for signs of t2's vertices with respect to plane of t1. */
   const mpq3 &n1 = tri1.plane->norm_exact;
-  if (sp2 == 0) {
+  if (sp2 == 0 && !ELEM(vp2, vp1, vq1, vr1)) {
     buf[0] = p2;
     buf[0] -= r1;
     sp2 = sgn(math::dot_with_buffer(buf[0], n1, buf[1]));
   }
-  if (sq2 == 0) {
+  if (sq2 == 0 && !ELEM(vq2, vp1, vq1, vr1)) {
     buf[0] = q2;
     buf[0] -= r1;
     sq2 = sgn(math::dot_with_buffer(buf[0], n1, buf[1]));
   }
-  if (sr2 == 0) {
+  if (sr2 == 0 && !ELEM(vr2, vp1, vq1, vr1)) {
     buf[0] = r2;
     buf[0] -= r1;
     sr2 = sgn(math::dot_with_buffer(buf[0], n1, buf[1]));
@@ -1510,49 +1555,49 @@ static ITT_value intersect_tri_tri(const IMesh &tm, int t1, int t2)
   ITT_value ans;
   if (sp1 > 0) {
     if (sq1 > 0) {
-      ans = itt_canon1(r1, p1, q1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+      ans = itt_canon1(vr1, vp1, vq1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
     }
     else if (sr1 > 0) {
-      ans = itt_canon1(q1, r1, p1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+      ans = itt_canon1(vq1, vr1, vp1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
     }
     else {
-      ans = itt_canon1(p1, q1, r1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+      ans = itt_canon1(vp1, vq1, vr1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
     }
   }
   else if (sp1 < 0) {
     if (sq1 < 0) {
-      ans = itt_canon1(r1, p1, q1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+      ans = itt_canon1(vr1, vp1, vq1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
     }
     else if (sr1 < 0) {
-      ans = itt_canon1(q1, r1, p1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+      ans = itt_canon1(vq1, vr1, vp1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
     }
     else {
-      ans = itt_canon1(p1, q1, r1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+      ans = itt_canon1(vp1, vq1, vr1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
     }
   }
   else {
     if (sq1 < 0) {
       if (sr1 >= 0) {
-        ans = itt_canon1(q1, r1, p1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+        ans = itt_canon1(vq1, vr1, vp1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
       }
       else {
-        ans = itt_canon1(p1, q1, r1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+        ans = itt_canon1(vp1, vq1, vr1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
       }
     }
     else if (sq1 > 0) {
       if (sr1 > 0) {
-        ans = itt_canon1(p1, q1, r1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+        ans = itt_canon1(vp1, vq1, vr1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
       }
       else {
-        ans = itt_canon1(q1, r1, p1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+        ans = itt_canon1(vq1, vr1, vp1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
       }
     }
     else {
       if (sr1 > 0) {
-        ans = itt_canon1(r1, p1, q1, p2, q2, r2, n1, n2, sp2, sq2, sr2);
+        ans = itt_canon1(vr1, vp1, vq1, vp2, vq2, vr2, n1, n2, sp2, sq2, sr2);
       }
       else if (sr1 < 0) {
-        ans = itt_canon1(r1, p1, q1, p2, r2, q2, n1, n2, sp2, sr2, sq2);
+        ans = itt_canon1(vr1, vp1, vq1, vp2, vr2, vq2, n1, n2, sp2, sr2, sq2);
       }
       else {
         if (dbg_level > 0) {
@@ -3176,6 +3221,22 @@ static void perfdata_init()
   perfdata->count.append(0);
   perfdata->count_name.append("final non-NONE intersects");
 
+  /* count 5. */
+  perfdata->count.append(0);
+  perfdata->count_name.append("tri tri above tests decided by filter");
+
+  /* count 6. */
+  perfdata->count.append(0);
+  perfdata->count_name.append("tri tri above tests decided exactly");
+
+  /* count 7. */
+  perfdata->count.append(0);
+  perfdata->count_name.append("tri tri interpolations decided by shared vertices");
+
+  /* count 8. */
+  perfdata->count.append(0);
+  perfdata->count_name.append("tri tri interpolations computed exactly");
+
   /* max 0. */
   perfdata->max.append(0);
   perfdata->max_name.append("total faces");
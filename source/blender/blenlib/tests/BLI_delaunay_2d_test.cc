@@ -19,6 +19,7 @@
 #define DO_RANDOM_TESTS 0
 
 #include "BLI_array.hh"
+#include "BLI_map.hh"
 #include "BLI_math_boolean.hh"
 #include "BLI_math_mpq.hh"
 #include "BLI_math_vector_mpq_types.hh"
@@ -1447,6 +1448,50 @@ template<typename T> void square_o_test()
   }
 }
 
+/* Enough points for the divide and conquer triangulation to do its halves in parallel. */
+static void large_random_pts_test()
+{
+  const int pts_num = 20000;
+  RNG *rng = BLI_rng_new(0);
+  CDT_input<double> in;
+  in.vert.reinitialize(pts_num);
+  for (const int i : in.vert.index_range()) {
+    in.vert[i] = double2(BLI_rng_get_double(rng), BLI_rng_get_double(rng));
+  }
+  BLI_rng_free(rng);
+  CDT_result<double> out = delaunay_2d_calc(in, CDT_FULL);
+  EXPECT_EQ(out.vert.size(), pts_num);
+  /* No outer face in the output, so V - E + F = 1. */
+  EXPECT_EQ(out.vert.size() - out.edge.size() + out.face.size(), 1);
+
+  /* The result should be deterministic, no matter how the work was split between threads. */
+  CDT_result<double> out2 = delaunay_2d_calc(in, CDT_FULL);
+  ASSERT_EQ(out.edge.size(), out2.edge.size());
+  ASSERT_EQ(out.face.size(), out2.face.size());
+  EXPECT_EQ_ARRAY(out.edge.data(), out2.edge.data(), out.edge.size());
+  for (const int f : out.face.index_range()) {
+    EXPECT_EQ(out.face[f], out2.face[f]);
+  }
+
+  /* All triangles are CCW, and all interior edges pass the circle test. */
+  Map<std::pair<int, int>, int> opposite_vert;
+  for (const Vector<int> &face : out.face) {
+    ASSERT_EQ(face.size(), 3);
+    EXPECT_GT(orient2d(out.vert[face[0]], out.vert[face[1]], out.vert[face[2]]), 0);
+    for (const int i : IndexRange(3)) {
+      opposite_vert.add({face[i], face[(i + 1) % 3]}, face[(i + 2) % 3]);
+    }
+  }
+  for (const auto item : opposite_vert.items()) {
+    const int a = item.key.first;
+    const int b = item.key.second;
+    const int *other = opposite_vert.lookup_ptr({b, a});
+    if (other != nullptr) {
+      EXPECT_LE(incircle(out.vert[a], out.vert[b], out.vert[item.value], out.vert[*other]), 0);
+    }
+  }
+}
+
 TEST(delaunay_d, Empty)
 {
   empty_test<double>();
@@ -1592,6 +1637,11 @@ TEST(delaunay_d, SquareO)
   square_o_test<double>();
 }
 
+TEST(delaunay_d, LargeRandomPts)
+{
+  large_random_pts_test();
+}
+
 #  ifdef WITH_GMP
 TEST(delaunay_m, Empty)
 {
@@ -2201,7 +2251,7 @@ void rand_delaunay_test(int test_kind,
   }
   if (print_timing) {
     std::cout << "\nsize,time\n";
-    for (int lg_size = 0; lg_size <= max_lg_size; lg_size++) {
+    for (int lg_size = start_lg_size; lg_size <= max_lg_size; lg_size++) {
       int size = 1 << lg_size;
       std::cout << size << "," << times[lg_size] << "\n";
     }
@@ -2214,6 +2264,12 @@ TEST(delaunay_d, RandomPts)
   rand_delaunay_test<double>(RANDOM_PTS, 0, 7, 1, 0.0, CDT_FULL);
 }
 
+/* One million points, large enough for the parallel triangulation to matter. */
+TEST(delaunay_d, RandomPtsLarge)
+{
+  rand_delaunay_test<double>(RANDOM_PTS, 20, 20, 1, 0.0, CDT_FULL);
+}
+
 TEST(delaunay_d, RandomSegs)
 {
   rand_delaunay_test<double>(RANDOM_SEGS, 1, 7, 1, 0.0, CDT_FULL);
@@ -10,8 +10,10 @@
 
 #include "BLI_compiler_attrs.h"
 #include "BLI_kdopbvh.h"
+#include "BLI_math_geom.h"
 #include "BLI_math_vector.h"
 #include "BLI_rand.h"
+#include "BLI_timeit.hh"
 
 /* -------------------------------------------------------------------- */
 /* Helper Functions */
@@ -68,8 +70,12 @@ static void optimal_check_callback(void *userdata,
  * Note that a small epsilon is added to the BVH nodes bounds, even if we pass in zero.
  * Use rounding to ensure very close nodes don't cause the wrong node to be found as nearest.
  */
-static void find_nearest_points_test(
-    int points_len, float scale, int round, int random_seed, bool optimal = false)
+static void find_nearest_points_test(int points_len,
+                                     float scale,
+                                     int round,
+                                     int random_seed,
+                                     bool optimal = false,
+                                     bool use_sah = false)
 {
   RNG *rng = BLI_rng_new(random_seed);
   BVHTree *tree = BLI_bvhtree_new(points_len, 0.0, 8, 8);
@@ -81,7 +87,12 @@ static void find_nearest_points_test(
     rng_v3_round(points[i], 3, rng, round, scale);
     BLI_bvhtree_insert(tree, i, points[i], 1);
   }
-  BLI_bvhtree_balance(tree);
+  if (use_sah) {
+    BLI_bvhtree_balance_sah(tree);
+  }
+  else {
+    BLI_bvhtree_balance(tree);
+  }
 
   /* first find each point */
   BVHTree_NearestPointCallback callback = optimal ? optimal_check_callback : nullptr;
@@ -134,3 +145,358 @@ TEST(kdopbvh, OptimalFindNearest_500)
 {
   find_nearest_points_test(500, 1.0, 1000, 12, true);
 }
+
+TEST(kdopbvh, SAHFindNearest_2)
+{
+  find_nearest_points_test(2, 1.0, 1000, 123, false, true);
+}
+TEST(kdopbvh, SAHFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, false, true);
+}
+TEST(kdopbvh, SAHOptimalFindNearest_500)
+{
+  find_nearest_points_test(500, 1.0, 1000, 12, true, true);
+}
+
+static void raycast_tris_callback(void *userdata,
+                                  int index,
+                                  const BVHTreeRay *ray,
+                                  BVHTreeRayHit *hit)
+{
+  const float(*tris)[3][3] = static_cast<const float(*)[3][3]>(userdata);
+  float dist;
+  const float(*tri)[3] = tris[index];
+  if (isect_ray_tri_v3(ray->origin, ray->direction, tri[0], tri[1], tri[2], &dist, nullptr)) {
+    if (dist < hit->dist) {
+      hit->dist = dist;
+      hit->index = index;
+    }
+  }
+}
+
+static BVHTree *tris_tree_create(const float (*tris)[3][3],
+                                 const int tris_len,
+                                 const int tree_type,
+                                 const bool use_sah)
+{
+  BVHTree *tree = BLI_bvhtree_new(tris_len, 0.0f, tree_type, 6);
+  for (int i = 0; i < tris_len; i++) {
+    BLI_bvhtree_insert(tree, i, tris[i][0], 3);
+  }
+  if (use_sah) {
+    BLI_bvhtree_balance_sah(tree);
+  }
+  else {
+    BLI_bvhtree_balance(tree);
+  }
+  return tree;
+}
+
+/**
+ * Small random triangles, the rays are cast through the cloud from random directions.
+ */
+static void raycast_sah_test(const int tris_len, const int tree_type, const int rays_len)
+{
+  RNG *rng = BLI_rng_new(tris_len);
+  float(*tris)[3][3] = static_cast<float(*)[3][3]>(
+      MEM_mallocN(sizeof(float[3][3]) * tris_len, __func__));
+  for (int i = 0; i < tris_len; i++) {
+    float center[3];
+    BLI_rng_get_float_unit_v3(rng, center);
+    mul_v3_fl(center, BLI_rng_get_float(rng));
+    for (int j = 0; j < 3; j++) {
+      BLI_rng_get_float_unit_v3(rng, tris[i][j]);
+      madd_v3_v3v3fl(tris[i][j], center, tris[i][j], 0.05f);
+    }
+  }
+
+  BVHTree *tree_median = tris_tree_create(tris, tris_len, tree_type, false);
+  BVHTree *tree_sah = tris_tree_create(tris, tris_len, tree_type, true);
+  EXPECT_EQ(BLI_bvhtree_get_len(tree_sah), tris_len);
+
+  for (int i = 0; i < rays_len; i++) {
+    float origin[3], dir[3];
+    BLI_rng_get_float_unit_v3(rng, origin);
+    mul_v3_fl(origin, 2.0f);
+    BLI_rng_get_float_unit_v3(rng, dir);
+    madd_v3_v3fl(dir, origin, -0.5f);
+    normalize_v3(dir);
+
+    BVHTreeRayHit hit_median = {-1};
+    hit_median.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(
+        tree_median, origin, dir, 0.0f, &hit_median, raycast_tris_callback, tris);
+    BVHTreeRayHit hit_sah = {-1};
+    hit_sah.dist = BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree_sah, origin, dir, 0.0f, &hit_sah, raycast_tris_callback, tris);
+    EXPECT_EQ(hit_median.index, hit_sah.index);
+    EXPECT_EQ(hit_median.dist, hit_sah.dist);
+  }
+
+  /* Moving all triangles must keep the tree valid. */
+  for (int i = 0; i < tris_len; i++) {
+    for (int j = 0; j < 3; j++) {
+      tris[i][j][2] += 1.0f;
+    }
+    BLI_bvhtree_update_node(tree_sah, i, tris[i][0], nullptr, 3);
+  }
+  BLI_bvhtree_update_tree(tree_sah);
+  float bb_min[3], bb_max[3];
+  BLI_bvhtree_get_bounding_box(tree_sah, bb_min, bb_max);
+  EXPECT_GT(bb_min[2], -0.1f);
+
+  BLI_bvhtree_free(tree_median);
+  BLI_bvhtree_free(tree_sah);
+  BLI_rng_free(rng);
+  MEM_freeN(tris);
+}
+
+TEST(kdopbvh, SAHRayCast)
+{
+  raycast_sah_test(3, 2, 100);
+  raycast_sah_test(2000, 2, 1000);
+  raycast_sah_test(2000, 4, 1000);
+  raycast_sah_test(2000, 8, 1000);
+}
+
+/**
+ * Compare #BLI_bvhtree_ray_cast_batch with casting the same rays one by one.
+ */
+static void raycast_batch_test(const int tris_len,
+                               const int tree_type,
+                               const int rays_len,
+                               const float radius,
+                               const bool use_callback)
+{
+  RNG *rng = BLI_rng_new(tris_len + rays_len);
+  float(*tris)[3][3] = static_cast<float(*)[3][3]>(
+      MEM_mallocN(sizeof(float[3][3]) * tris_len, __func__));
+  for (int i = 0; i < tris_len; i++) {
+    float center[3];
+    BLI_rng_get_float_unit_v3(rng, center);
+    mul_v3_fl(center, BLI_rng_get_float(rng));
+    for (int j = 0; j < 3; j++) {
+      BLI_rng_get_float_unit_v3(rng, tris[i][j]);
+      madd_v3_v3v3fl(tris[i][j], center, tris[i][j], 0.05f);
+    }
+  }
+  BVHTree *tree = tris_tree_create(tris, tris_len, tree_type, false);
+
+  float(*origins)[3] = static_cast<float(*)[3]>(
+      MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  float(*dirs)[3] = static_cast<float(*)[3]>(MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  BVHTreeRayHit *hits = static_cast<BVHTreeRayHit *>(
+      MEM_mallocN(sizeof(BVHTreeRayHit) * rays_len, __func__));
+  for (int i = 0; i < rays_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, origins[i]);
+    mul_v3_fl(origins[i], 2.0f);
+    BLI_rng_get_float_unit_v3(rng, dirs[i]);
+    madd_v3_v3fl(dirs[i], origins[i], -0.5f);
+    normalize_v3(dirs[i]);
+    hits[i].index = -1;
+    /* Some rays are too short to reach the triangles. */
+    hits[i].dist = (i % 5 == 0) ? 0.5f : BVH_RAYCAST_DIST_MAX;
+  }
+
+  BVHTree_RayCastCallback callback = use_callback ? raycast_tris_callback : nullptr;
+  BLI_bvhtree_ray_cast_batch(tree,
+                             origins,
+                             dirs,
+                             rays_len,
+                             radius,
+                             hits,
+                             callback,
+                             tris,
+                             BVH_RAYCAST_DEFAULT | BVH_RAYCAST_USE_THREADING);
+
+  for (int i = 0; i < rays_len; i++) {
+    BVHTreeRayHit hit = {-1};
+    hit.dist = (i % 5 == 0) ? 0.5f : BVH_RAYCAST_DIST_MAX;
+    BLI_bvhtree_ray_cast(tree, origins[i], dirs[i], radius, &hit, callback, tris);
+    /* Without a callback the hit is the nearest bounding box, touching boxes can tie and the
+     * packet may visit them in a different order. */
+    if (use_callback) {
+      EXPECT_EQ(hits[i].index, hit.index);
+    }
+    EXPECT_EQ(hits[i].dist, hit.dist);
+  }
+
+  BLI_bvhtree_free(tree);
+  BLI_rng_free(rng);
+  MEM_freeN(hits);
+  MEM_freeN(origins);
+  MEM_freeN(dirs);
+  MEM_freeN(tris);
+}
+
+TEST(kdopbvh, RayCastBatch)
+{
+  raycast_batch_test(1, 2, 3, 0.0f, true);
+  raycast_batch_test(2000, 2, 1001, 0.0f, true);
+  raycast_batch_test(2000, 4, 1000, 0.0f, true);
+  raycast_batch_test(2000, 8, 1003, 0.0f, false);
+  raycast_batch_test(2000, 4, 1000, 0.01f, true);
+}
+
+static bool overlap_thread_check_callback(void *userdata,
+                                          int index_a,
+                                          int index_b,
+                                          int thread)
+{
+  const int thread_num = *static_cast<const int *>(userdata);
+  EXPECT_GE(thread, 0);
+  EXPECT_LT(thread, thread_num);
+  return (index_a + index_b) % 3 != 0;
+}
+
+static BVHTree *points_tree_create(const int points_len, const int tree_type, RNG *rng)
+{
+  BVHTree *tree = BLI_bvhtree_new(points_len, 0.02f, tree_type, 6);
+  for (int i = 0; i < points_len; i++) {
+    float co[3];
+    BLI_rng_get_float_unit_v3(rng, co);
+    mul_v3_fl(co, BLI_rng_get_float(rng));
+    BLI_bvhtree_insert(tree, i, co, 1);
+  }
+  BLI_bvhtree_balance(tree);
+  return tree;
+}
+
+/**
+ * The threaded overlap must find the same pairs as the single threaded traversal.
+ */
+static void overlap_threaded_test(const int points_len, const int tree_type, const bool use_self)
+{
+  RNG *rng = BLI_rng_new(points_len);
+  BVHTree *tree1 = points_tree_create(points_len, tree_type, rng);
+  BVHTree *tree2 = use_self ? tree1 : points_tree_create(points_len / 2, tree_type, rng);
+
+  int thread_num = BLI_bvhtree_overlap_thread_num(tree1);
+  const int flag = BVH_OVERLAP_RETURN_PAIRS | (use_self ? BVH_OVERLAP_SELF : 0);
+  uint overlap_num, overlap_threaded_num;
+  BVHTreeOverlap *overlap = BLI_bvhtree_overlap_ex(
+      tree1, tree2, &overlap_num, overlap_thread_check_callback, &thread_num, 0, flag);
+  BVHTreeOverlap *overlap_threaded = BLI_bvhtree_overlap_ex(tree1,
+                                                            tree2,
+                                                            &overlap_threaded_num,
+                                                            overlap_thread_check_callback,
+                                                            &thread_num,
+                                                            0,
+                                                            flag | BVH_OVERLAP_USE_THREADING);
+  EXPECT_GT(overlap_num, 0);
+  ASSERT_EQ(overlap_num, overlap_threaded_num);
+
+  /* The pairs are in the same order, regardless of the thread scheduling. */
+  for (uint i = 0; i < overlap_num; i++) {
+    EXPECT_EQ(overlap[i].indexA, overlap_threaded[i].indexA);
+    EXPECT_EQ(overlap[i].indexB, overlap_threaded[i].indexB);
+  }
+
+  MEM_freeN(overlap);
+  MEM_freeN(overlap_threaded);
+  BLI_bvhtree_free(tree1);
+  if (!use_self) {
+    BLI_bvhtree_free(tree2);
+  }
+  BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, OverlapThreaded)
+{
+  overlap_threaded_test(2000, 2, false);
+  overlap_threaded_test(2000, 4, false);
+  overlap_threaded_test(2000, 8, false);
+  overlap_threaded_test(2000, 2, true);
+  overlap_threaded_test(2000, 4, true);
+  overlap_threaded_test(2000, 8, true);
+}
+
+/* Disable benchmark by default. */
+#if 0
+TEST(kdopbvh, BenchmarkSAH)
+{
+  /* A dense wavy grid, with more triangles on one side like typical scanned or sculpted
+   * surfaces. */
+  const int side = 2000;
+  const int tris_len = side * side * 2;
+  float(*tris)[3][3] = static_cast<float(*)[3][3]>(
+      MEM_mallocN(sizeof(float[3][3]) * tris_len, __func__));
+  auto grid_co = [&](const int x, const int y, float r_co[3]) {
+    r_co[0] = powf(float(x) / side, 3.0f);
+    r_co[1] = float(y) / side;
+    r_co[2] = sinf(r_co[0] * 20.0f) * 0.1f;
+  };
+  for (int y = 0; y < side; y++) {
+    for (int x = 0; x < side; x++) {
+      float(*tri)[3] = tris[(y * side + x) * 2];
+      grid_co(x, y, tri[0]);
+      grid_co(x + 1, y, tri[1]);
+      grid_co(x + 1, y + 1, tri[2]);
+      copy_v3_v3(tri[3], tri[0]);
+      copy_v3_v3(tri[4], tri[2]);
+      grid_co(x, y + 1, tri[5]);
+    }
+  }
+
+  RNG *rng = BLI_rng_new(0);
+  const int rays_len = 1000000;
+  float(*origins)[3] = static_cast<float(*)[3]>(
+      MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  float(*dirs)[3] = static_cast<float(*)[3]>(
+      MEM_mallocN(sizeof(float[3]) * rays_len, __func__));
+  for (int i = 0; i < rays_len; i++) {
+    BLI_rng_get_float_unit_v3(rng, dirs[i]);
+    dirs[i][2] = -1.0f;
+    normalize_v3(dirs[i]);
+    origins[i][0] = BLI_rng_get_float(rng);
+    origins[i][1] = BLI_rng_get_float(rng);
+    origins[i][2] = 1.0f;
+  }
+
+  for (const bool use_sah : {false, true}) {
+    for (const int tree_type : {2, 4}) {
+      std::cout << (use_sah ? "SAH" : "Median") << ", tree type " << tree_type << "\n";
+      BVHTree *tree;
+      {
+        SCOPED_TIMER("build");
+        tree = tris_tree_create(tris, tris_len, tree_type, use_sah);
+      }
+      {
+        SCOPED_TIMER("ray-cast");
+        for (int i = 0; i < rays_len; i++) {
+          BVHTreeRayHit hit = {-1};
+          hit.dist = BVH_RAYCAST_DIST_MAX;
+          BLI_bvhtree_ray_cast(tree, origins[i], dirs[i], 0.0f, &hit, raycast_tris_callback, tris);
+        }
+      }
+      {
+        SCOPED_TIMER("ray-cast batch");
+        BVHTreeRayHit *hits = static_cast<BVHTreeRayHit *>(
+            MEM_mallocN(sizeof(BVHTreeRayHit) * rays_len, __func__));
+        for (int i = 0; i < rays_len; i++) {
+          hits[i].index = -1;
+          hits[i].dist = BVH_RAYCAST_DIST_MAX;
+        }
+        BLI_bvhtree_ray_cast_batch(
+            tree, origins, dirs, rays_len, 0.0f, hits, raycast_tris_callback, tris, 0);
+        MEM_freeN(hits);
+      }
+      {
+        SCOPED_TIMER("find nearest");
+        for (int i = 0; i < rays_len; i++) {
+          BVHTreeNearest nearest = {-1};
+          nearest.dist_sq = FLT_MAX;
+          BLI_bvhtree_find_nearest(tree, origins[i], &nearest, nullptr, nullptr);
+        }
+      }
+      BLI_bvhtree_free(tree);
+    }
+  }
+
+  BLI_rng_free(rng);
+  MEM_freeN(origins);
+  MEM_freeN(dirs);
+  MEM_freeN(tris);
+}
+#endif
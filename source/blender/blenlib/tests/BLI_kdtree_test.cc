@@ -4,7 +4,13 @@
 
 #include "testing/testing.h"
 
+#include "BLI_array.hh"
 #include "BLI_kdtree.h"
+#include "BLI_math_vector.hh"
+#include "BLI_rand.hh"
+#include "BLI_timeit.hh"
+
+#include "MEM_guardedalloc.h"
 
 #include <cmath>
 
@@ -63,3 +69,112 @@ TEST(kdtree, Deduplicate)
 {
   deduplicate_test();
 }
+
+static KDTree_3d *random_tree_3d(const int points_num, blender::Array<blender::float3> &r_points)
+{
+  blender::RandomNumberGenerator rng(points_num);
+  r_points.reinitialize(points_num);
+  KDTree_3d *tree = BLI_kdtree_3d_new(points_num);
+  for (const int i : r_points.index_range()) {
+    r_points[i] = rng.get_unit_float3() * rng.get_float();
+    BLI_kdtree_3d_insert(tree, i, r_points[i]);
+  }
+  BLI_kdtree_3d_balance(tree);
+  return tree;
+}
+
+TEST(kdtree, LargeTreeNearest)
+{
+  using namespace blender;
+  Array<float3> points;
+  /* Large enough for sub-trees to be balanced in separate tasks. */
+  KDTree_3d *tree = random_tree_3d(50000, points);
+  RandomNumberGenerator rng(0);
+  for ([[maybe_unused]] const int i : IndexRange(200)) {
+    const float3 co = rng.get_unit_float3() * rng.get_float();
+    int expected_index = -1;
+    float expected_dist_sq = FLT_MAX;
+    for (const int j : points.index_range()) {
+      const float dist_sq = math::distance_squared(co, points[j]);
+      if (dist_sq < expected_dist_sq) {
+        expected_dist_sq = dist_sq;
+        expected_index = j;
+      }
+    }
+    KDTreeNearest_3d nearest;
+    EXPECT_EQ(BLI_kdtree_3d_find_nearest(tree, co, &nearest), expected_index);
+  }
+  BLI_kdtree_3d_free(tree);
+}
+
+TEST(kdtree, Batch)
+{
+  using namespace blender;
+  Array<float3> points;
+  KDTree_3d *tree = random_tree_3d(20000, points);
+  Array<float3> queries(3000);
+  RandomNumberGenerator rng(1);
+  for (float3 &co : queries) {
+    co = rng.get_unit_float3() * rng.get_float();
+  }
+  const float(*queries_ptr)[3] = reinterpret_cast<const float(*)[3]>(queries.data());
+
+  Array<int> indices(queries.size());
+  Array<float> dists(queries.size());
+  BLI_kdtree_3d_find_nearest_batch(
+      tree, queries_ptr, queries.size(), indices.data(), dists.data());
+
+  Array<int> offsets(queries.size() + 1);
+  int *range_indices;
+  float *range_dists;
+  const int range_total = BLI_kdtree_3d_range_search_batch(
+      tree, queries_ptr, queries.size(), 0.05f, offsets.data(), &range_indices, &range_dists);
+  EXPECT_EQ(offsets.last(), range_total);
+
+  for (const int i : queries.index_range()) {
+    KDTreeNearest_3d nearest;
+    EXPECT_EQ(indices[i], BLI_kdtree_3d_find_nearest(tree, queries[i], &nearest));
+    EXPECT_EQ(dists[i], nearest.dist);
+
+    KDTreeNearest_3d *range_nearest = nullptr;
+    const int range_num = BLI_kdtree_3d_range_search(tree, queries[i], &range_nearest, 0.05f);
+    ASSERT_EQ(offsets[i + 1] - offsets[i], range_num);
+    for (const int j : IndexRange(range_num)) {
+      const int found = offsets[i] + j;
+      const float3 &found_co = points[range_indices[found]];
+      EXPECT_NEAR(range_dists[found], math::distance(queries[i], found_co), 1e-6f);
+      EXPECT_LE(range_dists[found], 0.05f);
+    }
+    MEM_SAFE_FREE(range_nearest);
+  }
+  MEM_freeN(range_indices);
+  MEM_freeN(range_dists);
+  BLI_kdtree_3d_free(tree);
+}
+
+/* Disable benchmark by default. */
+#if 0
+TEST(kdtree, BenchmarkBatch)
+{
+  using namespace blender;
+  Array<float3> points;
+  KDTree_3d *tree;
+  {
+    SCOPED_TIMER("balance");
+    tree = random_tree_3d(5'000'000, points);
+  }
+  const float(*points_ptr)[3] = reinterpret_cast<const float(*)[3]>(points.data());
+  Array<int> indices(points.size());
+  {
+    SCOPED_TIMER("find_nearest");
+    for (const int i : points.index_range()) {
+      indices[i] = BLI_kdtree_3d_find_nearest(tree, points[i], nullptr);
+    }
+  }
+  {
+    SCOPED_TIMER("find_nearest_batch");
+    BLI_kdtree_3d_find_nearest_batch(tree, points_ptr, points.size(), indices.data(), nullptr);
+  }
+  BLI_kdtree_3d_free(tree);
+}
+#endif
@@ -4,10 +4,12 @@
 
 #include "testing/testing.h"
 
+#include "BLI_array.hh"
 #include "BLI_math_matrix.h"
 #include "BLI_math_matrix.hh"
 #include "BLI_math_rotation.h"
 #include "BLI_math_rotation.hh"
+#include "BLI_rand.hh"
 
 TEST(math_matrix, interp_m4_m4m4_regular)
 {
@@ -569,6 +571,44 @@ TEST(math_matrix, MatrixTransform)
   EXPECT_V2_NEAR(result2, expect2, 1e-5);
 }
 
+TEST(math_matrix, BatchTransform)
+{
+  const float4x4 m4 = from_loc_rot_scale<float4x4>(
+      {10, -2, 0.5f}, EulerXYZ(0.3f, 1.2f, -0.7f), float3(2, 0.5f, 1.5f));
+  const float3x3 m3 = float3x3(m4);
+  /* Use a size that is not a multiple of the SIMD width. */
+  RandomNumberGenerator rng(42);
+  Array<float3> src(23);
+  for (float3 &value : src) {
+    value = float3(rng.get_float(), rng.get_float(), rng.get_float()) * 10.0f - 5.0f;
+  }
+
+  Array<float3> dst(src.size());
+  transform_points(m4, src, dst);
+  for (const int i : src.index_range()) {
+    EXPECT_EQ(dst[i], transform_point(m4, src[i]));
+  }
+  transform_directions(m3, src, dst);
+  for (const int i : src.index_range()) {
+    EXPECT_EQ(dst[i], transform_direction(m3, src[i]));
+  }
+  Array<float3> in_place = src;
+  transform_points(m4, in_place);
+  for (const int i : src.index_range()) {
+    EXPECT_EQ(in_place[i], transform_point(m4, src[i]));
+  }
+
+  Array<float4x4> matrices(5);
+  for (const int i : matrices.index_range()) {
+    matrices[i] = from_loc_rot<float4x4>(src[i], EulerXYZ(src[i + 5]));
+  }
+  Array<float4x4> transformed_matrices = matrices;
+  transform_matrices(m4, transformed_matrices);
+  for (const int i : matrices.index_range()) {
+    EXPECT_EQ(transformed_matrices[i], m4 * matrices[i]);
+  }
+}
+
 TEST(math_matrix, MatrixProjection)
 {
   using namespace math::projection;
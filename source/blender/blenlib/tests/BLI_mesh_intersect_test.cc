@@ -9,9 +9,11 @@
 #include <iostream>
 
 #include "BLI_array.hh"
+#include "BLI_math_boolean.hh"
 #include "BLI_math_mpq.hh"
 #include "BLI_math_vector_mpq_types.hh"
 #include "BLI_mesh_intersect.hh"
+#include "BLI_rand.hh"
 #include "BLI_task.h"
 #include "BLI_time.h"
 #include "BLI_vector.hh"
@@ -809,6 +811,48 @@ TEST(mesh_intersect, RectCross)
     write_obj_mesh(out, "test_rectcross");
   }
 }
+
+TEST(mesh_intersect, Orient3dFilter)
+{
+  /* The filter must never disagree with the exact predicate on the unrounded points,
+   * including for points that are (nearly) co-planar, where it should give up instead. */
+  RandomNumberGenerator rng(0);
+  int decided = 0;
+  for (int i = 0; i < 2000; i++) {
+    mpq3 p[4];
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++) {
+        p[j][k] = mpq_class(rng.get_int32(2000) - 1000, rng.get_int32(999) + 1);
+      }
+    }
+    /* Put the last point on the plane, or perturb it slightly off it, half of the time. */
+    const mpq_class u(rng.get_int32(100), 97);
+    const mpq_class v(rng.get_int32(100), 89);
+    p[3] = p[0] + u * (p[1] - p[0]) + v * (p[2] - p[0]);
+    if (i % 4 == 1) {
+      p[3].z += mpq_class(1, 1 << 30);
+    }
+    else if (i % 4 == 2) {
+      p[3].z += mpq_class(rng.get_int32(2000) - 1000, 7);
+    }
+    const double3 d[4] = {
+        {p[0].x.get_d(), p[0].y.get_d(), p[0].z.get_d()},
+        {p[1].x.get_d(), p[1].y.get_d(), p[1].z.get_d()},
+        {p[2].x.get_d(), p[2].y.get_d(), p[2].z.get_d()},
+        {p[3].x.get_d(), p[3].y.get_d(), p[3].z.get_d()},
+    };
+    const int filter = orient3d_filter(d[0], d[1], d[2], d[3]);
+    if (filter != 0) {
+      EXPECT_EQ(filter, orient3d(p[0], p[1], p[2], p[3]));
+      decided++;
+    }
+    if (i % 4 == 0) {
+      EXPECT_EQ(filter, 0);
+    }
+  }
+  /* Points far from each other's planes should be decided by the filter. */
+  EXPECT_GT(decided, 2000 / 4);
+}
 #  endif
 
 #  if DO_PERF_TESTS
@@ -0,0 +1,79 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include "testing/testing.h"
+
+#include "BLI_array.hh"
+#include "BLI_math_matrix.hh"
+#include "BLI_math_rotation.hh"
+#include "BLI_timeit.hh"
+
+namespace blender::tests {
+
+using namespace blender::math;
+
+static constexpr int points_num = 10'000'000;
+static constexpr int iterations_num = 10;
+
+static float4x4 create_transform()
+{
+  return from_loc_rot_scale<float4x4>(
+      {1, 2, 3}, EulerXYZ(0.3f, 0.5f, 0.7f), float3(2, 0.5f, 1.5f));
+}
+
+static Array<float3> create_points()
+{
+  Array<float3> points(points_num);
+  for (const int i : points.index_range()) {
+    points[i] = float3(i % 1000, i % 777, i % 13) * 0.01f;
+  }
+  return points;
+}
+
+TEST(math_matrix_performance, TransformPointsLoop)
+{
+  const float4x4 transform = create_transform();
+  const Array<float3> src = create_points();
+  Array<float3> dst(src.size());
+  SCOPED_TIMER("transform_point loop");
+  for ([[maybe_unused]] const int iteration : IndexRange(iterations_num)) {
+    for (const int i : src.index_range()) {
+      dst[i] = transform_point(transform, src[i]);
+    }
+  }
+}
+
+TEST(math_matrix_performance, TransformPointsBatch)
+{
+  const float4x4 transform = create_transform();
+  const Array<float3> src = create_points();
+  Array<float3> dst(src.size());
+  SCOPED_TIMER("transform_points");
+  for ([[maybe_unused]] const int iteration : IndexRange(iterations_num)) {
+    transform_points(transform, src, dst);
+  }
+}
+
+TEST(math_matrix_performance, TransformDirectionsBatch)
+{
+  const float3x3 transform = float3x3(create_transform());
+  const Array<float3> src = create_points();
+  Array<float3> dst(src.size());
+  SCOPED_TIMER("transform_directions");
+  for ([[maybe_unused]] const int iteration : IndexRange(iterations_num)) {
+    transform_directions(transform, src, dst);
+  }
+}
+
+TEST(math_matrix_performance, TransformMatricesBatch)
+{
+  const float4x4 transform = create_transform();
+  Array<float4x4> matrices(points_num / 4, float4x4::identity());
+  SCOPED_TIMER("transform_matrices");
+  for ([[maybe_unused]] const int iteration : IndexRange(iterations_num)) {
+    transform_matrices(transform, matrices);
+  }
+}
+
+}  // namespace blender::tests
@@ -357,6 +357,25 @@ const blender::ImplicitSharingInfo *BLO_read_shared(
   return shared_data.sharing_info;
 }
 
+/**
+ * Reference the array stored at `*ptr_p` directly in the memory-mapped blend-file instead of
+ * copying it. This only works for large arrays that are stored exactly as they are expected in
+ * memory and whose address in the mapping has the given alignment.
+ *
+ * \return A new user of the sharing info that keeps the mapping alive, `*ptr_p` then points into
+ * the mapping. Otherwise null is returned, `*ptr_p` is unchanged and the data has to be read as
+ * usual. Mapped memory is copy-on-write, so it can be modified once the sharing info is mutable.
+ */
+const blender::ImplicitSharingInfo *BLO_read_mapped(BlendDataReader *reader,
+                                                    const void **ptr_p,
+                                                    size_t size,
+                                                    size_t alignment);
+/**
+ * Whether the data owned by the sharing info was referenced with #BLO_read_mapped. It points into
+ * the memory-mapped blend-file then, so it was not allocated with guardedalloc.
+ */
+bool BLO_read_is_mapped(const blender::ImplicitSharingInfo *sharing_info);
+
 int BLO_read_fileversion_get(BlendDataReader *reader);
 bool BLO_read_requires_endian_switch(BlendDataReader *reader);
 bool BLO_read_data_is_undo(BlendDataReader *reader);
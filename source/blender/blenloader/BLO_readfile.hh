@@ -103,6 +103,12 @@ struct BlendFileReadReport {
   /** Timing information. */
   struct {
     double whole;
+    /** Reading the local data-blocks from the file, including their direct-linking. */
+    double read_data;
+    /** Versioning, both before and after linking. */
+    double versioning;
+    /** Linking ID pointers of all data-blocks, part of #libraries. */
+    double lib_link;
     double libraries;
     double lib_overrides;
     double lib_overrides_resync;
@@ -12,6 +12,7 @@
 #include "BLI_filereader.h"
 #include "BLI_listbase.h"
 #include "BLI_map.hh"
+#include "BLI_vector.hh"
 
 namespace blender {
 class ImplicitSharingInfo;
@@ -33,8 +34,13 @@ struct MemFileChunk {
   const char *buf;
   /** Size in bytes. */
   size_t size;
-  /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
+  /** Hash of the content, used to find chunks with the same content when writing the next step. */
+  uint64_t hash;
+  /** When true, this chunk is identical to the matching chunk in the previous step. */
   bool is_identical;
+  /** When true, this chunk doesn't own the memory, it's shared with another #MemFileChunk of the
+   * same or a previous step. */
+  bool is_shared;
   /** When true, this chunk is also identical to the one in the next step (used by undo code to
    * detect unchanged IDs).
    * Defined when writing the next step (i.e. last undo step has those always false). */
@@ -63,6 +69,32 @@ struct MemFileWriteData {
 
   /** Maps an ID session uid to its first reference MemFileChunk, if existing. */
   blender::Map<uint, MemFileChunk *> id_session_uid_mapping;
+
+  /**
+   * Written data that is not part of a chunk yet, because the end of a chunk depends on data that
+   * is written later. See #BLO_memfile_chunk_add.
+   */
+  blender::Vector<char> pending_data;
+  /** Number of bytes of the chunk that is currently being written. */
+  size_t chunk_len;
+  /**
+   * All bytes of the current chunk are equal to the start of #reference_current_chunk. They are
+   * not copied to #pending_data then, because the reference chunk already contains them.
+   */
+  bool chunk_matches_reference;
+  /** Rolling hash of the data of the chunk that is currently being written. */
+  uint64_t rolling_hash;
+  /**
+   * Make a chunk of every written buffer and only share it with the chunk at the same position in
+   * the reference memfile, like before content defined chunking. Only used for comparison.
+   */
+  bool use_fixed_chunk_boundaries;
+  /**
+   * Chunks of the reference and written memfiles by their content hash, used to share chunks with
+   * the same content regardless of their position. Only created when it is first needed.
+   */
+  blender::Map<uint64_t, const MemFileChunk *> chunk_by_hash;
+  bool chunk_by_hash_is_initialized;
 };
 
 struct MemFileUndoData {
@@ -88,7 +120,17 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
                             MemFile *reference_memfile);
 void BLO_memfile_write_finalize(MemFileWriteData *mem_data);
 
+/**
+ * Add data to the written memfile. The data is split into chunks at positions defined by its
+ * content, so that inserting or removing data only changes the chunks around the modification.
+ * Chunks with the same content as a chunk of the reference memfile share its memory.
+ */
 void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size);
+/**
+ * End the current chunk, so that following data starts a new one. Used to separate unrelated
+ * data, like different IDs, which allows detecting which of them changed.
+ */
+void BLO_memfile_chunk_end(MemFileWriteData *mem_data);
 
 /* exports */
 
@@ -6,6 +6,8 @@
  * \ingroup blenloader
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cctype> /* for isdigit. */
 #include <cerrno>
 #include <climits>
@@ -50,6 +52,7 @@
 #include "MEM_alloc_string_storage.hh"
 #include "MEM_guardedalloc.h"
 
+#include "BLI_array.hh"
 #include "BLI_blenlib.h"
 #include "BLI_endian_defines.h"
 #include "BLI_endian_switch.h"
@@ -58,8 +61,11 @@
 #include "BLI_map.hh"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
+#include "BLI_mmap.h"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
 #include "BLI_time.h"
+#include "BLI_vector.hh"
 
 #include "BLT_translation.hh"
 
@@ -171,6 +177,19 @@
  */
 #define USE_BHEAD_READ_ON_DEMAND
 
+/**
+ * Reference large arrays that need no conversion directly in the memory-mapped file instead of
+ * copying them, see #BLO_read_mapped.
+ *
+ * \note Not used on WIN32, where a mapped file can't be replaced, which would prevent saving over
+ * the file for as long as any of these arrays is in use.
+ */
+#if defined(USE_BHEAD_READ_ON_DEMAND) && !defined(WIN32)
+#  define USE_READ_MAPPED_DATA
+/** Smaller blocks are always copied, referencing them isn't worth keeping pages of the file. */
+#  define READ_MAPPED_DATA_MIN_SIZE (1 << 16)
+#endif
+
 /** Use #GHash for #BHead name-based lookups (speeds up linking). */
 #define USE_GHASH_BHEAD
 
@@ -248,8 +267,20 @@ struct NewAddress {
   int nr;
 };
 
+/** A data block whose reading is postponed until it's first accessed. */
+struct DeferredData {
+  BHead *bhead;
+  const char *allocname;
+  int id_type_index;
+};
+
 struct OldNewMap {
   blender::Map<const void *, NewAddress> map;
+  /**
+   * Data blocks that may be referenced directly in the memory-mapped file (see
+   * #BLO_read_mapped). They are only read into #map when they are accessed otherwise.
+   */
+  blender::Map<const void *, DeferredData> deferred;
 };
 
 static OldNewMap *oldnewmap_new()
@@ -318,6 +349,7 @@ static void oldnewmap_clear(OldNewMap *onm)
     }
   }
   onm->map.clear_and_shrink();
+  onm->deferred.clear_and_shrink();
 }
 
 static void oldnewmap_free(OldNewMap *onm)
@@ -1095,6 +1127,30 @@ static int *read_file_thumbnail(FileData *fd)
 /** \name File Data API
  * \{ */
 
+#ifdef USE_READ_MAPPED_DATA
+/**
+ * Keeps the memory-mapped file alive while an array in it is referenced directly. Every array has
+ * its own sharing info, because other code identifies shared arrays by their sharing info.
+ */
+class MappedArraySharingInfo : public blender::ImplicitSharingInfo {
+ private:
+  BLI_mmap_file *mmap_file_;
+
+ public:
+  MappedArraySharingInfo(BLI_mmap_file *mmap_file) : mmap_file_(mmap_file)
+  {
+    BLI_mmap_add_user(mmap_file_);
+  }
+
+ private:
+  void delete_self_with_data() override
+  {
+    BLI_mmap_free(mmap_file_);
+    MEM_delete(this);
+  }
+};
+#endif
+
 static FileData *filedata_new(BlendFileReadReport *reports)
 {
   BLI_assert(reports != nullptr);
@@ -1205,6 +1261,7 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   char header[7];
   FileReader *rawfile = BLI_filereader_new_file(filedes);
   FileReader *file = nullptr;
+  BLI_mmap_file *mmap_file = nullptr;
 
   errno = 0;
   /* If opening the file failed or we can't read the header, give up. */
@@ -1229,7 +1286,14 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   /* Check if we have a regular file. */
   if (memcmp(header, "BLENDER", sizeof(header)) == 0) {
     /* Try opening the file with memory-mapped IO. */
+#ifdef USE_READ_MAPPED_DATA
+    mmap_file = BLI_mmap_open_copy_on_write(filedes);
+    if (mmap_file != nullptr) {
+      file = BLI_filereader_new_mmap_file(mmap_file);
+    }
+#else
     file = BLI_filereader_new_mmap(filedes);
+#endif
     if (file == nullptr) {
       /* `mmap` failed, so just keep using `rawfile`. */
       file = rawfile;
@@ -1260,6 +1324,9 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   FileData *fd = filedata_new(reports);
   fd->file = file;
+#ifdef USE_READ_MAPPED_DATA
+  fd->mmap_file = mmap_file;
+#endif
 
   return fd;
 }
@@ -1373,6 +1440,10 @@ void blo_filedata_free(FileData *fd)
   }
 #endif
   fd->file->close(fd->file);
+  if (fd->mmap_file) {
+    /* The mapping is only freed here if no read data references it anymore. */
+    BLI_mmap_free(fd->mmap_file);
+  }
 
   if (fd->filesdna) {
     DNA_sdna_free(fd->filesdna);
@@ -1464,14 +1535,33 @@ short BLO_version_from_file(const char *filepath)
  * \{ */
 
 /* Only direct data-blocks. */
+/** Read the data block at the given old address if it was deferred by #read_data_into_datamap. */
+static void datamap_ensure_deferred_read(FileData *fd, const void *adr)
+{
+  OldNewMap *onm = fd->datamap;
+  if (onm->deferred.is_empty()) {
+    return;
+  }
+  const std::optional<DeferredData> deferred = onm->deferred.pop_try(adr);
+  if (!deferred) {
+    return;
+  }
+  void *data = read_struct(fd, deferred->bhead, deferred->allocname, deferred->id_type_index);
+  if (data) {
+    oldnewmap_insert(onm, adr, data, 0);
+  }
+}
+
 static void *newdataadr(FileData *fd, const void *adr)
 {
+  datamap_ensure_deferred_read(fd, adr);
   return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
 }
 
 /* Only direct data-blocks. */
 static void *newdataadr_no_us(FileData *fd, const void *adr)
 {
+  datamap_ensure_deferred_read(fd, adr);
   return oldnewmap_lookup_and_inc(fd->datamap, adr, false);
 }
 
@@ -2475,7 +2565,147 @@ static bool direct_link_id(FileData *fd, Main *main, const int tag, ID *id, ID *
   return success;
 }
 
-/* Read all data associated with a datablock into datamap. */
+#ifdef USE_READ_MAPPED_DATA
+/**
+ * Whether the data of the block is stored in the file exactly as it is expected in memory, so
+ * that it can be referenced in the memory-mapped file directly.
+ */
+static bool read_data_can_be_mapped(const FileData *fd, const BHead *bhead)
+{
+  if (fd->mmap_file == nullptr) {
+    return false;
+  }
+  if (bhead->len < READ_MAPPED_DATA_MIN_SIZE) {
+    return false;
+  }
+  if (BHEADN_FROM_BHEAD(bhead)->has_data) {
+    return false;
+  }
+  if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
+    return false;
+  }
+  if (bhead->SDNAnr != SDNA_RAW_DATA_STRUCT_INDEX &&
+      fd->compflags[bhead->SDNAnr] != SDNA_CMP_EQUAL)
+  {
+    return false;
+  }
+  return true;
+}
+#endif
+
+#ifdef USE_READ_MAPPED_DATA
+/** Data blocks of an ID smaller than this in total are not worth decoding in parallel. */
+#  define READ_DATA_PARALLEL_MIN_SIZE (1 << 18)
+/** Approximate number of bytes decoded by a single task. */
+#  define READ_DATA_PARALLEL_GRAIN_SIZE (1 << 16)
+
+/**
+ * Whether the data blocks can be decoded by #read_struct_decode, which does not use the file
+ * reader and can therefore run on multiple threads at once.
+ */
+static bool read_data_can_be_decoded_in_parallel(const FileData *fd)
+{
+  return fd->mmap_file != nullptr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN) == 0;
+}
+
+/**
+ * Same as #read_struct, but reads the data from the memory-mapped file directly. The allocation
+ * name has to be computed beforehand with #get_alloc_name, which is not thread-safe.
+ *
+ * \return False if the data could not be read from the file.
+ */
+static bool read_struct_decode(const FileData *fd,
+                               const BHead *bh,
+                               const char *alloc_name,
+                               void **r_data)
+{
+  *r_data = nullptr;
+  if (bh->len == 0 || fd->compflags[bh->SDNAnr] == SDNA_CMP_REMOVED) {
+    return true;
+  }
+  const BHeadN *bheadn = BHEADN_FROM_BHEAD(bh);
+  const void *src = bh + 1;
+  if (!bheadn->has_data) {
+    if (size_t(bheadn->file_offset) + size_t(bh->len) > BLI_mmap_get_length(fd->mmap_file)) {
+      return false;
+    }
+    src = POINTER_OFFSET(BLI_mmap_get_pointer(fd->mmap_file), bheadn->file_offset);
+  }
+
+  if (fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+    *r_data = DNA_struct_reconstruct(fd->reconstruct_info, bh->SDNAnr, bh->nr, src, alloc_name);
+    return true;
+  }
+
+  /* SDNA_CMP_EQUAL */
+  const int alignment = DNA_struct_alignment(fd->filesdna, bh->SDNAnr);
+  void *data = MEM_mallocN_aligned(bh->len, alignment, alloc_name);
+  if (bheadn->has_data) {
+    memcpy(data, src, bh->len);
+  }
+  else if (!BLI_mmap_read(fd->mmap_file, data, bheadn->file_offset, bh->len)) {
+    MEM_freeN(data);
+    return false;
+  }
+  *r_data = data;
+  return true;
+}
+
+/**
+ * Decode the given data blocks of one ID. All blocks are independent from each other, so when
+ * there is enough data, they are decoded in parallel. The results are in the same order as the
+ * blocks.
+ */
+static void read_data_decode_blocks(FileData *fd,
+                                    const blender::Span<BHead *> bheads,
+                                    const blender::Span<const char *> alloc_names,
+                                    const int64_t total_size,
+                                    blender::MutableSpan<void *> r_data)
+{
+  using namespace blender;
+  std::atomic<bool> read_failed = false;
+  const auto decode_range = [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      if (!read_struct_decode(fd, bheads[i], alloc_names[i], &r_data[i])) {
+        read_failed = true;
+      }
+    }
+  };
+
+  if (bheads.size() < 2 || total_size < READ_DATA_PARALLEL_MIN_SIZE) {
+    decode_range(bheads.index_range());
+  }
+  else {
+    const int64_t grain_size = std::clamp<int64_t>(
+        bheads.size() * READ_DATA_PARALLEL_GRAIN_SIZE / total_size, 1, bheads.size());
+    threading::parallel_for(bheads.index_range(), grain_size, decode_range);
+  }
+
+  if (read_failed) {
+    fd->flags &= ~FD_FLAGS_FILE_OK;
+  }
+}
+#endif
+
+static void read_data_insert_into_datamap(FileData *fd, const BHead *bhead, void *data)
+{
+  if (data) {
+    const bool is_new = oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+    if (!is_new) {
+      CLOG_ERROR(&LOG,
+                 "Blendfile corruption: Invalid, or multiple `bhead` with same old address "
+                 "value (%p) for a given ID.",
+                 bhead->old);
+    }
+  }
+}
+
+/**
+ * Read all data associated with a datablock into datamap.
+ *
+ * When the file is memory-mapped, the data blocks of the ID are scanned first and then decoded
+ * in parallel, see #read_data_decode_blocks.
+ */
 static BHead *read_data_into_datamap(FileData *fd,
                                      BHead *bhead,
                                      const char *allocname,
@@ -2483,21 +2713,52 @@ static BHead *read_data_into_datamap(FileData *fd,
 {
   bhead = blo_bhead_next(fd, bhead);
 
+#ifdef USE_READ_MAPPED_DATA
+  const bool decode_in_parallel = read_data_can_be_decoded_in_parallel(fd);
+  blender::Vector<BHead *, 32> decode_bheads;
+  blender::Vector<const char *, 32> decode_alloc_names;
+  int64_t decode_size = 0;
+#endif
+
   while (bhead && bhead->code == BLO_CODE_DATA) {
-    void *data = read_struct(fd, bhead, allocname, id_type_index);
-    if (data) {
-      const bool is_new = oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+#ifdef USE_READ_MAPPED_DATA
+    if (read_data_can_be_mapped(fd, bhead)) {
+      const bool is_new = fd->datamap->deferred.add(bhead->old,
+                                                    {bhead, allocname, id_type_index});
       if (!is_new) {
         CLOG_ERROR(&LOG,
                    "Blendfile corruption: Invalid, or multiple `bhead` with same old address "
                    "value (%p) for a given ID.",
                    bhead->old);
       }
+      bhead = blo_bhead_next(fd, bhead);
+      continue;
+    }
+    if (decode_in_parallel) {
+      decode_bheads.append(bhead);
+      decode_alloc_names.append(bhead->len ? get_alloc_name(fd, bhead, allocname, id_type_index) :
+                                             nullptr);
+      decode_size += bhead->len;
+      bhead = blo_bhead_next(fd, bhead);
+      continue;
     }
+#endif
+    void *data = read_struct(fd, bhead, allocname, id_type_index);
+    read_data_insert_into_datamap(fd, bhead, data);
 
     bhead = blo_bhead_next(fd, bhead);
   }
 
+#ifdef USE_READ_MAPPED_DATA
+  if (!decode_bheads.is_empty()) {
+    blender::Array<void *, 32> decoded_data(decode_bheads.size());
+    read_data_decode_blocks(fd, decode_bheads, decode_alloc_names, decode_size, decoded_data);
+    for (const int64_t i : decode_bheads.index_range()) {
+      read_data_insert_into_datamap(fd, decode_bheads[i], decoded_data[i]);
+    }
+  }
+#endif
+
   return bhead;
 }
 
@@ -3592,6 +3853,8 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     read_undo_reuse_noundo_local_ids(fd);
   }
 
+  fd->reports->duration.read_data = BLI_time_now_seconds();
+
   while (bhead) {
     switch (bhead->code) {
       case BLO_CODE_DATA:
@@ -3656,6 +3919,8 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     }
   }
 
+  fd->reports->duration.read_data = BLI_time_now_seconds() - fd->reports->duration.read_data;
+
   if (is_undo) {
     /* Move the remaining Library IDs and their linked data to the new main.
      *
@@ -3681,6 +3946,7 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 
   /* Do versioning before read_libraries, but skip in undo case. */
   if (!is_undo) {
+    const double versioning_start = BLI_time_now_seconds();
     if ((fd->skip_flags & BLO_READ_SKIP_DATA) == 0) {
       do_versions(fd, nullptr, bfd->main);
     }
@@ -3688,6 +3954,7 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     if ((fd->skip_flags & BLO_READ_SKIP_USERDEF) == 0) {
       do_versions_userdef(fd, bfd);
     }
+    fd->reports->duration.versioning = BLI_time_now_seconds() - versioning_start;
   }
 
   if (bfd->main->is_read_invalid) {
@@ -3700,8 +3967,10 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 
     blo_join_main(&mainlist);
 
+    const double lib_link_start = BLI_time_now_seconds();
     lib_link_all(fd, bfd->main);
     after_liblink_merged_bmain_process(bfd->main, fd->reports);
+    fd->reports->duration.lib_link = BLI_time_now_seconds() - lib_link_start;
 
     if (is_undo) {
       /* Ensure ID usages of reused 'no undo' IDs remain valid. */
@@ -3727,6 +3996,7 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
       BKE_layer_collection_resync_allow();
 
       /* Yep, second splitting... but this is a very cheap operation, so no big deal. */
+      const double versioning_start = BLI_time_now_seconds();
       blo_split_main(&mainlist, bfd->main);
       LISTBASE_FOREACH (Main *, mainvar, &mainlist) {
         /* Do versioning for newly added linked data-blocks. If no data-blocks were read from a
@@ -3740,6 +4010,7 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
                                   mainvar);
       }
       blo_join_main(&mainlist);
+      fd->reports->duration.versioning += BLI_time_now_seconds() - versioning_start;
 
       BKE_layer_collection_resync_forbid();
 
@@ -5132,6 +5403,49 @@ blender::ImplicitSharingInfoAndData blo_read_shared_impl(
   return shared_data;
 }
 
+const blender::ImplicitSharingInfo *BLO_read_mapped(BlendDataReader *reader,
+                                                    const void **ptr_p,
+                                                    const size_t size,
+                                                    const size_t alignment)
+{
+#ifdef USE_READ_MAPPED_DATA
+  FileData *fd = reader->fd;
+  if (fd->mmap_file == nullptr) {
+    return nullptr;
+  }
+  const DeferredData *deferred = fd->datamap->deferred.lookup_ptr(*ptr_p);
+  if (deferred == nullptr) {
+    return nullptr;
+  }
+  const BHeadN *bhead = BHEADN_FROM_BHEAD(deferred->bhead);
+  if (size_t(bhead->bhead.len) != size ||
+      size_t(bhead->file_offset) + size > BLI_mmap_get_length(fd->mmap_file))
+  {
+    return nullptr;
+  }
+  const void *data = POINTER_OFFSET(BLI_mmap_get_pointer(fd->mmap_file), bhead->file_offset);
+  if (uintptr_t(data) % alignment != 0) {
+    return nullptr;
+  }
+  fd->datamap->deferred.remove(*ptr_p);
+  *ptr_p = data;
+  return MEM_new<MappedArraySharingInfo>(__func__, fd->mmap_file);
+#else
+  UNUSED_VARS(reader, ptr_p, size, alignment);
+  return nullptr;
+#endif
+}
+
+bool BLO_read_is_mapped(const blender::ImplicitSharingInfo *sharing_info)
+{
+#ifdef USE_READ_MAPPED_DATA
+  return dynamic_cast<const MappedArraySharingInfo *>(sharing_info) != nullptr;
+#else
+  UNUSED_VARS(sharing_info);
+  return false;
+#endif
+}
+
 bool BLO_read_data_is_undo(BlendDataReader *reader)
 {
   return (reader->fd->flags & FD_FLAGS_IS_MEMFILE);
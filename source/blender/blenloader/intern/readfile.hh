@@ -22,6 +22,7 @@
 
 #include "BLO_readfile.hh"
 
+struct BLI_mmap_file;
 struct BlendFileData;
 struct BlendfileLinkAppendContext;
 struct BlendFileReadParams;
@@ -69,6 +70,12 @@ struct FileData {
   bool is_eof;
 
   FileReader *file;
+  /**
+   * Set when the file is read through a copy-on-write memory mapping, which allows referencing
+   * large arrays in it directly (see #BLO_read_mapped). The #FileData and every array referenced
+   * in the mapping are users of it, it is freed once none of them uses it anymore.
+   */
+  BLI_mmap_file *mmap_file;
 
   /** Whether we are undoing (< 0) or redoing (> 0), used to choose which 'unchanged' flag to use
    * to detect unchanged data from memfile. */
@@ -6,6 +6,7 @@
  * \ingroup blenloader
  */
 
+#include <array>
 #include <cerrno>
 #include <cmath>
 #include <cstdio>
@@ -20,6 +21,8 @@
 #  include <io.h>
 #endif
 
+#include <xxhash.h>
+
 #include "MEM_guardedalloc.h"
 
 #include "DNA_listBase.h"
@@ -41,7 +44,7 @@
 void BLO_memfile_free(MemFile *memfile)
 {
   while (MemFileChunk *chunk = static_cast<MemFileChunk *>(BLI_pophead(&memfile->chunks))) {
-    if (chunk->is_identical == false) {
+    if (chunk->is_shared == false) {
       MEM_freeN((void *)chunk->buf);
     }
     MEM_freeN(chunk);
@@ -67,7 +70,7 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
 
   /* First, detect all memchunks in second memfile that are not owned by it. */
   LISTBASE_FOREACH (MemFileChunk *, sc, &second->chunks) {
-    if (sc->is_identical) {
+    if (sc->is_shared) {
       buffer_to_second_memchunk.add(sc->buf, sc);
     }
   }
@@ -75,11 +78,11 @@ void BLO_memfile_merge(MemFile *first, MemFile *second)
   /* Now, check all chunks from first memfile (the one we are removing), and if a memchunk owned by
    * it is also used by the second memfile, transfer the ownership. */
   LISTBASE_FOREACH (MemFileChunk *, fc, &first->chunks) {
-    if (!fc->is_identical) {
+    if (!fc->is_shared) {
       if (MemFileChunk *sc = buffer_to_second_memchunk.lookup_default(fc->buf, nullptr)) {
-        BLI_assert(sc->is_identical);
-        sc->is_identical = false;
-        fc->is_identical = true;
+        BLI_assert(sc->is_shared);
+        sc->is_shared = false;
+        fc->is_shared = true;
       }
       /* Note that if the second memfile does not use that chunk, we assume that the first one
        * fully owns it without sharing it with any other memfile, and hence it should be freed with
@@ -97,6 +100,120 @@ void BLO_memfile_clear_future(MemFile *memfile)
   }
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Content Defined Chunking
+ *
+ * Written data is split into chunks at positions where a rolling hash of the last bytes matches a
+ * pattern, instead of at fixed offsets. Inserting or removing data then only changes the chunks
+ * around the modification, while the following chunks keep their content and can still be shared
+ * with the previous undo step. The rolling hash is a "gear" hash, where every byte shifts the hash
+ * by one bit, so that it only depends on the last 64 bytes.
+ * \{ */
+
+/** Chunks are not ended before this size, to limit the per-chunk overhead. */
+static constexpr size_t MEMFILE_CHUNK_MIN_SIZE = 4 * 1024;
+/** Chunks are always ended at this size, even when no boundary is found in the content. */
+static constexpr size_t MEMFILE_CHUNK_MAX_SIZE = 64 * 1024;
+/** Number of hash bits that have to be zero at a boundary, chunks are 16 KB larger than the
+ * minimum size on average. */
+static constexpr int MEMFILE_CHUNK_BOUNDARY_BITS = 14;
+/** Number of bytes that affect the rolling hash. */
+static constexpr size_t MEMFILE_CHUNK_HASH_WINDOW = 64;
+
+static const std::array<uint64_t, 256> &gear_table()
+{
+  /* The table only has to contain well distributed values, but must be the same for all steps. */
+  static const std::array<uint64_t, 256> table = []() {
+    std::array<uint64_t, 256> values;
+    uint64_t state = 0;
+    for (uint64_t &value : values) {
+      /* SplitMix64. */
+      state += 0x9e3779b97f4a7c15;
+      uint64_t z = state;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+      value = z ^ (z >> 31);
+    }
+    return values;
+  }();
+  return table;
+}
+
+/**
+ * Find the end of the chunk that already contains \a chunk_len bytes and continues with \a data.
+ * The rolling hash is updated so that the search can continue with the data that follows.
+ *
+ * \return The number of bytes of \a data that are part of the chunk, or zero when the chunk does
+ * not end within \a data.
+ */
+static size_t memfile_chunk_boundary_find(uint64_t &rolling_hash,
+                                          const size_t chunk_len,
+                                          const char *data,
+                                          const size_t size)
+{
+  const std::array<uint64_t, 256> &gear = gear_table();
+  const size_t max_len = std::min(size, MEMFILE_CHUNK_MAX_SIZE - chunk_len);
+  /* Bytes that are shifted out of the hash before the minimum size is reached are skipped. */
+  size_t i = 0;
+  if (chunk_len < MEMFILE_CHUNK_MIN_SIZE - MEMFILE_CHUNK_HASH_WINDOW) {
+    i = MEMFILE_CHUNK_MIN_SIZE - MEMFILE_CHUNK_HASH_WINDOW - chunk_len;
+  }
+  uint64_t hash = rolling_hash;
+  for (; i < max_len; i++) {
+    hash = (hash << 1) + gear[uchar(data[i])];
+    /* Use the high bits, the low bits only depend on the last few bytes. */
+    if ((hash >> (64 - MEMFILE_CHUNK_BOUNDARY_BITS)) == 0 &&
+        chunk_len + i + 1 >= MEMFILE_CHUNK_MIN_SIZE)
+    {
+      rolling_hash = 0;
+      return i + 1;
+    }
+  }
+  if (chunk_len + max_len == MEMFILE_CHUNK_MAX_SIZE) {
+    rolling_hash = 0;
+    return max_len;
+  }
+  rolling_hash = hash;
+  return 0;
+}
+
+/**
+ * Compute the rolling hash after the first \a chunk_len bytes of a chunk, the same as
+ * #memfile_chunk_boundary_find does. Only the last #MEMFILE_CHUNK_HASH_WINDOW bytes are needed.
+ */
+static uint64_t memfile_chunk_rolling_hash(const char *chunk_data, const size_t chunk_len)
+{
+  const std::array<uint64_t, 256> &gear = gear_table();
+  size_t start = MEMFILE_CHUNK_MIN_SIZE - MEMFILE_CHUNK_HASH_WINDOW;
+  if (chunk_len > MEMFILE_CHUNK_HASH_WINDOW) {
+    start = std::max(start, chunk_len - MEMFILE_CHUNK_HASH_WINDOW);
+  }
+  uint64_t hash = 0;
+  for (size_t i = start; i < chunk_len; i++) {
+    hash = (hash << 1) + gear[uchar(chunk_data[i])];
+  }
+  return hash;
+}
+
+/** Whether a chunk with the given content ends at its last byte, even when more data follows. */
+static bool memfile_chunk_ends_with_boundary(const char *chunk_data, const size_t chunk_len)
+{
+  if (chunk_len >= MEMFILE_CHUNK_MAX_SIZE) {
+    return true;
+  }
+  if (chunk_len < MEMFILE_CHUNK_MIN_SIZE) {
+    return false;
+  }
+  const uint64_t hash = memfile_chunk_rolling_hash(chunk_data, chunk_len);
+  return (hash >> (64 - MEMFILE_CHUNK_BOUNDARY_BITS)) == 0;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Writing
+ * \{ */
+
 void BLO_memfile_write_init(MemFileWriteData *mem_data,
                             MemFile *written_memfile,
                             MemFile *reference_memfile)
@@ -106,6 +223,13 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
   mem_data->reference_current_chunk = reference_memfile ? static_cast<MemFileChunk *>(
                                                               reference_memfile->chunks.first) :
                                                           nullptr;
+  mem_data->pending_data.clear();
+  mem_data->chunk_len = 0;
+  mem_data->chunk_matches_reference = false;
+  mem_data->rolling_hash = 0;
+  mem_data->use_fixed_chunk_boundaries = false;
+  mem_data->chunk_by_hash.clear();
+  mem_data->chunk_by_hash_is_initialized = false;
 
   /* If we have a reference memfile, we generate a mapping between the session_uid's of the
    * IDs stored in that previous undo step, and its first matching memchunk. This will allow
@@ -125,10 +249,42 @@ void BLO_memfile_write_init(MemFileWriteData *mem_data,
 
 void BLO_memfile_write_finalize(MemFileWriteData *mem_data)
 {
+  BLO_memfile_chunk_end(mem_data);
   mem_data->id_session_uid_mapping.clear_and_shrink();
+  mem_data->pending_data.clear_and_shrink();
+  mem_data->chunk_by_hash.clear_and_shrink();
+  mem_data->chunk_by_hash_is_initialized = false;
 }
 
-void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size)
+/**
+ * Find a chunk with the given content in the reference memfile, or in the chunks written so far.
+ * Only needed when the chunk at the same position in the reference memfile differs, so the mapping
+ * is only created then.
+ */
+static const MemFileChunk *memfile_chunk_find_by_content(MemFileWriteData *mem_data,
+                                                         const char *buf,
+                                                         const size_t size,
+                                                         const uint64_t hash)
+{
+  if (!mem_data->chunk_by_hash_is_initialized) {
+    mem_data->chunk_by_hash_is_initialized = true;
+    if (mem_data->reference_memfile != nullptr) {
+      LISTBASE_FOREACH (const MemFileChunk *, chunk, &mem_data->reference_memfile->chunks) {
+        mem_data->chunk_by_hash.add(chunk->hash, chunk);
+      }
+    }
+    LISTBASE_FOREACH (const MemFileChunk *, chunk, &mem_data->written_memfile->chunks) {
+      mem_data->chunk_by_hash.add(chunk->hash, chunk);
+    }
+  }
+  const MemFileChunk *chunk = mem_data->chunk_by_hash.lookup_default(hash, nullptr);
+  if (chunk == nullptr || chunk->size != size || memcmp(chunk->buf, buf, size) != 0) {
+    return nullptr;
+  }
+  return chunk;
+}
+
+static void memfile_chunk_write(MemFileWriteData *mem_data, const char *buf, const size_t size)
 {
   MemFile *memfile = mem_data->written_memfile;
   MemFileChunk **compchunk_step = &mem_data->reference_current_chunk;
@@ -137,36 +293,142 @@ void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t s
       MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk"));
   curchunk->size = size;
   curchunk->buf = nullptr;
+  curchunk->hash = 0;
   curchunk->is_identical = false;
+  curchunk->is_shared = false;
   /* This is unsafe in the sense that an app handler or other code that does not
    * perform an undo push may make changes after the last undo push that
    * will then not be undo. Though it's not entirely clear that is wrong behavior. */
   curchunk->is_identical_future = true;
   curchunk->id_session_uid = mem_data->current_id_session_uid;
-  BLI_addtail(&memfile->chunks, curchunk);
 
   /* we compare compchunk with buf */
   if (*compchunk_step != nullptr) {
     MemFileChunk *compchunk = *compchunk_step;
     if (compchunk->size == curchunk->size) {
-      if (memcmp(compchunk->buf, buf, size) == 0) {
+      if (compchunk->buf == buf || memcmp(compchunk->buf, buf, size) == 0) {
         curchunk->buf = compchunk->buf;
+        curchunk->hash = compchunk->hash;
         curchunk->is_identical = true;
+        curchunk->is_shared = true;
         compchunk->is_identical_future = true;
       }
     }
     *compchunk_step = static_cast<MemFileChunk *>(compchunk->next);
   }
 
+  /* Not equal to the chunk at the same position, but the same content may still exist elsewhere,
+   * e.g. when data was inserted before it. */
+  if (curchunk->buf == nullptr && !mem_data->use_fixed_chunk_boundaries) {
+    curchunk->hash = XXH3_64bits(buf, size);
+    if (const MemFileChunk *chunk = memfile_chunk_find_by_content(
+            mem_data, buf, size, curchunk->hash))
+    {
+      curchunk->buf = chunk->buf;
+      curchunk->is_shared = true;
+    }
+  }
+
   /* not equal... */
   if (curchunk->buf == nullptr) {
     char *buf_new = static_cast<char *>(MEM_mallocN(size, "Chunk buffer"));
     memcpy(buf_new, buf, size);
     curchunk->buf = buf_new;
     memfile->size += size;
+    if (mem_data->chunk_by_hash_is_initialized) {
+      mem_data->chunk_by_hash.add(curchunk->hash, curchunk);
+    }
   }
+
+  BLI_addtail(&memfile->chunks, curchunk);
 }
 
+void BLO_memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, size_t size)
+{
+  if (mem_data->use_fixed_chunk_boundaries) {
+    memfile_chunk_write(mem_data, buf, size);
+    return;
+  }
+  blender::Vector<char> &pending_data = mem_data->pending_data;
+  while (size > 0) {
+    if (mem_data->chunk_len == 0) {
+      /* The reference chunk is only known when the chunk starts, since writing an ID may change
+       * it after the previous chunk was ended. */
+      mem_data->chunk_matches_reference = mem_data->reference_current_chunk != nullptr;
+    }
+    if (mem_data->chunk_matches_reference) {
+      /* Most data is unchanged since the previous undo step. As long as it is equal to the
+       * reference chunk, it is only compared, without copying or hashing it. Since chunk
+       * boundaries only depend on the content, the chunk ends where the reference chunk ends. */
+      const MemFileChunk *ref = mem_data->reference_current_chunk;
+      const size_t len = std::min(size, ref->size - mem_data->chunk_len);
+      if (memcmp(ref->buf + mem_data->chunk_len, buf, len) == 0) {
+        mem_data->chunk_len += len;
+        buf += len;
+        size -= len;
+        if (mem_data->chunk_len == ref->size &&
+            memfile_chunk_ends_with_boundary(ref->buf, ref->size))
+        {
+          memfile_chunk_write(mem_data, ref->buf, ref->size);
+          mem_data->chunk_len = 0;
+          continue;
+        }
+        if (size == 0) {
+          /* The chunk may still be ended by #BLO_memfile_chunk_end. */
+          return;
+        }
+      }
+      /* The data differs from the reference chunk, continue with the equal part. */
+      pending_data.extend(ref->buf, int64_t(mem_data->chunk_len));
+      mem_data->rolling_hash = memfile_chunk_rolling_hash(ref->buf, mem_data->chunk_len);
+      mem_data->chunk_matches_reference = false;
+    }
+
+    const size_t chunk_size = memfile_chunk_boundary_find(
+        mem_data->rolling_hash, mem_data->chunk_len, buf, size);
+    if (chunk_size == 0) {
+      pending_data.extend(buf, int64_t(size));
+      mem_data->chunk_len += size;
+      return;
+    }
+    if (pending_data.is_empty()) {
+      /* Avoid copying data that doesn't have to be kept for the next call. */
+      memfile_chunk_write(mem_data, buf, chunk_size);
+    }
+    else {
+      pending_data.extend(buf, int64_t(chunk_size));
+      memfile_chunk_write(mem_data, pending_data.data(), size_t(pending_data.size()));
+      pending_data.clear();
+    }
+    mem_data->chunk_len = 0;
+    buf += chunk_size;
+    size -= chunk_size;
+  }
+}
+
+void BLO_memfile_chunk_end(MemFileWriteData *mem_data)
+{
+  if (mem_data->chunk_matches_reference && mem_data->chunk_len > 0) {
+    const MemFileChunk *ref = mem_data->reference_current_chunk;
+    if (mem_data->chunk_len == ref->size) {
+      memfile_chunk_write(mem_data, ref->buf, ref->size);
+    }
+    else {
+      mem_data->pending_data.extend(ref->buf, int64_t(mem_data->chunk_len));
+    }
+  }
+  if (!mem_data->pending_data.is_empty()) {
+    memfile_chunk_write(
+        mem_data, mem_data->pending_data.data(), size_t(mem_data->pending_data.size()));
+    mem_data->pending_data.clear();
+  }
+  mem_data->chunk_len = 0;
+  mem_data->chunk_matches_reference = false;
+  mem_data->rolling_hash = 0;
+}
+
+/** \} */
+
 Main *BLO_memfile_main_get(MemFile *memfile, Main *bmain, Scene **r_scene)
 {
   Main *bmain_undo = nullptr;
@@ -532,6 +532,9 @@ static void mywrite_flush(WriteData *wd)
     writedata_do_write(wd, wd->buffer.buf, wd->buffer.used_len);
     wd->buffer.used_len = 0;
   }
+  if (wd->use_memfile) {
+    BLO_memfile_chunk_end(&wd->mem);
+  }
 }
 
 /**
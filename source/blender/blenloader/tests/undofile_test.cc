@@ -0,0 +1,247 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "BLI_listbase.h"
+#include "BLI_rand.hh"
+#include "BLI_set.hh"
+#include "BLI_timeit.hh"
+#include "BLI_vector.hh"
+
+#include "BLO_undofile.hh"
+
+namespace blender::blenloader::tests {
+
+static Vector<char> random_data(const int64_t size, const uint32_t seed)
+{
+  RandomNumberGenerator rng(seed);
+  Vector<char> data(size);
+  for (char &value : data) {
+    /* The high bits have a longer period. */
+    value = char(rng.get_uint32() >> 24);
+  }
+  return data;
+}
+
+static void write_memfile(MemFile &memfile,
+                          MemFile *reference,
+                          const Span<char> data,
+                          const bool use_fixed_chunk_boundaries = false)
+{
+  MemFileWriteData mem_data{};
+  BLO_memfile_write_init(&mem_data, &memfile, reference);
+  mem_data.use_fixed_chunk_boundaries = use_fixed_chunk_boundaries;
+  /* Write in pieces of varying size, like the buffered writing of blend-file data. */
+  int64_t offset = 0;
+  int64_t piece_size = 1;
+  while (offset < data.size()) {
+    const int64_t size = std::min(piece_size, data.size() - offset);
+    BLO_memfile_chunk_add(&mem_data, data.data() + offset, size_t(size));
+    offset += size;
+    piece_size = (piece_size * 7) % 40000 + 1;
+  }
+  BLO_memfile_write_finalize(&mem_data);
+}
+
+static Vector<char> memfile_content(const MemFile &memfile)
+{
+  Vector<char> content;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile.chunks) {
+    content.extend(chunk->buf, int64_t(chunk->size));
+  }
+  return content;
+}
+
+TEST(undofile, ChunkSizes)
+{
+  const Vector<char> data = random_data(1024 * 1024, 0);
+  MemFile memfile{};
+  write_memfile(memfile, nullptr, data);
+
+  EXPECT_EQ(memfile_content(memfile).as_span(), data.as_span());
+  EXPECT_EQ(memfile.size, data.size());
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile.chunks) {
+    EXPECT_LE(chunk->size, 64 * 1024);
+    if (chunk->next != nullptr) {
+      EXPECT_GE(chunk->size, 4 * 1024);
+    }
+    EXPECT_FALSE(chunk->is_identical);
+    EXPECT_FALSE(chunk->is_shared);
+  }
+  BLO_memfile_free(&memfile);
+}
+
+TEST(undofile, Unchanged)
+{
+  const Vector<char> data = random_data(1024 * 1024, 0);
+  MemFile first{};
+  write_memfile(first, nullptr, data);
+  MemFile second{};
+  write_memfile(second, &first, data);
+
+  EXPECT_EQ(memfile_content(second).as_span(), data.as_span());
+  EXPECT_EQ(second.size, 0);
+  EXPECT_EQ(BLI_listbase_count(&first.chunks), BLI_listbase_count(&second.chunks));
+  const MemFileChunk *first_chunk = static_cast<const MemFileChunk *>(first.chunks.first);
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &second.chunks) {
+    EXPECT_EQ(chunk->buf, first_chunk->buf);
+    EXPECT_TRUE(chunk->is_identical);
+    EXPECT_TRUE(chunk->is_shared);
+    first_chunk = static_cast<const MemFileChunk *>(first_chunk->next);
+  }
+  BLO_memfile_free(&second);
+  BLO_memfile_free(&first);
+}
+
+TEST(undofile, Insertion)
+{
+  const Vector<char> data = random_data(1024 * 1024, 0);
+  MemFile first{};
+  write_memfile(first, nullptr, data);
+
+  /* Data inserted near the beginning shifts all following data. */
+  Vector<char> modified_data = data;
+  const Vector<char> inserted_data = random_data(100, 1);
+  modified_data.insert(10000, inserted_data.as_span());
+  MemFile second{};
+  write_memfile(second, &first, modified_data);
+
+  EXPECT_EQ(memfile_content(second).as_span(), modified_data.as_span());
+  /* Only the chunks around the insertion are stored again. */
+  EXPECT_LE(second.size, 2 * 64 * 1024);
+  int shared_chunks_num = 0;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &second.chunks) {
+    shared_chunks_num += chunk->is_shared;
+  }
+  EXPECT_GE(shared_chunks_num, BLI_listbase_count(&second.chunks) - 2);
+
+  BLO_memfile_free(&second);
+  BLO_memfile_free(&first);
+}
+
+static Vector<size_t> memfile_chunk_sizes(const MemFile &memfile)
+{
+  Vector<size_t> sizes;
+  LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile.chunks) {
+    sizes.append(chunk->size);
+  }
+  return sizes;
+}
+
+TEST(undofile, ChunkEndsIndependentOfReference)
+{
+  /* Every ID ends a chunk, like #BLO_memfile_chunk_end does in the blend-file writer. */
+  const auto write_ids = [](MemFile &memfile, MemFile *reference, const Span<Vector<char>> ids) {
+    MemFileWriteData mem_data{};
+    BLO_memfile_write_init(&mem_data, &memfile, reference);
+    for (const Vector<char> &id : ids) {
+      BLO_memfile_chunk_add(&mem_data, id.data(), size_t(id.size()));
+      BLO_memfile_chunk_end(&mem_data);
+    }
+    BLO_memfile_write_finalize(&mem_data);
+  };
+  Vector<Vector<char>> ids = {random_data(300, 0),
+                              random_data(100000, 1),
+                              random_data(2000, 2),
+                              random_data(70000, 3),
+                              random_data(50, 4)};
+  MemFile first{};
+  write_ids(first, nullptr, ids);
+
+  /* IDs that become smaller or larger end chunks at different positions than before. */
+  ids[1].resize(60000);
+  ids[2].extend(random_data(30000, 5).as_span());
+  ids[3][40000]++;
+  MemFile second{};
+  write_ids(second, &first, ids);
+  MemFile second_without_reference{};
+  write_ids(second_without_reference, nullptr, ids);
+
+  EXPECT_EQ(memfile_content(second).as_span(),
+            memfile_content(second_without_reference).as_span());
+  EXPECT_EQ(memfile_chunk_sizes(second).as_span(),
+            memfile_chunk_sizes(second_without_reference).as_span());
+  EXPECT_LT(second.size, second_without_reference.size);
+
+  BLO_memfile_free(&second_without_reference);
+  BLO_memfile_free(&second);
+  BLO_memfile_free(&first);
+}
+
+TEST(undofile, Merge)
+{
+  const Vector<char> data = random_data(512 * 1024, 0);
+  Vector<char> modified_data = data;
+  modified_data.remove(200000, 5000);
+  MemFile first{};
+  write_memfile(first, nullptr, data);
+  MemFile second{};
+  write_memfile(second, &first, modified_data);
+  MemFile third{};
+  write_memfile(third, &second, data);
+
+  /* Removing the first step transfers ownership of the buffers still used by the second. */
+  BLO_memfile_merge(&first, &second);
+
+  Set<const char *> owned_buffers;
+  for (const MemFile *memfile : {&second, &third}) {
+    LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile->chunks) {
+      if (!chunk->is_shared) {
+        EXPECT_TRUE(owned_buffers.add(chunk->buf));
+      }
+    }
+  }
+  for (const MemFile *memfile : {&second, &third}) {
+    LISTBASE_FOREACH (const MemFileChunk *, chunk, &memfile->chunks) {
+      EXPECT_TRUE(owned_buffers.contains(chunk->buf));
+    }
+  }
+  EXPECT_EQ(memfile_content(second).as_span(), modified_data.as_span());
+  EXPECT_EQ(memfile_content(third).as_span(), data.as_span());
+
+  BLO_memfile_merge(&second, &third);
+  EXPECT_EQ(memfile_content(third).as_span(), data.as_span());
+  BLO_memfile_free(&third);
+}
+
+/* Disable benchmark by default. */
+#if 0
+static void benchmark_edit_session(const bool use_fixed_chunk_boundaries)
+{
+  Vector<char> data = random_data(64 * 1024 * 1024, 0);
+  RandomNumberGenerator rng(1);
+  Vector<MemFile> memfiles(20, MemFile{});
+  size_t total_size = 0;
+  {
+    SCOPED_TIMER(use_fixed_chunk_boundaries ? "write undo steps (fixed boundaries)" :
+                                              "write undo steps (content defined)");
+    for (const int i : memfiles.index_range()) {
+      /* Every step changes a few bytes somewhere and sometimes inserts data. */
+      const int64_t offset = rng.get_int32(int(data.size()));
+      data[offset]++;
+      if (i % 2 == 0) {
+        data.insert(offset, random_data(rng.get_int32(1000), i).as_span());
+      }
+      write_memfile(memfiles[i],
+                    i == 0 ? nullptr : &memfiles[i - 1],
+                    data,
+                    use_fixed_chunk_boundaries);
+      total_size += memfiles[i].size;
+    }
+  }
+  std::cout << "Undo memory: " << total_size / (1024 * 1024) << " MB\n";
+  for (MemFile &memfile : memfiles) {
+    BLO_memfile_free(&memfile);
+  }
+}
+
+TEST(undofile, BenchmarkEditSession)
+{
+  benchmark_edit_session(true);
+  benchmark_edit_session(false);
+}
+#endif
+
+}  // namespace blender::blenloader::tests
@@ -6,6 +6,8 @@
  * \ingroup bmesh
  */
 
+#include <algorithm>
+
 #include "MEM_guardedalloc.h"
 
 #include "BLI_math_geom.h"
@@ -26,7 +28,6 @@
 
 #define KDOP_TREE_TYPE 4
 #define KDOP_AXIS_LEN 14
-#define BLI_STACK_PAIR_LEN (2 * KDOP_TREE_TYPE)
 
 /* -------------------------------------------------------------------- */
 /** \name Weld Linked Wire Edges into Linked Faces
@@ -197,6 +198,13 @@ struct EDBMSplitElem {
 /* -------------------------------------------------------------------- */
 /* Overlap Callbacks */
 
+/** A pair found by the overlap callbacks, with the BVH indices it was found for. */
+struct EDBMSplitPair {
+  EDBMSplitElem elem[2];
+  int index_a;
+  int index_b;
+};
+
 struct EDBMSplitData {
   BMesh *bm;
   BLI_Stack **pair_stack;
@@ -286,10 +294,12 @@ static bool bm_vertxvert_isect_cb(void *userdata, int index_a, int index_b, int
   BMVert *v_a = BM_vert_at_index(data->bm, index_a);
   BMVert *v_b = BM_vert_at_index(data->bm, index_b);
 
-  EDBMSplitElem *pair = static_cast<EDBMSplitElem *>(BLI_stack_push_r(data->pair_stack[thread]));
+  EDBMSplitPair *pair = static_cast<EDBMSplitPair *>(BLI_stack_push_r(data->pair_stack[thread]));
 
-  bm_vert_pair_elem_setup_ex(v_a, &pair[0]);
-  bm_vert_pair_elem_setup_ex(v_b, &pair[1]);
+  bm_vert_pair_elem_setup_ex(v_a, &pair->elem[0]);
+  bm_vert_pair_elem_setup_ex(v_b, &pair->elem[1]);
+  pair->index_a = index_a;
+  pair->index_b = index_b;
 
   return true;
 }
@@ -319,9 +329,11 @@ static bool bm_edgexvert_isect_cb(void *userdata, int index_a, int index_b, int
   if (bm_edgexvert_isect_impl(
           v, e, co, dir, lambda, data->dist_sq, &data->cut_edges_len, pair_tmp))
   {
-    EDBMSplitElem *pair = static_cast<EDBMSplitElem *>(BLI_stack_push_r(data->pair_stack[thread]));
-    pair[0] = pair_tmp[0];
-    pair[1] = pair_tmp[1];
+    EDBMSplitPair *pair = static_cast<EDBMSplitPair *>(BLI_stack_push_r(data->pair_stack[thread]));
+    pair->elem[0] = pair_tmp[0];
+    pair->elem[1] = pair_tmp[1];
+    pair->index_a = index_a;
+    pair->index_b = index_b;
   }
 
   /* Always return false with edges. */
@@ -414,10 +426,12 @@ static bool bm_edgexedge_isect_cb(void *userdata, int index_a, int index_b, int
     if (bm_edgexedge_isect_impl(
             data, e_a, e_b, co_a, dir_a, co_b, dir_b, lambda_a, lambda_b, pair_tmp))
     {
-      EDBMSplitElem *pair = static_cast<EDBMSplitElem *>(
+      EDBMSplitPair *pair = static_cast<EDBMSplitPair *>(
           BLI_stack_push_r(data->pair_stack[thread]));
-      pair[0] = pair_tmp[0];
-      pair[1] = pair_tmp[1];
+      pair->elem[0] = pair_tmp[0];
+      pair->elem[1] = pair_tmp[1];
+      pair->index_a = index_a;
+      pair->index_b = index_b;
     }
   }
 
@@ -440,16 +454,34 @@ static void bm_elemxelem_bvhtree_overlap(const BVHTree *tree1,
                                          const BVHTree *tree2,
                                          BVHTree_OverlapCallback callback,
                                          EDBMSplitData *data,
-                                         BLI_Stack **pair_stack)
+                                         blender::Vector<BLI_Stack *> &pair_stack,
+                                         blender::Vector<EDBMSplitPair> &r_pairs)
 {
   int parallel_tasks_num = BLI_bvhtree_overlap_thread_num(tree1);
-  for (int i = 0; i < parallel_tasks_num; i++) {
-    if (pair_stack[i] == nullptr) {
-      pair_stack[i] = BLI_stack_new(sizeof(const EDBMSplitElem[2]), __func__);
-    }
+  while (pair_stack.size() < parallel_tasks_num) {
+    pair_stack.append(BLI_stack_new(sizeof(EDBMSplitPair), __func__));
   }
-  data->pair_stack = pair_stack;
+  data->pair_stack = pair_stack.data();
   BLI_bvhtree_overlap_ex(tree1, tree2, nullptr, callback, data, 1, BVH_OVERLAP_USE_THREADING);
+
+  const int64_t pairs_start = r_pairs.size();
+  for (BLI_Stack *stack : pair_stack) {
+    const uint count = uint(BLI_stack_count(stack));
+    r_pairs.resize(r_pairs.size() + count);
+    BLI_stack_pop_n_reverse(stack, r_pairs.end() - count, count);
+  }
+
+  /* Which stack a pair is pushed to depends on the thread that ran its task. Sort the pairs by
+   * their BVH indices, which are unique within one overlap, so the edges are split in the same
+   * order on every run. */
+  std::sort(r_pairs.begin() + pairs_start,
+            r_pairs.end(),
+            [](const EDBMSplitPair &pair_a, const EDBMSplitPair &pair_b) {
+              if (pair_a.index_a != pair_b.index_a) {
+                return pair_a.index_a < pair_b.index_a;
+              }
+              return pair_a.index_b < pair_b.index_b;
+            });
 }
 
 /* -------------------------------------------------------------------- */
@@ -486,16 +518,30 @@ bool BM_mesh_intersect_edges(
   EDBMSplitElem(*pair_iter)[2], (*pair_array)[2] = nullptr;
   int pair_len = 0;
 
-  BLI_Stack *pair_stack[BLI_STACK_PAIR_LEN] = {nullptr};
-  BLI_Stack **pair_stack_vertxvert = pair_stack;
-  BLI_Stack **pair_stack_edgexelem = &pair_stack[KDOP_TREE_TYPE];
+  /* One stack per thread, emptied into the sorted pairs after every overlap.
+   * The vertex pairs are kept before the edge pairs. */
+  blender::Vector<BLI_Stack *> pair_stack;
+  blender::Vector<EDBMSplitPair> pairs_vertxvert;
+  blender::Vector<EDBMSplitPair> pairs_edgexelem;
+  const auto pairs_copy_all = [&](EDBMSplitElem(*r_pair)[2]) {
+    for (const EDBMSplitPair &pair : pairs_vertxvert) {
+      (*r_pair)[0] = pair.elem[0];
+      (*r_pair)[1] = pair.elem[1];
+      r_pair++;
+    }
+    for (const EDBMSplitPair &pair : pairs_edgexelem) {
+      (*r_pair)[0] = pair.elem[0];
+      (*r_pair)[1] = pair.elem[1];
+      r_pair++;
+    }
+  };
 
   const float dist_sq = square_f(dist);
   const float dist_half = dist / 2;
 
   EDBMSplitData data{};
   data.bm = bm;
-  data.pair_stack = pair_stack;
+  data.pair_stack = nullptr;
   data.cut_edges_len = 0;
   data.dist_sq = dist_sq;
   data.dist_sq_sq = square_f(dist_sq);
@@ -546,8 +592,12 @@ bool BM_mesh_intersect_edges(
     if (tree_verts_act) {
       BLI_bvhtree_balance(tree_verts_act);
       /* First pair search. */
-      bm_elemxelem_bvhtree_overlap(
-          tree_verts_act, tree_verts_act, bm_vertxvert_self_isect_cb, &data, pair_stack_vertxvert);
+      bm_elemxelem_bvhtree_overlap(tree_verts_act,
+                                   tree_verts_act,
+                                   bm_vertxvert_self_isect_cb,
+                                   &data,
+                                   pair_stack,
+                                   pairs_vertxvert);
     }
 
     if (tree_verts_remain) {
@@ -555,16 +605,16 @@ bool BM_mesh_intersect_edges(
     }
 
     if (tree_verts_act && tree_verts_remain) {
-      bm_elemxelem_bvhtree_overlap(
-          tree_verts_remain, tree_verts_act, bm_vertxvert_isect_cb, &data, pair_stack_vertxvert);
+      bm_elemxelem_bvhtree_overlap(tree_verts_remain,
+                                   tree_verts_act,
+                                   bm_vertxvert_isect_cb,
+                                   &data,
+                                   pair_stack,
+                                   pairs_vertxvert);
     }
   }
 
-  for (i = KDOP_TREE_TYPE; i--;) {
-    if (pair_stack_vertxvert[i]) {
-      pair_len += BLI_stack_count(pair_stack_vertxvert[i]);
-    }
-  }
+  pair_len += int(pairs_vertxvert.size());
 
 #ifdef INTERSECT_EDGES
   uint vertxvert_pair_len = pair_len;
@@ -653,30 +703,42 @@ bool BM_mesh_intersect_edges(
     int edgexedge_pair_len = 0;
     if (tree_edges_act) {
       /* Edge x Edge */
-      bm_elemxelem_bvhtree_overlap(
-          tree_edges_act, tree_edges_act, bm_edgexedge_self_isect_cb, &data, pair_stack_edgexelem);
+      bm_elemxelem_bvhtree_overlap(tree_edges_act,
+                                   tree_edges_act,
+                                   bm_edgexedge_self_isect_cb,
+                                   &data,
+                                   pair_stack,
+                                   pairs_edgexelem);
 
       if (tree_edges_remain) {
-        bm_elemxelem_bvhtree_overlap(
-            tree_edges_remain, tree_edges_act, bm_edgexedge_isect_cb, &data, pair_stack_edgexelem);
+        bm_elemxelem_bvhtree_overlap(tree_edges_remain,
+                                     tree_edges_act,
+                                     bm_edgexedge_isect_cb,
+                                     &data,
+                                     pair_stack,
+                                     pairs_edgexelem);
       }
 
-      for (i = KDOP_TREE_TYPE; i--;) {
-        if (pair_stack_edgexelem[i]) {
-          edgexedge_pair_len += BLI_stack_count(pair_stack_edgexelem[i]);
-        }
-      }
+      edgexedge_pair_len = int(pairs_edgexelem.size());
 
       if (tree_verts_act) {
         /* Edge v Vert */
-        bm_elemxelem_bvhtree_overlap(
-            tree_edges_act, tree_verts_act, bm_edgexvert_isect_cb, &data, pair_stack_edgexelem);
+        bm_elemxelem_bvhtree_overlap(tree_edges_act,
+                                     tree_verts_act,
+                                     bm_edgexvert_isect_cb,
+                                     &data,
+                                     pair_stack,
+                                     pairs_edgexelem);
       }
 
       if (tree_verts_remain) {
         /* Edge v Vert */
-        bm_elemxelem_bvhtree_overlap(
-            tree_edges_act, tree_verts_remain, bm_edgexvert_isect_cb, &data, pair_stack_edgexelem);
+        bm_elemxelem_bvhtree_overlap(tree_edges_act,
+                                     tree_verts_remain,
+                                     bm_edgexvert_isect_cb,
+                                     &data,
+                                     pair_stack,
+                                     pairs_edgexelem);
       }
 
       BLI_bvhtree_free(tree_edges_act);
@@ -684,18 +746,17 @@ bool BM_mesh_intersect_edges(
 
     if (tree_verts_act && tree_edges_remain) {
       /* Edge v Vert */
-      bm_elemxelem_bvhtree_overlap(
-          tree_edges_remain, tree_verts_act, bm_edgexvert_isect_cb, &data, pair_stack_edgexelem);
+      bm_elemxelem_bvhtree_overlap(tree_edges_remain,
+                                   tree_verts_act,
+                                   bm_edgexvert_isect_cb,
+                                   &data,
+                                   pair_stack,
+                                   pairs_edgexelem);
     }
 
     BLI_bvhtree_free(tree_edges_remain);
 
-    int edgexelem_pair_len = 0;
-    for (i = KDOP_TREE_TYPE; i--;) {
-      if (pair_stack_edgexelem[i]) {
-        edgexelem_pair_len += BLI_stack_count(pair_stack_edgexelem[i]);
-      }
-    }
+    int edgexelem_pair_len = int(pairs_edgexelem.size());
 
     pair_len += edgexelem_pair_len;
     int edgexvert_pair_len = edgexelem_pair_len - edgexedge_pair_len;
@@ -704,14 +765,7 @@ bool BM_mesh_intersect_edges(
       pair_array = static_cast<EDBMSplitElem(*)[2]>(
           MEM_mallocN(sizeof(*pair_array) * pair_len, __func__));
 
-      pair_iter = pair_array;
-      for (i = 0; i < BLI_STACK_PAIR_LEN; i++) {
-        if (pair_stack[i]) {
-          uint count = uint(BLI_stack_count(pair_stack[i]));
-          BLI_stack_pop_n_reverse(pair_stack[i], pair_iter, count);
-          pair_iter += count;
-        }
-      }
+      pairs_copy_all(pair_array);
 
       /* Map intersections per edge. */
       union EdgeIntersectionsMap {
@@ -814,14 +868,7 @@ bool BM_mesh_intersect_edges(
     if (pair_len && pair_array == nullptr) {
       pair_array = static_cast<EDBMSplitElem(*)[2]>(
           MEM_mallocN(sizeof(*pair_array) * pair_len, __func__));
-      pair_iter = pair_array;
-      for (i = 0; i < BLI_STACK_PAIR_LEN; i++) {
-        if (pair_stack[i]) {
-          uint count = uint(BLI_stack_count(pair_stack[i]));
-          BLI_stack_pop_n_reverse(pair_stack[i], pair_iter, count);
-          pair_iter += count;
-        }
-      }
+      pairs_copy_all(pair_array);
     }
 
     if (pair_array) {
@@ -1036,10 +1083,8 @@ bool BM_mesh_intersect_edges(
     }
   }
 
-  for (i = BLI_STACK_PAIR_LEN; i--;) {
-    if (pair_stack[i]) {
-      BLI_stack_free(pair_stack[i]);
-    }
+  for (BLI_Stack *stack : pair_stack) {
+    BLI_stack_free(stack);
   }
   if (pair_array) {
     MEM_freeN(pair_array);
@@ -52,6 +52,20 @@ void DEG_debug_stats_gnuplot(const Depsgraph *graph,
                              const char *label,
                              const char *output_filename);
 
+/* ************************************************ */
+/* Evaluation Tracing */
+
+/**
+ * Start recording evaluation of all dependency graphs into a file in the Chrome trace event
+ * format, which can be opened in Perfetto. Every evaluated operation is recorded with the thread
+ * it was evaluated on, as well as the dependencies between evaluated operations.
+ *
+ * \return False when the file could not be opened.
+ */
+bool DEG_debug_eval_trace_begin(const char *filepath);
+/** Finish recording started by #DEG_debug_eval_trace_begin. */
+void DEG_debug_eval_trace_end();
+
 /* ************************************************ */
 
 /** Compare two dependency graphs. */
@@ -0,0 +1,253 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ *
+ * The trace is written as a JSON array of events, see the "Trace Event Format" specification of
+ * the Chromium project. Every operation is written as a complete event on the thread which
+ * evaluated it, and every dependency between evaluated operations as a flow event. The array is
+ * only closed when tracing ends, trace viewers accept files where this did not happen.
+ */
+
+#include "intern/debug/deg_debug_eval_trace.h"
+
+#include <atomic>
+#include <mutex>
+
+#include "BLI_fileops.hh"
+#include "BLI_map.hh"
+#include "BLI_serialize.hh"
+#include "BLI_set.hh"
+#include "BLI_time.h"
+
+#include "DEG_depsgraph_debug.hh"
+
+#include "intern/depsgraph.hh"
+#include "intern/depsgraph_relation.hh"
+#include "intern/node/deg_node_component.hh"
+#include "intern/node/deg_node_id.hh"
+#include "intern/node/deg_node_operation.hh"
+
+namespace blender::deg {
+
+namespace {
+
+using io::serialize::DictionaryValue;
+
+struct TraceFile {
+  std::mutex mutex;
+  std::unique_ptr<fstream> stream;
+  /* Time when tracing began, timestamps of events are relative to it. */
+  double start_time = 0.0;
+  bool has_events = false;
+  /* Threads for which the name meta-data is written already. */
+  Set<int> named_threads;
+  /* Identifier of the next flow event, unique within the trace. */
+  int64_t next_flow_id = 0;
+};
+
+TraceFile &get_trace_file()
+{
+  static TraceFile trace_file;
+  return trace_file;
+}
+
+std::atomic<bool> trace_enabled = false;
+
+/* Index of the current thread, which is stable over the lifetime of the thread. Used instead of
+ * the system thread identifiers to keep the trace readable. */
+int current_thread_index()
+{
+  static std::atomic<int> threads_num = 0;
+  static thread_local const int thread_index = threads_num.fetch_add(1);
+  return thread_index;
+}
+
+/* Timestamp of the trace event, in microseconds. */
+double trace_timestamp(const TraceFile &trace_file, const double time)
+{
+  return (time - trace_file.start_time) * 1e6;
+}
+
+std::shared_ptr<DictionaryValue> new_event(const TraceFile &trace_file,
+                                           std::string name,
+                                           const char *phase,
+                                           const double time,
+                                           const int thread_index)
+{
+  std::shared_ptr<DictionaryValue> event = std::make_shared<DictionaryValue>();
+  event->append_str("name", std::move(name));
+  event->append_str("ph", phase);
+  event->append_double("ts", trace_timestamp(trace_file, time));
+  event->append_int("pid", 1);
+  event->append_int("tid", thread_index);
+  return event;
+}
+
+void write_event(TraceFile &trace_file, const DictionaryValue &event)
+{
+  *trace_file.stream << (trace_file.has_events ? ",\n" : "\n");
+  io::serialize::JsonFormatter formatter;
+  formatter.serialize(*trace_file.stream, event);
+  trace_file.has_events = true;
+}
+
+void write_thread_name_if_needed(TraceFile &trace_file, const int thread_index)
+{
+  if (!trace_file.named_threads.add(thread_index)) {
+    return;
+  }
+  std::shared_ptr<DictionaryValue> event = new_event(
+      trace_file, "thread_name", "M", trace_file.start_time, thread_index);
+  event->append_dict("args")->append_str("name", "Thread " + std::to_string(thread_index));
+  write_event(trace_file, *event);
+}
+
+}  // namespace
+
+bool EvalTrace::is_enabled()
+{
+  return trace_enabled;
+}
+
+EvalTrace::EvalTrace(const double start_time)
+    : start_time_(start_time), thread_index_(current_thread_index())
+{
+}
+
+void EvalTrace::record_operation(const OperationNode *op_node,
+                                 const double start_time,
+                                 const double end_time)
+{
+  events_.local().append({op_node, start_time, end_time, current_thread_index()});
+}
+
+void EvalTrace::write(const Depsgraph &graph, const double end_time)
+{
+  Map<const OperationNode *, const OperationEvent *> event_by_operation;
+  for (const Vector<OperationEvent> &events : events_) {
+    for (const OperationEvent &event : events) {
+      event_by_operation.add(event.op_node, &event);
+    }
+  }
+
+  TraceFile &trace_file = get_trace_file();
+  std::lock_guard lock{trace_file.mutex};
+  if (!trace_file.stream) {
+    return;
+  }
+
+  write_thread_name_if_needed(trace_file, thread_index_);
+  std::shared_ptr<DictionaryValue> evaluation = new_event(
+      trace_file,
+      graph.debug.name.empty() ? "Depsgraph evaluation" : graph.debug.name,
+      "X",
+      start_time_,
+      thread_index_);
+  evaluation->append_str("cat", "depsgraph");
+  evaluation->append_double("dur", (end_time - start_time_) * 1e6);
+  std::shared_ptr<DictionaryValue> evaluation_args = evaluation->append_dict("args");
+  evaluation_args->append_int("update_count", int64_t(graph.update_count));
+  evaluation_args->append_int("operations_num", event_by_operation.size());
+  write_event(trace_file, *evaluation);
+
+  Set<const OperationNode *> visited;
+  Vector<const OperationNode *> stack;
+  for (const OperationEvent *event : event_by_operation.values()) {
+    const OperationNode *op_node = event->op_node;
+    const ComponentNode *comp_node = op_node->owner;
+    const IDNode *id_node = comp_node->owner;
+
+    write_thread_name_if_needed(trace_file, event->thread_index);
+    std::shared_ptr<DictionaryValue> operation = new_event(
+        trace_file, op_node->identifier(), "X", event->start_time, event->thread_index);
+    operation->append_str("cat", nodeTypeAsString(comp_node->type));
+    operation->append_double("dur", (event->end_time - event->start_time) * 1e6);
+    std::shared_ptr<DictionaryValue> args = operation->append_dict("args");
+    args->append_str("id", id_node->name);
+    args->append_str("component", comp_node->identifier());
+    args->append_double("critical_path_ms", op_node->critical_path_time * 1e3);
+    write_event(trace_file, *operation);
+
+    /* Find the evaluated operations this one depends on. No-op operations are never evaluated,
+     * so dependencies are followed through them. */
+    visited.clear();
+    stack.clear();
+    for (const Relation *rel : op_node->inlinks) {
+      if (rel->from->type == NodeType::OPERATION) {
+        stack.append(static_cast<const OperationNode *>(rel->from));
+      }
+    }
+    while (!stack.is_empty()) {
+      const OperationNode *op_from = stack.pop_last();
+      if (!visited.add(op_from)) {
+        continue;
+      }
+      if (const OperationEvent *event_from = event_by_operation.lookup_default(op_from, nullptr))
+      {
+        const int64_t flow_id = trace_file.next_flow_id++;
+        std::shared_ptr<DictionaryValue> flow_start = new_event(
+            trace_file, "dependency", "s", event_from->start_time, event_from->thread_index);
+        flow_start->append_str("cat", "dependency");
+        flow_start->append_int("id", flow_id);
+        write_event(trace_file, *flow_start);
+
+        std::shared_ptr<DictionaryValue> flow_end = new_event(
+            trace_file, "dependency", "f", event->start_time, event->thread_index);
+        flow_end->append_str("cat", "dependency");
+        flow_end->append_int("id", flow_id);
+        flow_end->append_str("bp", "e");
+        write_event(trace_file, *flow_end);
+        continue;
+      }
+      if (op_from->is_noop()) {
+        for (const Relation *rel : op_from->inlinks) {
+          if (rel->from->type == NodeType::OPERATION) {
+            stack.append(static_cast<const OperationNode *>(rel->from));
+          }
+        }
+      }
+    }
+  }
+
+  trace_file.stream->flush();
+}
+
+}  // namespace blender::deg
+
+namespace deg = blender::deg;
+
+bool DEG_debug_eval_trace_begin(const char *filepath)
+{
+  deg::TraceFile &trace_file = deg::get_trace_file();
+  std::lock_guard lock{trace_file.mutex};
+  std::unique_ptr<blender::fstream> stream = std::make_unique<blender::fstream>(
+      filepath, std::ios::out | std::ios::trunc);
+  if (!stream->is_open()) {
+    return false;
+  }
+  if (trace_file.stream) {
+    *trace_file.stream << "\n]\n";
+  }
+  trace_file.stream = std::move(stream);
+  trace_file.start_time = BLI_time_now_seconds();
+  trace_file.has_events = false;
+  trace_file.named_threads.clear();
+  *trace_file.stream << "[";
+  deg::trace_enabled = true;
+  return true;
+}
+
+void DEG_debug_eval_trace_end()
+{
+  deg::TraceFile &trace_file = deg::get_trace_file();
+  std::lock_guard lock{trace_file.mutex};
+  deg::trace_enabled = false;
+  if (!trace_file.stream) {
+    return;
+  }
+  *trace_file.stream << "\n]\n";
+  trace_file.stream.reset();
+}
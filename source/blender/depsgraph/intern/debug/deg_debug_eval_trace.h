@@ -0,0 +1,49 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup depsgraph
+ *
+ * Recording of the dependency graph evaluation into a file in the Chrome trace event format.
+ */
+
+#pragma once
+
+#include "BLI_enumerable_thread_specific.hh"
+#include "BLI_vector.hh"
+
+namespace blender::deg {
+
+struct Depsgraph;
+struct OperationNode;
+
+/* Timing of operations evaluated during a single evaluation of a dependency graph. */
+class EvalTrace {
+ public:
+  /* Whether evaluation is to be traced, as requested by #DEG_debug_eval_trace_begin. */
+  static bool is_enabled();
+
+  explicit EvalTrace(double start_time);
+
+  /* Record evaluation of a single operation. Can be called from any thread. */
+  void record_operation(const OperationNode *op_node, double start_time, double end_time);
+
+  /* Append the evaluation and all recorded operations to the trace file, including dependencies
+   * between the recorded operations. */
+  void write(const Depsgraph &graph, double end_time);
+
+ private:
+  struct OperationEvent {
+    const OperationNode *op_node;
+    double start_time;
+    double end_time;
+    int thread_index;
+  };
+
+  double start_time_;
+  int thread_index_;
+  threading::EnumerableThreadSpecific<Vector<OperationEvent>> events_;
+};
+
+}  // namespace blender::deg
@@ -10,9 +10,12 @@
 
 #include "intern/eval/deg_eval.h"
 
+#include <optional>
+
 #include "BLI_compiler_attrs.h"
 #include "BLI_function_ref.hh"
 #include "BLI_gsqueue.h"
+#include "BLI_heap_simple.h"
 #include "BLI_task.h"
 #include "BLI_time.h"
 #include "BLI_utildefines.h"
@@ -32,6 +35,7 @@
 
 #include "atomic_ops.h"
 
+#include "intern/debug/deg_debug_eval_trace.h"
 #include "intern/depsgraph.hh"
 #include "intern/depsgraph_relation.hh"
 #include "intern/depsgraph_tag.hh"
@@ -83,6 +87,11 @@ struct DepsgraphEvalState {
   EvaluationStage stage;
   bool need_update_pending_parents = true;
   bool need_single_thread_pass = false;
+  /* Operations which are ready to be evaluated by the task pool, ordered by their critical path
+   * time. Access is protected by the graph lock. */
+  HeapSimple *ready_operations = nullptr;
+  /* Recording of evaluated operations, null when tracing is disabled. */
+  EvalTrace *trace = nullptr;
 };
 
 void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_node)
@@ -91,14 +100,18 @@ void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_nod
 
   /* Sanity checks. */
   BLI_assert_msg(!operation_node->is_noop(), "NOOP nodes should not actually be scheduled");
-  /* Perform operation. */
+  /* Perform operation. The timing is always gathered, as it is used to prioritize the operations
+   * in the next evaluations. */
+  const double start_time = BLI_time_now_seconds();
+  operation_node->evaluate(depsgraph);
+  const double end_time = BLI_time_now_seconds();
+  const double time = end_time - start_time;
+  deg_eval_stats_record_operation_time(operation_node, time);
   if (state->do_stats) {
-    const double start_time = BLI_time_now_seconds();
-    operation_node->evaluate(depsgraph);
-    operation_node->stats.current_time += BLI_time_now_seconds() - start_time;
+    operation_node->stats.current_time += time;
   }
-  else {
-    operation_node->evaluate(depsgraph);
+  if (state->trace) {
+    state->trace->record_operation(operation_node, start_time, end_time);
   }
 
   /* Clear the flag early on, allowing partial updates without re-evaluating the same node multiple
@@ -108,18 +121,44 @@ void evaluate_node(const DepsgraphEvalState *state, OperationNode *operation_nod
   operation_node->flag &= ~DEPSOP_FLAG_CLEAR_ON_EVAL;
 }
 
-void deg_task_run_func(TaskPool *pool, void *taskdata)
+/* Queue an operation which is ready to be evaluated, and push a task to evaluate it.
+ *
+ * Tasks are not bound to the operation they were pushed for: every task evaluates the ready
+ * operation with the longest critical path. This way the chain of operations which bounds the
+ * total evaluation time is started as early as possible, while cheap independent operations fill
+ * the remaining threads. */
+void schedule_operation_to_pool(DepsgraphEvalState *state, TaskPool *pool, OperationNode *node)
+{
+  BLI_spin_lock(&state->graph->lock);
+  BLI_heapsimple_insert(state->ready_operations, -node->critical_path_time, node);
+  BLI_spin_unlock(&state->graph->lock);
+
+  BLI_task_pool_push(pool, deg_task_run_func, nullptr, false, nullptr);
+}
+
+OperationNode *pop_ready_operation(DepsgraphEvalState *state)
+{
+  BLI_spin_lock(&state->graph->lock);
+  /* There is a task for every queued operation, so the queue can not be empty here. */
+  BLI_assert(!BLI_heapsimple_is_empty(state->ready_operations));
+  OperationNode *operation_node = static_cast<OperationNode *>(
+      BLI_heapsimple_pop_min(state->ready_operations));
+  BLI_spin_unlock(&state->graph->lock);
+  return operation_node;
+}
+
+void deg_task_run_func(TaskPool *pool, void * /*taskdata*/)
 {
   void *userdata_v = BLI_task_pool_user_data(pool);
   DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
 
   /* Evaluate node. */
-  OperationNode *operation_node = reinterpret_cast<OperationNode *>(taskdata);
+  OperationNode *operation_node = pop_ready_operation(state);
   evaluate_node(state, operation_node);
 
   /* Schedule children. */
   schedule_children(state, operation_node, [&](OperationNode *node) {
-    BLI_task_pool_push(pool, deg_task_run_func, node, false, nullptr);
+    schedule_operation_to_pool(state, pool, node);
   });
 }
 
@@ -318,9 +357,10 @@ void evaluate_graph_threaded_stage(DepsgraphEvalState *state,
   calculate_pending_parents_if_needed(state);
 
   schedule_graph(state, [&](OperationNode *node) {
-    BLI_task_pool_push(task_pool, deg_task_run_func, node, false, nullptr);
+    schedule_operation_to_pool(state, task_pool, node);
   });
   BLI_task_pool_work_and_wait(task_pool);
+  BLI_assert(BLI_heapsimple_is_empty(state->ready_operations));
 }
 
 /* Evaluate remaining operations of the dependency graph in a single threaded manner. */
@@ -403,9 +443,19 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   state.graph = graph;
   state.do_stats = graph->debug.do_time_debug();
 
+  std::optional<EvalTrace> trace;
+  if (EvalTrace::is_enabled()) {
+    trace.emplace(BLI_time_now_seconds());
+    state.trace = &*trace;
+  }
+
   /* Prepare all nodes for evaluation. */
   initialize_execution(&state, graph);
 
+  /* Prioritize the operations based on their timing in the previous evaluations. */
+  deg_eval_stats_calculate_critical_path(graph);
+  state.ready_operations = BLI_heapsimple_new();
+
   /* Evaluation happens in several incremental steps:
    *
    * - Start with the copy-on-evaluation operations which never form dependency cycles. This will
@@ -447,6 +497,7 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
   evaluate_graph_threaded_stage(&state, task_pool, EvaluationStage::THREADED_EVALUATION);
 
   BLI_task_pool_free(task_pool);
+  BLI_heapsimple_free(state.ready_operations, nullptr);
 
   evaluate_graph_single_threaded_if_needed(&state);
 
@@ -457,6 +508,10 @@ void deg_evaluate_on_refresh(Depsgraph *graph)
     deg_eval_stats_aggregate(graph);
   }
 
+  if (trace) {
+    trace->write(*graph, BLI_time_now_seconds());
+  }
+
   /* Clear any uncleared tags. */
   deg_graph_clear_tags(graph);
   graph->is_evaluating = false;
@@ -8,9 +8,13 @@
 
 #include "intern/eval/deg_eval_stats.h"
 
+#include <algorithm>
+
+#include "BLI_stack.h"
 #include "BLI_utildefines.h"
 
 #include "intern/depsgraph.hh"
+#include "intern/depsgraph_relation.hh"
 
 #include "intern/node/deg_node.hh"
 #include "intern/node/deg_node_component.hh"
@@ -39,4 +43,81 @@ void deg_eval_stats_aggregate(Depsgraph *graph)
   }
 }
 
+void deg_eval_stats_record_operation_time(OperationNode *op_node, const double time)
+{
+  /* Weight of the latest evaluation in the running average. Recent evaluations are favored, so
+   * that the estimate follows changes in the scene without being thrown off by a single slow
+   * evaluation. */
+  const float latest_weight = 0.25f;
+  Node::Stats &stats = op_node->stats;
+  if (stats.average_time == 0.0f) {
+    stats.average_time = float(time);
+  }
+  else {
+    stats.average_time += (float(time) - stats.average_time) * latest_weight;
+  }
+}
+
+/* Estimated cost of evaluating the operation on its own. */
+static float operation_time_estimate(const OperationNode *op_node)
+{
+  if (op_node->is_noop()) {
+    return 0.0f;
+  }
+  /* Operations which were never evaluated get a nominal cost, so that the number of operations
+   * in a chain is still taken into account. */
+  const float unknown_time = 1e-6f;
+  const float average_time = op_node->stats.average_time;
+  return average_time > 0.0f ? average_time : unknown_time;
+}
+
+void deg_eval_stats_calculate_critical_path(Depsgraph *graph)
+{
+  BLI_Stack *stack = BLI_stack_new(sizeof(OperationNode *), "DEG critical path stack");
+
+  /* Traverse the graph from the leaves to the roots, so that the critical path time of all
+   * children is known when an operation is visited. */
+  for (OperationNode *op_node : graph->operations) {
+    op_node->critical_path_time = 0.0f;
+    op_node->num_links_pending = 0;
+    for (Relation *rel : op_node->outlinks) {
+      if ((rel->to->type == NodeType::OPERATION) && (rel->flag & RELATION_FLAG_CYCLIC) == 0) {
+        ++op_node->num_links_pending;
+      }
+    }
+    if (op_node->num_links_pending == 0) {
+      BLI_stack_push(stack, &op_node);
+    }
+  }
+
+  while (!BLI_stack_is_empty(stack)) {
+    OperationNode *op_node;
+    BLI_stack_pop(stack, &op_node);
+
+    /* Operations which are up to date are not evaluated, and do not delay anything. */
+    if (op_node->flag & DEPSOP_FLAG_NEEDS_UPDATE) {
+      op_node->critical_path_time += operation_time_estimate(op_node);
+    }
+    else {
+      op_node->critical_path_time = 0.0f;
+    }
+
+    for (Relation *rel : op_node->inlinks) {
+      if ((rel->from->type != NodeType::OPERATION) || (rel->flag & RELATION_FLAG_CYCLIC)) {
+        continue;
+      }
+      OperationNode *op_from = reinterpret_cast<OperationNode *>(rel->from);
+      /* Until the parent is visited its critical path time holds the longest path of its
+       * children. */
+      op_from->critical_path_time = std::max(op_from->critical_path_time,
+                                             op_node->critical_path_time);
+      BLI_assert(op_from->num_links_pending > 0);
+      if (--op_from->num_links_pending == 0) {
+        BLI_stack_push(stack, &op_from);
+      }
+    }
+  }
+  BLI_stack_free(stack);
+}
+
 }  // namespace blender::deg
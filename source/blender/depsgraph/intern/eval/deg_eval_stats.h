@@ -11,8 +11,20 @@
 namespace blender::deg {
 
 struct Depsgraph;
+struct OperationNode;
 
 /* Aggregate operation timings to overall component and ID nodes timing. */
 void deg_eval_stats_aggregate(Depsgraph *graph);
 
+/* Accumulate time spent on the evaluation of the operation into its running average.
+ * Only to be called by the thread which evaluated the operation. */
+void deg_eval_stats_record_operation_time(OperationNode *op_node, double time);
+
+/* Calculate the critical path time of all operations which need update, using the running
+ * average of their evaluation times as a cost estimate.
+ *
+ * NOTE: Uses the pending links counters of operations, so those are to be re-calculated
+ * before the evaluation. */
+void deg_eval_stats_calculate_critical_path(Depsgraph *graph);
+
 }  // namespace blender::deg
@@ -168,6 +168,9 @@ struct Node {
     void reset_current();
     /* Time spent on this node during current graph evaluation. */
     double current_time;
+    /* Running average of the time spent on this node over the previous graph evaluations.
+     * Zero when the node was never evaluated. */
+    float average_time;
   };
   /* Relationships between nodes
    * The reason why all depsgraph nodes are descended from this type (apart
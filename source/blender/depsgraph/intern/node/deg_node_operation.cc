@@ -211,7 +211,7 @@ const char *operationCodeAsString(OperationCode opcode)
   return "UNKNOWN";
 }
 
-OperationNode::OperationNode() : name_tag(-1), flag(0) {}
+OperationNode::OperationNode() : critical_path_time(0.0f), name_tag(-1), flag(0) {}
 
 string OperationNode::identifier() const
 {
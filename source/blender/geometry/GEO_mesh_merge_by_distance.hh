@@ -18,8 +18,8 @@ struct Mesh;
 namespace blender::geometry {
 
 /**
- * Merge selected vertices into other selected vertices within the \a merge_distance. The merged
- * indices favor speed over accuracy, since the results will depend on the order of the vertices.
+ * Merge selected vertices into other selected vertices within the \a merge_distance. Vertices are
+ * visited in index order, so the result does not depend on how the work is split across threads.
  *
  * \returns #std::nullopt if the mesh should not be changed (no vertices are merged), in order to
  * avoid copying the input. Otherwise returns the new mesh with merged geometry.
@@ -5,6 +5,7 @@
 #pragma once
 
 #include "BLI_index_mask.hh"
+#include "BLI_math_vector_types.hh"
 
 #include "BKE_attribute_filter.hh"
 
@@ -17,8 +18,24 @@ struct PointCloud;
 namespace blender::geometry {
 
 /**
- * Merge selected points into other selected points within the \a merge_distance. The merged
- * indices favor speed over accuracy, since the results will depend on the order of the points.
+ * Find selected points to merge into other selected points within \a merge_distance. The result
+ * is the same as visiting the selected points in index order and merging all points within the
+ * merge distance that aren't merged yet into the visited point, unless it is merged itself. So
+ * merging is a single step, points are never merged into points that are merged themselves.
+ *
+ * \param r_merge_indices: Aligned with \a positions. For merged points, this is set to the index
+ * of the point they are merged into, for points that other points are merged into, it is set to
+ * their own index. Other values are not changed.
+ * \return The number of points that are merged into another point.
+ */
+int calc_merge_indices_by_distance(Span<float3> positions,
+                                   const IndexMask &selection,
+                                   float merge_distance,
+                                   MutableSpan<int> r_merge_indices);
+
+/**
+ * Merge selected points into other selected points within the \a merge_distance, see
+ * #calc_merge_indices_by_distance.
  */
 PointCloud *point_merge_by_distance(const PointCloud &src_points,
                                     const float merge_distance,
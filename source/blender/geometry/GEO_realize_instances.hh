@@ -4,10 +4,33 @@
 
 #pragma once
 
+#include <memory>
+
+#include "BLI_utility_mixins.hh"
+
 #include "BKE_geometry_set.hh"
 
 namespace blender::geometry {
 
+/**
+ * Data that is kept between #realize_instances calls so that the previous result can be reused
+ * when the same geometry is realized again and only instance transforms changed, e.g. when
+ * instances are animated. The unchanged arrays of the previous result are passed through with
+ * implicit sharing and only the positions of instances that moved are computed again.
+ *
+ * The input data is referenced weakly, so the cache does not keep it alive. Currently only the
+ * realized mesh is cached. A cache must not be used by multiple #realize_instances calls at the
+ * same time.
+ */
+class RealizeInstancesCache : NonCopyable, NonMovable {
+ public:
+  struct MeshData;
+  std::unique_ptr<MeshData> mesh;
+
+  RealizeInstancesCache();
+  ~RealizeInstancesCache();
+};
+
 /**
  * General options for realize_instances.
  */
@@ -27,6 +50,12 @@ struct RealizeInstancesOptions {
 
   std::reference_wrapper<const bke::AttributeFilter> attribute_filter =
       bke::AttributeFilter::default_filter();
+
+  /**
+   * Optional data from a previous call that is used to avoid recomputing unchanged data. It is
+   * updated with the new result.
+   */
+  RealizeInstancesCache *cache = nullptr;
 };
 
 /**
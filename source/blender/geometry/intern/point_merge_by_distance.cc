@@ -2,9 +2,14 @@
  *
  * SPDX-License-Identifier: GPL-2.0-or-later */
 
+#include <algorithm>
+#include <array>
+
 #include "BLI_array_utils.hh"
-#include "BLI_kdtree.h"
+#include "BLI_function_ref.hh"
+#include "BLI_math_vector.hh"
 #include "BLI_offset_indices.hh"
+#include "BLI_sort.hh"
 #include "BLI_task.hh"
 
 #include "DNA_pointcloud_types.h"
@@ -17,6 +22,347 @@
 
 namespace blender::geometry {
 
+/**
+ * The grid cell coordinates are packed into a single 64 bit key, with 21 bits per axis. The
+ * offset makes them positive, the limit leaves room for the neighbors of every cell.
+ */
+static constexpr int cell_coord_limit = 1 << 19;
+static constexpr int cell_coord_offset = 1 << 20;
+static constexpr uint64_t cell_coord_mask = (1 << 21) - 1;
+/** Used for points with non-finite coordinates, which are never merged. */
+static constexpr uint64_t invalid_cell_key = std::numeric_limits<uint64_t>::max();
+
+static uint64_t cell_key(const int3 &cell)
+{
+  return (uint64_t(cell.z) << 42) | (uint64_t(cell.y) << 21) | uint64_t(cell.x);
+}
+
+static int3 cell_from_key(const uint64_t key)
+{
+  return int3(int(key & cell_coord_mask), int((key >> 21) & cell_coord_mask), int(key >> 42));
+}
+
+static bool is_finite(const float3 &position)
+{
+  return std::isfinite(position.x) && std::isfinite(position.y) && std::isfinite(position.z);
+}
+
+static float calc_cell_size(const Span<float3> positions,
+                            const Span<int> indices,
+                            const float merge_distance)
+{
+  const float max_abs = threading::parallel_reduce(
+      indices.index_range(),
+      4096,
+      0.0f,
+      [&](const IndexRange range, float max_abs) {
+        for (const int i : indices.slice(range)) {
+          if (is_finite(positions[i])) {
+            max_abs = std::max(max_abs, math::reduce_max(math::abs(positions[i])));
+          }
+        }
+        return max_abs;
+      },
+      [](const float a, const float b) { return std::max(a, b); });
+  /* Larger cells only make the search slower, they don't change the result. */
+  const float cell_size = std::max(merge_distance, max_abs / float(cell_coord_limit));
+  return cell_size > 0.0f ? cell_size : 1.0f;
+}
+
+static uint64_t calc_cell_key(const float3 &position, const float cell_size)
+{
+  if (!is_finite(position)) {
+    return invalid_cell_key;
+  }
+  const float3 cell = math::clamp(math::floor(position / cell_size),
+                                  -float(cell_coord_limit),
+                                  float(cell_coord_limit));
+  return cell_key(int3(cell) + cell_coord_offset);
+}
+
+/**
+ * Index of the first key that is not less than the given key. All keys before \a start must be
+ * less than the key. The search is faster when the result is close to \a start.
+ */
+static int find_first_key(const Span<uint64_t> sorted_keys, const int start, const uint64_t key)
+{
+  const int size = sorted_keys.size();
+  int begin = start;
+  int step = 1;
+  while (begin + step < size && sorted_keys[begin + step] < key) {
+    begin += step;
+    step *= 2;
+  }
+  const int end = std::min(begin + step + 1, size);
+  return std::lower_bound(sorted_keys.begin() + begin, sorted_keys.begin() + end, key) -
+         sorted_keys.begin();
+}
+
+static int find_key_end(const Span<uint64_t> sorted_keys, const int start, const uint64_t key)
+{
+  return find_first_key(sorted_keys, start, key + 1);
+}
+
+namespace {
+
+/** The selected points, sorted by the key of the grid cell containing them. */
+struct SortedPoints {
+  /** Index of every point in the selection. Points in a cell are ordered by this index. */
+  Array<int> points;
+  Array<uint64_t> keys;
+  Array<float3> positions;
+};
+
+enum class PointState : int8_t {
+  Undecided,
+  /** The point is not merged, other points may be merged into it. */
+  Kept,
+  Merged,
+};
+
+enum class VisitResult {
+  Continue,
+  SkipCell,
+  Stop,
+};
+
+/** Ranges of the sorted points in the 3x3x3 neighborhood of a cell, one for every row of cells. */
+struct NeighborRows {
+  uint64_t key = invalid_cell_key;
+  std::array<IndexRange, 9> rows;
+
+  void update(const Span<uint64_t> sorted_keys, const uint64_t new_key)
+  {
+    if (new_key == key) {
+      return;
+    }
+    /* The rows only move forward when the cell does. */
+    const bool search_from_rows = key != invalid_cell_key && new_key > key;
+    key = new_key;
+    const int3 cell = cell_from_key(key);
+    int row_i = 0;
+    for (const int z : {-1, 0, 1}) {
+      for (const int y : {-1, 0, 1}) {
+        const int3 row_cell = cell + int3(0, y, z);
+        IndexRange &row = rows[row_i++];
+        const int start = find_first_key(sorted_keys,
+                                         search_from_rows ? int(row.start()) : 0,
+                                         cell_key(row_cell - int3(1, 0, 0)));
+        const int end = find_key_end(sorted_keys,
+                                     search_from_rows ? std::max(start, int(row.one_after_last())) :
+                                                        start,
+                                     cell_key(row_cell + int3(1, 0, 0)));
+        row = IndexRange::from_begin_end(start, end);
+      }
+    }
+  }
+};
+
+}  // namespace
+
+/**
+ * Call the function for all points within the merge distance that come before the point with the
+ * given sorted index in the selection. The function can skip the remaining points of the cell,
+ * which come after the visited point in the selection, or stop the search.
+ */
+template<typename Fn>
+static void foreach_earlier_close_point(const SortedPoints &sorted,
+                                        const NeighborRows &rows,
+                                        const float merge_distance_sq,
+                                        const int sorted_i,
+                                        const Fn &fn)
+{
+  const int point = sorted.points[sorted_i];
+  const float3 &position = sorted.positions[sorted_i];
+  for (const IndexRange row : rows.rows) {
+    for (int j = row.start(); j < row.one_after_last(); j++) {
+      if (sorted.points[j] >= point) {
+        j = find_key_end(sorted.keys, j, sorted.keys[j]) - 1;
+        continue;
+      }
+      if (math::distance_squared(position, sorted.positions[j]) > merge_distance_sq) {
+        continue;
+      }
+      switch (fn(j)) {
+        case VisitResult::Continue:
+          break;
+        case VisitResult::SkipCell:
+          j = find_key_end(sorted.keys, j, sorted.keys[j]) - 1;
+          break;
+        case VisitResult::Stop:
+          return;
+      }
+    }
+  }
+}
+
+/** Call the function for the sorted indices in the mask, in parallel. */
+template<typename Fn>
+static void foreach_sorted_point(const SortedPoints &sorted, const IndexMask &mask, const Fn &fn)
+{
+  threading::parallel_for(mask.index_range(), 1024, [&](const IndexRange range) {
+    /* Consecutive points are usually in the same cell. */
+    NeighborRows rows;
+    mask.slice(range).foreach_index([&](const int sorted_i) {
+      rows.update(sorted.keys, sorted.keys[sorted_i]);
+      fn(rows, sorted_i);
+    });
+  });
+}
+
+/** Whether a point that comes before the point within the merge distance is in the state. */
+static bool has_earlier_close_point(const SortedPoints &sorted,
+                                    const NeighborRows &rows,
+                                    const float merge_distance_sq,
+                                    const int sorted_i,
+                                    const FunctionRef<bool(int)> fn)
+{
+  bool found = false;
+  foreach_earlier_close_point(sorted, rows, merge_distance_sq, sorted_i, [&](const int j) {
+    if (fn(j)) {
+      found = true;
+      return VisitResult::Stop;
+    }
+    return VisitResult::Continue;
+  });
+  return found;
+}
+
+/**
+ * Decide which points are merged, with the same result as visiting the points in the order of the
+ * selection and merging all points within the merge distance that are not merged yet into the
+ * visited point, if it is not merged itself. So a point is merged if and only if a point that
+ * comes before it within the merge distance is kept.
+ *
+ * Points that only depend on decided points are decided in parallel, in rounds. When a round
+ * makes little progress, like for a chain of close points, the rest is decided in order.
+ */
+static void decide_merged_points(const SortedPoints &sorted,
+                                 const float merge_distance_sq,
+                                 MutableSpan<PointState> states)
+{
+  const int points_num = sorted.points.size();
+  IndexMaskMemory memory;
+  IndexMask undecided = IndexMask::from_predicate(
+      IndexRange(points_num), GrainSize(4096), memory, [&](const int i) {
+        return sorted.keys[i] != invalid_cell_key;
+      });
+
+  /* Decide based on the states before every pass, so that the result does not depend on the
+   * order in which the points are processed. */
+  Array<bool> is_decided(points_num);
+  auto decide_pass = [&](const PointState state, const FunctionRef<bool(int)> decided_fn) {
+    foreach_sorted_point(sorted, undecided, [&](const NeighborRows &rows, const int sorted_i) {
+      is_decided[sorted_i] = has_earlier_close_point(
+                                 sorted, rows, merge_distance_sq, sorted_i, decided_fn) ==
+                             (state == PointState::Merged);
+    });
+    undecided.foreach_index(GrainSize(4096), [&](const int sorted_i) {
+      if (is_decided[sorted_i]) {
+        states[sorted_i] = state;
+      }
+    });
+    undecided = IndexMask::from_predicate(
+        undecided, GrainSize(4096), memory, [&](const int sorted_i) {
+          return states[sorted_i] == PointState::Undecided;
+        });
+  };
+
+  while (!undecided.is_empty()) {
+    const int64_t undecided_num = undecided.size();
+    /* Kept when all earlier close points are merged. */
+    decide_pass(PointState::Kept, [&](const int j) { return states[j] != PointState::Merged; });
+    /* Merged when an earlier close point is kept. */
+    decide_pass(PointState::Merged, [&](const int j) { return states[j] == PointState::Kept; });
+    if (undecided.size() * 8 > undecided_num * 7) {
+      break;
+    }
+  }
+
+  Array<int> remaining(undecided.size());
+  undecided.to_indices(remaining.as_mutable_span());
+  std::sort(remaining.begin(), remaining.end(), [&](const int a, const int b) {
+    return sorted.points[a] < sorted.points[b];
+  });
+  NeighborRows rows;
+  for (const int sorted_i : remaining) {
+    rows.update(sorted.keys, sorted.keys[sorted_i]);
+    states[sorted_i] = has_earlier_close_point(
+                           sorted, rows, merge_distance_sq, sorted_i, [&](const int j) {
+                             return states[j] == PointState::Kept;
+                           }) ?
+                           PointState::Merged :
+                           PointState::Kept;
+  }
+}
+
+int calc_merge_indices_by_distance(const Span<float3> positions,
+                                   const IndexMask &selection,
+                                   const float merge_distance,
+                                   MutableSpan<int> r_merge_indices)
+{
+  const int points_num = selection.size();
+  Array<int> indices(points_num);
+  selection.to_indices(indices.as_mutable_span());
+
+  /* Sort the selected points by the grid cell containing them. Points with the same key are
+   * ordered by index, so that the result does not depend on the sorting algorithm. */
+  const float cell_size = calc_cell_size(positions, indices, merge_distance);
+  Array<uint64_t> keys(points_num);
+  threading::parallel_for(indices.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      keys[i] = calc_cell_key(positions[indices[i]], cell_size);
+    }
+  });
+  SortedPoints sorted;
+  sorted.points.reinitialize(points_num);
+  array_utils::fill_index_range<int>(sorted.points);
+  parallel_sort(sorted.points.begin(), sorted.points.end(), [&](const int a, const int b) {
+    return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+  });
+  sorted.keys.reinitialize(points_num);
+  array_utils::gather(keys.as_span(), sorted.points.as_span(), sorted.keys.as_mutable_span());
+  keys = {};
+  sorted.positions.reinitialize(points_num);
+  threading::parallel_for(sorted.points.index_range(), 4096, [&](const IndexRange range) {
+    for (const int i : range) {
+      sorted.positions[i] = positions[indices[sorted.points[i]]];
+    }
+  });
+
+  const float merge_distance_sq = merge_distance * merge_distance;
+  Array<PointState> states(points_num, PointState::Undecided);
+  decide_merged_points(sorted, merge_distance_sq, states);
+
+  IndexMaskMemory memory;
+  const IndexMask merged = IndexMask::from_predicate(
+      IndexRange(points_num), GrainSize(4096), memory, [&](const int i) {
+        return states[i] == PointState::Merged;
+      });
+
+  /* Every merged point is merged into the first kept point within the merge distance. Points in a
+   * cell are visited in order, so the rest of the cell can be skipped once one is found. */
+  Array<int> targets(points_num);
+  foreach_sorted_point(sorted, merged, [&](const NeighborRows &rows, const int sorted_i) {
+    int target = std::numeric_limits<int>::max();
+    foreach_earlier_close_point(sorted, rows, merge_distance_sq, sorted_i, [&](const int j) {
+      if (states[j] != PointState::Kept) {
+        return VisitResult::Continue;
+      }
+      target = std::min(target, sorted.points[j]);
+      return VisitResult::SkipCell;
+    });
+    targets[sorted_i] = indices[target];
+    r_merge_indices[indices[sorted.points[sorted_i]]] = indices[target];
+  });
+  /* Kept points are only "merged" into themselves when other points are merged into them. */
+  merged.foreach_index([&](const int sorted_i) {
+    r_merge_indices[targets[sorted_i]] = targets[sorted_i];
+  });
+
+  return merged.size();
+}
+
 PointCloud *point_merge_by_distance(const PointCloud &src_points,
                                     const float merge_distance,
                                     const IndexMask &selection,
@@ -26,40 +372,17 @@ PointCloud *point_merge_by_distance(const PointCloud &src_points,
   const Span<float3> positions = src_points.positions();
   const int src_size = positions.size();
 
-  /* Create the KD tree based on only the selected points, to speed up merge detection and
-   * balancing. */
-  KDTree_3d *tree = BLI_kdtree_3d_new(selection.size());
-  selection.foreach_index_optimized<int64_t>(
-      [&](const int64_t i, const int64_t pos) { BLI_kdtree_3d_insert(tree, pos, positions[i]); });
-  BLI_kdtree_3d_balance(tree);
-
-  /* Find the duplicates in the KD tree. Because the tree only contains the selected points, the
-   * resulting indices are indices into the selection, rather than indices of the source point
-   * cloud. */
-  Array<int> selection_merge_indices(selection.size(), -1);
-  const int duplicate_count = BLI_kdtree_3d_calc_duplicates_fast(
-      tree, merge_distance, false, selection_merge_indices.data());
-  BLI_kdtree_3d_free(tree);
+  /* By default, every point is just "merged" with itself. */
+  Array<int> merge_indices(src_size);
+  array_utils::fill_index_range<int>(merge_indices);
+  const int duplicate_count = calc_merge_indices_by_distance(
+      positions, selection, merge_distance, merge_indices);
 
   /* Create the new point cloud and add it to a temporary component for the attribute API. */
   const int dst_size = src_size - duplicate_count;
   PointCloud *dst_pointcloud = BKE_pointcloud_new_nomain(dst_size);
   bke::MutableAttributeAccessor dst_attributes = dst_pointcloud->attributes_for_write();
 
-  /* By default, every point is just "merged" with itself. Then fill in the results of the merge
-   * finding, converting from indices into the selection to indices into the full input point
-   * cloud. */
-  Array<int> merge_indices(src_size);
-  array_utils::fill_index_range<int>(merge_indices);
-
-  selection.foreach_index([&](const int src_index, const int pos) {
-    const int merge_index = selection_merge_indices[pos];
-    if (merge_index != -1) {
-      const int src_merge_index = selection[merge_index];
-      merge_indices[src_index] = src_merge_index;
-    }
-  });
-
   /* For every source index, find the corresponding index in the result by iterating through the
    * source indices and counting how many merges happened before that point. */
   int merged_points = 0;
@@ -8,6 +8,7 @@
 #include "DNA_collection_types.h"
 
 #include "BLI_array_utils.hh"
+#include "BLI_implicit_sharing_ptr.hh"
 #include "BLI_noise.hh"
 
 #include "BKE_curves.hh"
@@ -374,9 +375,7 @@ static void copy_transformed_positions(const Span<float3> src,
   }
   else {
     threading::parallel_for(src.index_range(), 1024, [&](const IndexRange range) {
-      for (const int i : range) {
-        dst[i] = math::transform_point(transform, src[i]);
-      }
+      math::transform_points(transform, src.slice(range), dst.slice(range));
     });
   }
 }
@@ -384,9 +383,7 @@ static void copy_transformed_positions(const Span<float3> src,
 static void transform_positions(const float4x4 &transform, MutableSpan<float3> positions)
 {
   threading::parallel_for(positions.index_range(), 1024, [&](const IndexRange range) {
-    for (const int i : range) {
-      positions[i] = math::transform_point(transform, positions[i]);
-    }
+    math::transform_points(transform, positions.slice(range));
   });
 }
 
@@ -400,9 +397,7 @@ static void copy_transformed_normals(const Span<float3> src,
   }
   else {
     threading::parallel_for(src.index_range(), 1024, [&](const IndexRange range) {
-      for (const int i : range) {
-        dst[i] = normal_transform * src[i];
-      }
+      math::transform_directions(normal_transform, src.slice(range), dst.slice(range));
     });
   }
 }
@@ -1036,9 +1031,7 @@ static void execute_instances_tasks(
     array_utils::gather(handle_map.as_span(), src_handles, all_handles.slice(dst_range));
     array_utils::copy(src_instances.transforms(), all_transforms.slice(dst_range));
 
-    for (blender::float4x4 &transform : all_transforms.slice(dst_range)) {
-      transform = src_base_transform * transform;
-    }
+    math::transform_matrices(src_base_transform, all_transforms.slice(dst_range));
   }
 
   r_realized_geometry.replace_instances(dst_instances.release());
@@ -1448,9 +1441,8 @@ static void execute_realize_mesh_task(const RealizeInstancesOptions &options,
   MutableSpan<int> dst_corner_edges = all_dst_corner_edges.slice(dst_loop_range);
 
   threading::parallel_for(src_positions.index_range(), 1024, [&](const IndexRange vert_range) {
-    for (const int i : vert_range) {
-      dst_positions[i] = math::transform_point(task.transform, src_positions[i]);
-    }
+    math::transform_points(
+        task.transform, src_positions.slice(vert_range), dst_positions.slice(vert_range));
   });
   threading::parallel_for(src_edges.index_range(), 1024, [&](const IndexRange edge_range) {
     for (const int i : edge_range) {
@@ -1527,6 +1519,361 @@ static void execute_realize_mesh_task(const RealizeInstancesOptions &options,
       dst_attribute_writers);
 }
 
+/**
+ * Identifies the state of implicitly shared data without keeping the data alive. The weak user
+ * makes sure that the #ImplicitSharingInfo is not freed and reused for other data while it is
+ * referenced here, so comparing the pointer and the version is enough to detect changes.
+ */
+struct SharedDataState {
+  WeakImplicitSharingPtr sharing_info;
+  int64_t version = 0;
+
+  SharedDataState() = default;
+
+  explicit SharedDataState(const ImplicitSharingInfo *info)
+  {
+    if (info != nullptr) {
+      info->add_weak_user();
+      this->sharing_info = WeakImplicitSharingPtr(info);
+      this->version = info->version();
+    }
+  }
+
+  bool matches(const ImplicitSharingInfo *info) const
+  {
+    return info == this->sharing_info.get() && (info == nullptr || info->version() == version);
+  }
+};
+
+struct CachedMeshLayer {
+  eCustomDataType type;
+  std::string name;
+  SharedDataState data;
+};
+
+/** State of an original mesh that the realized mesh depends on. */
+struct CachedMeshSource {
+  int verts_num = 0;
+  int edges_num = 0;
+  int faces_num = 0;
+  int corners_num = 0;
+  SharedDataState face_offsets;
+  /** Layers of all domains in the order they are stored on the mesh. */
+  Vector<CachedMeshLayer> layers;
+  Vector<Material *> materials;
+  std::optional<std::string> active_color_attribute;
+  std::optional<std::string> default_color_attribute;
+};
+
+struct RealizeInstancesCache::MeshData {
+  /** The previous result. Its arrays are shared with the mesh that was returned. */
+  bke::GeometrySet result;
+
+  bool keep_original_ids = false;
+  bool create_id_attribute = false;
+  bool create_material_index_attribute = false;
+  Vector<std::string> attribute_ids;
+  Vector<AttributeKind> attribute_kinds;
+  Vector<Material *> materials;
+  /** Ordered like #AllMeshesInfo::order. */
+  Vector<CachedMeshSource> sources;
+
+  /** Index of the original mesh of every task. */
+  Array<int> task_sources;
+  Array<uint32_t> task_ids;
+  Array<float4x4> task_transforms;
+  /**
+   * Instance attribute values used as fallback by every task. The order matches
+   * #attribute_ids.
+   */
+  Array<GArray<>> task_fallbacks;
+  Array<Array<bool>> task_has_fallback;
+};
+
+RealizeInstancesCache::RealizeInstancesCache() = default;
+RealizeInstancesCache::~RealizeInstancesCache() = default;
+
+static std::optional<std::string> optional_string(const char *str)
+{
+  if (str == nullptr) {
+    return std::nullopt;
+  }
+  return std::string(str);
+}
+
+static Array<const CustomData *, 4> mesh_custom_data(const Mesh &mesh)
+{
+  return {&mesh.vert_data, &mesh.edge_data, &mesh.face_data, &mesh.corner_data};
+}
+
+static std::optional<CachedMeshSource> cached_mesh_source_from_mesh(const Mesh &mesh)
+{
+  CachedMeshSource source;
+  source.verts_num = mesh.verts_num;
+  source.edges_num = mesh.edges_num;
+  source.faces_num = mesh.faces_num;
+  source.corners_num = mesh.corners_num;
+  if (mesh.face_offset_indices != nullptr && mesh.runtime->face_offsets_sharing_info == nullptr) {
+    /* Changes of data that is not shared can't be detected. */
+    return std::nullopt;
+  }
+  source.face_offsets = SharedDataState(mesh.runtime->face_offsets_sharing_info);
+  for (const CustomData *data : mesh_custom_data(mesh)) {
+    for (const CustomDataLayer &layer : Span(data->layers, data->totlayer)) {
+      if (layer.data != nullptr && layer.sharing_info == nullptr) {
+        return std::nullopt;
+      }
+      source.layers.append(
+          {eCustomDataType(layer.type), layer.name, SharedDataState(layer.sharing_info)});
+    }
+  }
+  source.materials = Span(mesh.mat, mesh.totcol);
+  source.active_color_attribute = optional_string(mesh.active_color_attribute);
+  source.default_color_attribute = optional_string(mesh.default_color_attribute);
+  return source;
+}
+
+static bool cached_mesh_source_matches(const CachedMeshSource &source, const Mesh &mesh)
+{
+  if (source.verts_num != mesh.verts_num || source.edges_num != mesh.edges_num ||
+      source.faces_num != mesh.faces_num || source.corners_num != mesh.corners_num)
+  {
+    return false;
+  }
+  if (!source.face_offsets.matches(mesh.runtime->face_offsets_sharing_info)) {
+    return false;
+  }
+  int layer_index = 0;
+  for (const CustomData *data : mesh_custom_data(mesh)) {
+    for (const CustomDataLayer &layer : Span(data->layers, data->totlayer)) {
+      if (layer_index == source.layers.size()) {
+        return false;
+      }
+      const CachedMeshLayer &cached_layer = source.layers[layer_index];
+      if (cached_layer.type != layer.type || cached_layer.name != layer.name ||
+          !cached_layer.data.matches(layer.sharing_info))
+      {
+        return false;
+      }
+      layer_index++;
+    }
+  }
+  if (layer_index != source.layers.size()) {
+    return false;
+  }
+  return source.materials.as_span() == Span(mesh.mat, mesh.totcol) &&
+         source.active_color_attribute == optional_string(mesh.active_color_attribute) &&
+         source.default_color_attribute == optional_string(mesh.default_color_attribute);
+}
+
+/**
+ * Check whether the cached mesh was realized from the same data, ignoring the transforms of the
+ * tasks.
+ */
+static bool mesh_cache_matches(const RealizeInstancesCache::MeshData &cache,
+                               const RealizeInstancesOptions &options,
+                               const AllMeshesInfo &all_meshes_info,
+                               const Span<RealizeMeshTask> tasks)
+{
+  const OrderedAttributes &ordered_attributes = all_meshes_info.attributes;
+  if (cache.keep_original_ids != options.keep_original_ids ||
+      cache.create_id_attribute != all_meshes_info.create_id_attribute ||
+      cache.create_material_index_attribute != all_meshes_info.create_material_index_attribute)
+  {
+    return false;
+  }
+  if (cache.attribute_ids.size() != ordered_attributes.size()) {
+    return false;
+  }
+  for (const int attribute_index : ordered_attributes.index_range()) {
+    const AttributeKind &kind = ordered_attributes.kinds[attribute_index];
+    const AttributeKind &cached_kind = cache.attribute_kinds[attribute_index];
+    if (StringRef(cache.attribute_ids[attribute_index]) != ordered_attributes.ids[attribute_index] ||
+        cached_kind.domain != kind.domain || cached_kind.data_type != kind.data_type)
+    {
+      return false;
+    }
+  }
+  if (cache.materials.as_span() != all_meshes_info.materials.as_span()) {
+    return false;
+  }
+  if (cache.sources.size() != all_meshes_info.order.size()) {
+    return false;
+  }
+  for (const int mesh_index : all_meshes_info.order.index_range()) {
+    if (!cached_mesh_source_matches(cache.sources[mesh_index],
+                                    *all_meshes_info.order[mesh_index]))
+    {
+      return false;
+    }
+  }
+  if (cache.task_sources.size() != tasks.size()) {
+    return false;
+  }
+  return threading::parallel_reduce(
+      tasks.index_range(),
+      4096,
+      true,
+      [&](const IndexRange range, const bool matches) {
+        if (!matches) {
+          return false;
+        }
+        for (const int task_index : range) {
+          const RealizeMeshTask &task = tasks[task_index];
+          if (cache.task_sources[task_index] !=
+                  task.mesh_info - all_meshes_info.realize_info.data() ||
+              cache.task_ids[task_index] != task.id)
+          {
+            return false;
+          }
+          for (const int attribute_index : ordered_attributes.index_range()) {
+            const void *fallback = task.attribute_fallbacks.array[attribute_index];
+            if (cache.task_has_fallback[attribute_index][task_index] != (fallback != nullptr)) {
+              return false;
+            }
+            if (fallback != nullptr) {
+              const GArray<> &cached_fallbacks = cache.task_fallbacks[attribute_index];
+              if (!cached_fallbacks.type().is_equal_or_false(cached_fallbacks[task_index],
+                                                             fallback))
+              {
+                return false;
+              }
+            }
+          }
+        }
+        return true;
+      },
+      [](const bool a, const bool b) { return a && b; });
+}
+
+static void store_mesh_cache(RealizeInstancesCache &cache,
+                             const RealizeInstancesOptions &options,
+                             const AllMeshesInfo &all_meshes_info,
+                             const Span<RealizeMeshTask> tasks,
+                             const bke::GeometrySet &realized_geometry)
+{
+  cache.mesh.reset();
+  auto data = std::make_unique<RealizeInstancesCache::MeshData>();
+  for (const Mesh *mesh : all_meshes_info.order) {
+    std::optional<CachedMeshSource> source = cached_mesh_source_from_mesh(*mesh);
+    if (!source) {
+      return;
+    }
+    data->sources.append(std::move(*source));
+  }
+
+  const OrderedAttributes &ordered_attributes = all_meshes_info.attributes;
+  data->keep_original_ids = options.keep_original_ids;
+  data->create_id_attribute = all_meshes_info.create_id_attribute;
+  data->create_material_index_attribute = all_meshes_info.create_material_index_attribute;
+  for (const int attribute_index : ordered_attributes.index_range()) {
+    data->attribute_ids.append(ordered_attributes.ids[attribute_index]);
+    data->attribute_kinds.append(ordered_attributes.kinds[attribute_index]);
+  }
+  data->materials = all_meshes_info.materials.as_span();
+
+  data->task_sources.reinitialize(tasks.size());
+  data->task_ids.reinitialize(tasks.size());
+  data->task_transforms.reinitialize(tasks.size());
+  data->task_fallbacks.reinitialize(ordered_attributes.size());
+  data->task_has_fallback.reinitialize(ordered_attributes.size());
+  for (const int attribute_index : ordered_attributes.index_range()) {
+    const CPPType &type = *bke::custom_data_type_to_cpp_type(
+        ordered_attributes.kinds[attribute_index].data_type);
+    data->task_fallbacks[attribute_index] = GArray<>(type, tasks.size());
+    data->task_has_fallback[attribute_index] = Array<bool>(tasks.size(), false);
+  }
+  threading::parallel_for(tasks.index_range(), 4096, [&](const IndexRange range) {
+    for (const int task_index : range) {
+      const RealizeMeshTask &task = tasks[task_index];
+      data->task_sources[task_index] = task.mesh_info - all_meshes_info.realize_info.data();
+      data->task_ids[task_index] = task.id;
+      data->task_transforms[task_index] = task.transform;
+      for (const int attribute_index : ordered_attributes.index_range()) {
+        const void *fallback = task.attribute_fallbacks.array[attribute_index];
+        if (fallback != nullptr) {
+          GArray<> &fallbacks = data->task_fallbacks[attribute_index];
+          fallbacks.type().copy_assign(fallback, fallbacks[task_index]);
+          data->task_has_fallback[attribute_index][task_index] = true;
+        }
+      }
+    }
+  });
+
+  data->result.add(*realized_geometry.get_component<bke::MeshComponent>());
+  cache.mesh = std::move(data);
+}
+
+/** Use the same active and render UV maps as the first mesh. */
+static void copy_uv_map_flags(const Mesh &first_mesh, Mesh &dst_mesh)
+{
+  const char *active_layer = CustomData_get_active_layer_name(&first_mesh.corner_data,
+                                                              CD_PROP_FLOAT2);
+  if (active_layer != nullptr) {
+    int id = CustomData_get_named_layer(&dst_mesh.corner_data, CD_PROP_FLOAT2, active_layer);
+    if (id >= 0) {
+      CustomData_set_layer_active(&dst_mesh.corner_data, CD_PROP_FLOAT2, id);
+    }
+  }
+  const char *render_layer = CustomData_get_render_layer_name(&first_mesh.corner_data,
+                                                              CD_PROP_FLOAT2);
+  if (render_layer != nullptr) {
+    int id = CustomData_get_named_layer(&dst_mesh.corner_data, CD_PROP_FLOAT2, render_layer);
+    if (id >= 0) {
+      CustomData_set_layer_render(&dst_mesh.corner_data, CD_PROP_FLOAT2, id);
+    }
+  }
+}
+
+/**
+ * Reuse the mesh from the previous call if it was realized from the same data. Only the
+ * positions of tasks whose transform changed are computed again, all other arrays stay shared
+ * with the cached mesh.
+ */
+static bool realize_mesh_tasks_from_cache(RealizeInstancesCache::MeshData &cache,
+                                          const RealizeInstancesOptions &options,
+                                          const AllMeshesInfo &all_meshes_info,
+                                          const Span<RealizeMeshTask> tasks,
+                                          bke::GeometrySet &r_realized_geometry)
+{
+  if (!mesh_cache_matches(cache, options, all_meshes_info, tasks)) {
+    return false;
+  }
+
+  IndexMaskMemory memory;
+  const IndexMask changed_tasks = IndexMask::from_predicate(
+      tasks.index_range(), GrainSize(4096), memory, [&](const int64_t task_index) {
+        return cache.task_transforms[task_index] != tasks[task_index].transform;
+      });
+
+  Mesh *dst_mesh = BKE_mesh_copy_for_eval(*cache.result.get_mesh());
+  /* Settings that are not part of the cache key are copied again. */
+  const Mesh &first_mesh = *tasks.first().mesh_info->mesh;
+  BKE_mesh_copy_parameters(dst_mesh, &first_mesh);
+  copy_uv_map_flags(first_mesh, *dst_mesh);
+
+  if (!changed_tasks.is_empty()) {
+    MutableSpan<float3> all_dst_positions = dst_mesh->vert_positions_for_write();
+    changed_tasks.foreach_index(GrainSize(32), [&](const int64_t task_index) {
+      const RealizeMeshTask &task = tasks[task_index];
+      const Span<float3> src_positions = task.mesh_info->positions;
+      MutableSpan<float3> dst_positions = all_dst_positions.slice(task.start_indices.vertex,
+                                                                  src_positions.size());
+      threading::parallel_for(src_positions.index_range(), 1024, [&](const IndexRange range) {
+        math::transform_points(
+            task.transform, src_positions.slice(range), dst_positions.slice(range));
+      });
+      cache.task_transforms[task_index] = task.transform;
+    });
+    dst_mesh->tag_positions_changed();
+  }
+
+  r_realized_geometry.replace_mesh(dst_mesh);
+  cache.result.clear();
+  cache.result.add(*r_realized_geometry.get_component<bke::MeshComponent>());
+  return true;
+}
+
 static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
                                        const AllMeshesInfo &all_meshes_info,
                                        const Span<RealizeMeshTask> tasks,
@@ -1534,6 +1881,11 @@ static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
                                        const VectorSet<Material *> &ordered_materials,
                                        bke::GeometrySet &r_realized_geometry)
 {
+  if (tasks.size() <= 1 && options.cache) {
+    /* Realizing a single mesh does not copy any arrays already. */
+    options.cache->mesh.reset();
+  }
+
   if (tasks.is_empty()) {
     return;
   }
@@ -1551,6 +1903,14 @@ static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
     return;
   }
 
+  if (options.cache && options.cache->mesh) {
+    if (realize_mesh_tasks_from_cache(
+            *options.cache->mesh, options, all_meshes_info, tasks, r_realized_geometry))
+    {
+      return;
+    }
+  }
+
   const RealizeMeshTask &last_task = tasks.last();
   const Mesh &last_mesh = *last_task.mesh_info->mesh;
   const int tot_vertices = last_task.start_indices.vertex + last_mesh.verts_num;
@@ -1603,22 +1963,7 @@ static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
     dst_attribute_writers.append(
         dst_attributes.lookup_or_add_for_write_only_span(attribute_id, domain, data_type));
   }
-  const char *active_layer = CustomData_get_active_layer_name(&first_mesh.corner_data,
-                                                              CD_PROP_FLOAT2);
-  if (active_layer != nullptr) {
-    int id = CustomData_get_named_layer(&dst_mesh->corner_data, CD_PROP_FLOAT2, active_layer);
-    if (id >= 0) {
-      CustomData_set_layer_active(&dst_mesh->corner_data, CD_PROP_FLOAT2, id);
-    }
-  }
-  const char *render_layer = CustomData_get_render_layer_name(&first_mesh.corner_data,
-                                                              CD_PROP_FLOAT2);
-  if (render_layer != nullptr) {
-    int id = CustomData_get_named_layer(&dst_mesh->corner_data, CD_PROP_FLOAT2, render_layer);
-    if (id >= 0) {
-      CustomData_set_layer_render(&dst_mesh->corner_data, CD_PROP_FLOAT2, id);
-    }
-  }
+  copy_uv_map_flags(first_mesh, *dst_mesh);
   /* Actually execute all tasks. */
   threading::parallel_for(tasks.index_range(), 100, [&](const IndexRange task_range) {
     for (const int task_index : task_range) {
@@ -1653,6 +1998,10 @@ static void execute_realize_mesh_tasks(const RealizeInstancesOptions &options,
   if (all_meshes_info.no_overlapping_hint) {
     dst_mesh->tag_overlapping_none();
   }
+
+  if (options.cache) {
+    store_mesh_cache(*options.cache, options, all_meshes_info, tasks, r_realized_geometry);
+  }
 }
 
 /** \} */
@@ -10,6 +10,7 @@
 
 #include "BLI_math_base.h"
 #include "BLI_math_matrix.h"
+#include "BLI_math_matrix.hh"
 #include "BLI_math_vector.hh"
 #include "BLI_task.hh"
 
@@ -41,9 +42,7 @@ static void translate_positions(MutableSpan<float3> positions, const float3 &tra
 static void transform_positions(MutableSpan<float3> positions, const float4x4 &matrix)
 {
   threading::parallel_for(positions.index_range(), 1024, [&](const IndexRange range) {
-    for (float3 &position : positions.slice(range)) {
-      position = math::transform_point(matrix, position);
-    }
+    math::transform_points(matrix, positions.slice(range));
   });
 }
 
@@ -122,9 +121,7 @@ static void transform_instances(bke::Instances &instances, const float4x4 &trans
 {
   MutableSpan<float4x4> transforms = instances.transforms_for_write();
   threading::parallel_for(transforms.index_range(), 1024, [&](const IndexRange range) {
-    for (float4x4 &instance_transform : transforms.slice(range)) {
-      instance_transform = transform * instance_transform;
-    }
+    math::transform_matrices(transform, transforms.slice(range));
   });
 }
 
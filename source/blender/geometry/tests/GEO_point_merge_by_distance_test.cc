@@ -0,0 +1,87 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include "BLI_array.hh"
+#include "BLI_kdtree.h"
+#include "BLI_math_vector.hh"
+#include "BLI_rand.hh"
+
+#include "GEO_point_merge_by_distance.hh"
+
+#include "testing/testing.h"
+
+namespace blender::geometry::tests {
+
+TEST(point_merge_by_distance, Chain)
+{
+  /* Neighbors are closer than the merge distance, but points are never merged into points that
+   * are merged themselves. */
+  const Array<float3> positions = {
+      {0.0f, 0.0f, 0.0f}, {3.0f, 0.0f, 0.0f}, {0.9f, 0.0f, 0.0f}, {1.8f, 0.0f, 0.0f}};
+  Array<int> merge_indices(positions.size(), -1);
+  const int merged_num = calc_merge_indices_by_distance(
+      positions, positions.index_range(), 1.0f, merge_indices);
+  EXPECT_EQ(merged_num, 1);
+  EXPECT_EQ_ARRAY(merge_indices.data(), Span<int>({0, -1, 0, -1}).data(), positions.size());
+}
+
+/** Compare with the serial search of the KD-tree, which visits the points in index order. */
+static void test_matches_kdtree(const Span<float3> positions,
+                                const IndexMask &selection,
+                                const float merge_distance)
+{
+  Array<int> merge_indices(positions.size(), -1);
+  const int merged_num = calc_merge_indices_by_distance(
+      positions, selection, merge_distance, merge_indices);
+
+  KDTree_3d *tree = BLI_kdtree_3d_new(selection.size());
+  selection.foreach_index([&](const int i) {
+    /* The KD-tree doesn't support NaN, which is never merged. */
+    if (!std::isnan(positions[i].x)) {
+      BLI_kdtree_3d_insert(tree, i, positions[i]);
+    }
+  });
+  BLI_kdtree_3d_balance(tree);
+  Array<int> expected_merge_indices(positions.size(), -1);
+  const int expected_merged_num = BLI_kdtree_3d_calc_duplicates_fast(
+      tree, merge_distance, true, expected_merge_indices.data());
+  BLI_kdtree_3d_free(tree);
+
+  EXPECT_EQ(merged_num, expected_merged_num);
+  EXPECT_EQ_ARRAY(merge_indices.data(), expected_merge_indices.data(), positions.size());
+}
+
+TEST(point_merge_by_distance, MatchesKDTree)
+{
+  RandomNumberGenerator rng(0);
+  Array<float3> positions(5000);
+  for (float3 &position : positions) {
+    position = rng.get_unit_float3() * rng.get_float() * 10.0f;
+  }
+  /* Exact duplicates and a point that can't be sorted into a grid cell. */
+  positions[10] = positions[20];
+  positions[30] = float3(std::numeric_limits<float>::quiet_NaN());
+
+  IndexMaskMemory memory;
+  const IndexMask selection = IndexMask::from_predicate(
+      positions.index_range(), GrainSize(1024), memory, [](const int i) { return i % 7 != 0; });
+  test_matches_kdtree(positions, selection, 0.3f);
+  test_matches_kdtree(positions, selection, 2.0f);
+}
+
+TEST(point_merge_by_distance, MatchesKDTreeChains)
+{
+  /* Every point is close to the next, which makes most points depend on the previous ones. */
+  Array<float3> positions(3000);
+  for (const int i : positions.index_range()) {
+    positions[i] = float3(float((i * 7919) % positions.size()) * 0.4f, 0.0f, 0.0f);
+  }
+  test_matches_kdtree(positions, positions.index_range(), 1.0f);
+
+  /* All points are at the same position. */
+  positions.fill(float3(1.0f, 2.0f, 3.0f));
+  test_matches_kdtree(positions, positions.index_range(), 0.001f);
+}
+
+}  // namespace blender::geometry::tests
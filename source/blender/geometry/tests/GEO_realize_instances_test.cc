@@ -0,0 +1,97 @@
+/* SPDX-FileCopyrightText: 2024 Blender Authors
+ *
+ * SPDX-License-Identifier: Apache-2.0 */
+
+#include "BKE_attribute.hh"
+#include "BKE_idtype.hh"
+#include "BKE_instances.hh"
+#include "BKE_mesh.hh"
+
+#include "BLI_math_matrix.hh"
+
+#include "GEO_mesh_primitive_cuboid.hh"
+#include "GEO_realize_instances.hh"
+
+#include "testing/testing.h"
+
+namespace blender::geometry::tests {
+
+static bke::GeometrySet create_cube_instances(const int instances_num)
+{
+  const bke::GeometrySet cube = bke::GeometrySet::from_mesh(
+      create_cuboid_mesh(float3(1.0f), 2, 2, 2));
+  bke::Instances *instances = new bke::Instances();
+  const int handle = instances->add_reference(bke::InstanceReference(cube));
+  for (const int i : IndexRange(instances_num)) {
+    instances->add_instance(handle, math::from_location<float4x4>(float3(i * 2.0f, 0.0f, 0.0f)));
+  }
+  bke::SpanAttributeWriter<float> values =
+      instances->attributes_for_write().lookup_or_add_for_write_span<float>(
+          "value", bke::AttrDomain::Instance);
+  values.span.fill(1.0f);
+  values.finish();
+  return bke::GeometrySet::from_instances(instances);
+}
+
+static void expect_meshes_equal(const Mesh &expected, const Mesh &actual)
+{
+  ASSERT_EQ(expected.verts_num, actual.verts_num);
+  ASSERT_EQ(expected.faces_num, actual.faces_num);
+  ASSERT_EQ(expected.corners_num, actual.corners_num);
+  EXPECT_EQ_ARRAY(
+      expected.vert_positions().data(), actual.vert_positions().data(), expected.verts_num);
+  EXPECT_EQ_ARRAY(
+      expected.corner_verts().data(), actual.corner_verts().data(), expected.corners_num);
+  const VArraySpan<float> expected_values = *expected.attributes().lookup<float>(
+      "value", bke::AttrDomain::Point);
+  const VArraySpan<float> actual_values = *actual.attributes().lookup<float>(
+      "value", bke::AttrDomain::Point);
+  EXPECT_EQ_ARRAY(expected_values.data(), actual_values.data(), expected.verts_num);
+}
+
+TEST(realize_instances, CacheTransformChanged)
+{
+  BKE_idtype_init();
+  bke::GeometrySet geometry = create_cube_instances(10);
+
+  RealizeInstancesCache cache;
+  RealizeInstancesOptions options;
+  options.cache = &cache;
+  const bke::GeometrySet first = realize_instances(geometry, options);
+
+  geometry.get_instances_for_write()->transforms_for_write()[3] = math::from_location<float4x4>(
+      float3(0.0f, 0.0f, 5.0f));
+  const bke::GeometrySet second = realize_instances(geometry, options);
+  const bke::GeometrySet expected = realize_instances(geometry, {});
+  expect_meshes_equal(*expected.get_mesh(), *second.get_mesh());
+
+  /* Topology is passed through from the previous result without copying it. */
+  const Mesh &first_mesh = *first.get_mesh();
+  const Mesh &second_mesh = *second.get_mesh();
+  EXPECT_EQ(first_mesh.corner_verts().data(), second_mesh.corner_verts().data());
+  EXPECT_EQ(first_mesh.face_offsets().data(), second_mesh.face_offsets().data());
+  EXPECT_NE(first_mesh.vert_positions().data(), second_mesh.vert_positions().data());
+  EXPECT_EQ(first_mesh.vert_positions()[0], second_mesh.vert_positions()[0]);
+}
+
+TEST(realize_instances, CacheAttributeChanged)
+{
+  BKE_idtype_init();
+  bke::GeometrySet geometry = create_cube_instances(10);
+
+  RealizeInstancesCache cache;
+  RealizeInstancesOptions options;
+  options.cache = &cache;
+  const bke::GeometrySet first = realize_instances(geometry, options);
+
+  bke::SpanAttributeWriter<float> values =
+      geometry.get_instances_for_write()->attributes_for_write().lookup_for_write_span<float>(
+          "value");
+  values.span[5] = 2.0f;
+  values.finish();
+  const bke::GeometrySet second = realize_instances(geometry, options);
+  const bke::GeometrySet expected = realize_instances(geometry, {});
+  expect_meshes_equal(*expected.get_mesh(), *second.get_mesh());
+}
+
+}  // namespace blender::geometry::tests
@@ -63,6 +63,19 @@ Span<char> PlyReadBuffer::read_line()
 bool PlyReadBuffer::read_bytes(void *dst, size_t size)
 {
   while (size > 0) {
+    if (pos_ == buf_used_ && size >= read_buffer_size_) {
+      /* Nothing is left in the buffer and the request is large,
+       * read directly into the destination to avoid the extra copy. */
+      if (file_ == nullptr || at_eof_) {
+        return false;
+      }
+      const size_t read = fread(dst, 1, size, file_);
+      if (read < size) {
+        at_eof_ = true;
+        return false;
+      }
+      return true;
+    }
     if (pos_ + size > buf_used_) {
       if (!refill_buffer()) {
         return false;
@@ -10,8 +10,10 @@
 #include "ply_data.hh"
 #include "ply_import_buffer.hh"
 
+#include "BLI_array.hh"
 #include "BLI_endian_switch.h"
 #include "BLI_string_ref.hh"
+#include "BLI_task.hh"
 
 #include "fast_float.h"
 
@@ -229,6 +231,147 @@ static const char *parse_row_binary(PlyReadBuffer &file,
   return nullptr;
 }
 
+/**
+ * Decode one property of a block of fixed-size binary rows into floats. The destination is
+ * written with the given stride (in floats), so that it can directly fill vector arrays.
+ */
+template<typename T, bool big_endian>
+static void decode_binary_column(const uint8_t *rows,
+                                 const int row_stride,
+                                 const int offset,
+                                 const IndexRange range,
+                                 const float divisor,
+                                 float *dst,
+                                 const int dst_stride)
+{
+  for (const int64_t i : range) {
+    T value;
+    memcpy(&value, rows + i * row_stride + offset, sizeof(T));
+    if constexpr (big_endian && sizeof(T) > 1) {
+      endian_switch((uint8_t *)&value, sizeof(T));
+    }
+    dst[i * dst_stride] = float(value) / divisor;
+  }
+}
+
+template<bool big_endian>
+static void decode_binary_column(const PlyDataTypes type,
+                                 const uint8_t *rows,
+                                 const int row_stride,
+                                 const int offset,
+                                 const IndexRange range,
+                                 const float divisor,
+                                 float *dst,
+                                 const int dst_stride)
+{
+  switch (type) {
+    case CHAR:
+      decode_binary_column<int8_t, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    case UCHAR:
+      decode_binary_column<uint8_t, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    case SHORT:
+      decode_binary_column<int16_t, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    case USHORT:
+      decode_binary_column<uint16_t, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    case INT:
+      decode_binary_column<int32_t, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    case UINT:
+      decode_binary_column<uint32_t, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    case FLOAT:
+      decode_binary_column<float, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    case DOUBLE:
+      decode_binary_column<double, big_endian>(
+          rows, row_stride, offset, range, divisor, dst, dst_stride);
+      break;
+    default:
+      BLI_assert_msg(false, "Unknown property type");
+  }
+}
+
+/** A property of the vertex element that is decoded into a float array. */
+struct VertexColumn {
+  int property;
+  float divisor;
+  float *dst;
+  int dst_stride;
+};
+
+/**
+ * Binary vertex rows have a fixed size, so large blocks of them are read at once and decoded in
+ * parallel, one property at a time, straight into the destination arrays.
+ */
+static const char *load_vertex_rows_binary(PlyReadBuffer &file,
+                                           const PlyHeader &header,
+                                           const PlyElement &element,
+                                           const Span<VertexColumn> columns)
+{
+  if (element.stride == 0) {
+    return "Vertex/Edge element contains list properties, this is not supported";
+  }
+  if (!ELEM(header.type, PlyFormatType::BINARY_LE, PlyFormatType::BINARY_BE)) {
+    return "Unknown binary ply format for vertex element";
+  }
+  const bool big_endian = header.type == PlyFormatType::BINARY_BE;
+
+  Array<int> offsets(element.properties.size());
+  int offset = 0;
+  for (const int64_t i : element.properties.index_range()) {
+    offsets[i] = offset;
+    offset += data_type_size[element.properties[i].type];
+  }
+
+  const int64_t rows_per_block = std::max<int64_t>(1, (16 * 1024 * 1024) / element.stride);
+  Array<uint8_t> block(std::min<int64_t>(rows_per_block, element.count) * element.stride);
+
+  for (int64_t block_start = 0; block_start < element.count; block_start += rows_per_block) {
+    const int64_t rows_num = std::min<int64_t>(rows_per_block, element.count - block_start);
+    if (!file.read_bytes(block.data(), rows_num * element.stride)) {
+      return "Could not read row of binary property";
+    }
+    threading::parallel_for(IndexRange(rows_num), 8192, [&](const IndexRange range) {
+      for (const VertexColumn &column : columns) {
+        const PlyDataTypes type = element.properties[column.property].type;
+        float *dst = column.dst + block_start * column.dst_stride;
+        if (big_endian) {
+          decode_binary_column<true>(type,
+                                     block.data(),
+                                     element.stride,
+                                     offsets[column.property],
+                                     range,
+                                     column.divisor,
+                                     dst,
+                                     column.dst_stride);
+        }
+        else {
+          decode_binary_column<false>(type,
+                                      block.data(),
+                                      element.stride,
+                                      offsets[column.property],
+                                      range,
+                                      column.divisor,
+                                      dst,
+                                      column.dst_stride);
+        }
+      }
+    });
+  }
+  return nullptr;
+}
+
 static const char *load_vertex_element(PlyReadBuffer &file,
                                        const PlyHeader &header,
                                        const PlyElement &element,
@@ -266,17 +409,6 @@ static const char *load_vertex_element(PlyReadBuffer &file,
     data->vertex_custom_attr.append(attr);
   }
 
-  data->vertices.reserve(element.count);
-  if (has_color) {
-    data->vertex_colors.reserve(element.count);
-  }
-  if (has_normal) {
-    data->vertex_normals.reserve(element.count);
-  }
-  if (has_uv) {
-    data->uv_coordinates.reserve(element.count);
-  }
-
   float4 color_norm = {1, 1, 1, 1};
   if (has_color) {
     color_norm.x = data_type_normalizer[element.properties[color_index.x].type];
@@ -287,21 +419,60 @@ static const char *load_vertex_element(PlyReadBuffer &file,
     color_norm.w = data_type_normalizer[element.properties[alpha_index].type];
   }
 
-  Vector<float> value_vec(element.properties.size());
-  Vector<uint8_t> scratch;
   if (header.type != PlyFormatType::ASCII) {
-    scratch.resize(element.stride);
+    Vector<VertexColumn> columns;
+    data->vertices.resize(element.count);
+    float *positions = reinterpret_cast<float *>(data->vertices.data());
+    for (const int i : IndexRange(3)) {
+      columns.append({vertex_index[i], 1.0f, positions + i, 3});
+    }
+    if (has_color) {
+      /* Alpha defaults to 1 when it's not in the file. */
+      data->vertex_colors.resize(element.count, float4(1.0f));
+      float *colors = reinterpret_cast<float *>(data->vertex_colors.data());
+      for (const int i : IndexRange(3)) {
+        columns.append({color_index[i], color_norm[i], colors + i, 4});
+      }
+      if (has_alpha) {
+        columns.append({alpha_index, color_norm.w, colors + 3, 4});
+      }
+    }
+    if (has_normal) {
+      data->vertex_normals.resize(element.count);
+      float *normals = reinterpret_cast<float *>(data->vertex_normals.data());
+      for (const int i : IndexRange(3)) {
+        columns.append({normal_index[i], 1.0f, normals + i, 3});
+      }
+    }
+    if (has_uv) {
+      data->uv_coordinates.resize(element.count);
+      float *uvs = reinterpret_cast<float *>(data->uv_coordinates.data());
+      for (const int i : IndexRange(2)) {
+        columns.append({uv_index[i], 1.0f, uvs + i, 2});
+      }
+    }
+    for (const int64_t ci : custom_attr_indices.index_range()) {
+      columns.append(
+          {int(custom_attr_indices[ci]), 1.0f, data->vertex_custom_attr[ci].data.data(), 1});
+    }
+    return load_vertex_rows_binary(file, header, element, columns);
   }
 
-  for (int i = 0; i < element.count; i++) {
+  data->vertices.reserve(element.count);
+  if (has_color) {
+    data->vertex_colors.reserve(element.count);
+  }
+  if (has_normal) {
+    data->vertex_normals.reserve(element.count);
+  }
+  if (has_uv) {
+    data->uv_coordinates.reserve(element.count);
+  }
 
-    const char *error = nullptr;
-    if (header.type == PlyFormatType::ASCII) {
-      error = parse_row_ascii(file, value_vec);
-    }
-    else {
-      error = parse_row_binary(file, header, element, scratch, value_vec);
-    }
+  Vector<float> value_vec(element.properties.size());
+
+  for (int i = 0; i < element.count; i++) {
+    const char *error = parse_row_ascii(file, value_vec);
     if (error != nullptr) {
       return error;
     }
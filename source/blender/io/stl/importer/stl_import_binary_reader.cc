@@ -24,7 +24,6 @@ namespace blender::io::stl {
 
 Mesh *read_stl_binary(FILE *file, const bool use_custom_normals)
 {
-  const int chunk_size = 1024;
   uint32_t num_tris = 0;
   fseek(file, BINARY_HEADER_SIZE, SEEK_SET);
   if (fread(&num_tris, sizeof(uint32_t), 1, file) != 1) {
@@ -36,16 +35,12 @@ Mesh *read_stl_binary(FILE *file, const bool use_custom_normals)
     return BKE_mesh_new_nomain(0, 0, 0, 0);
   }
 
-  Array<PackedTriangle> tris_buf(chunk_size);
-  STLMeshHelper stl_mesh(num_tris, use_custom_normals);
-  size_t num_read_tris;
-  while ((num_read_tris = fread(tris_buf.data(), sizeof(PackedTriangle), chunk_size, file))) {
-    for (size_t i = 0; i < num_read_tris; i++) {
-      stl_mesh.add_triangle(tris_buf[i]);
-    }
-  }
+  /* Read the whole triangle block at once, welding happens in parallel afterwards.
+   * Truncated files keep the triangles that could be read. */
+  Array<PackedTriangle> tris(num_tris, NoInitialization());
+  const size_t num_read_tris = fread(tris.data(), sizeof(PackedTriangle), num_tris, file);
 
-  return stl_mesh.to_mesh();
+  return create_mesh_from_triangles(tris.as_span().take_front(num_read_tris), use_custom_normals);
 }
 
 }  // namespace blender::io::stl
@@ -10,8 +10,12 @@
 
 #include "BKE_mesh.hh"
 
+#include "BLI_array.hh"
 #include "BLI_array_utils.hh"
+#include "BLI_index_mask.hh"
+#include "BLI_sort.hh"
 #include "BLI_span.hh"
+#include "BLI_task.hh"
 
 #include "DNA_mesh_types.h"
 
@@ -20,65 +24,181 @@
 
 namespace blender::io::stl {
 
-STLMeshHelper::STLMeshHelper(int tris_num, bool use_custom_normals)
-    : use_custom_normals_(use_custom_normals)
+/**
+ * For every element, find the index of the first element that is equal to it, or itself if
+ * there is none. Elements are grouped by sorting their hashes together with their indices, so
+ * that equal elements end up next to each other in the order of their indices and the groups
+ * can be compared in parallel.
+ */
+template<typename HashFn, typename EqualFn>
+static void find_first_occurrences(const HashFn &hash_fn,
+                                   const EqualFn &is_equal,
+                                   MutableSpan<int> r_first)
 {
-  degenerate_tris_num_ = 0;
-  duplicate_tris_num_ = 0;
-  tris_.reserve(tris_num);
-  /* Upper bound (all vertices are unique). */
-  verts_.reserve(tris_num * 3);
-  if (use_custom_normals) {
-    loop_normals_.reserve(tris_num * 3);
-  }
+  Array<uint64_t> keys(r_first.size());
+  threading::parallel_for(keys.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t i : range) {
+      const uint64_t hash = hash_fn(i);
+      keys[i] = (uint64_t(uint32_t(hash ^ (hash >> 32))) << 32) | uint64_t(i);
+    }
+  });
+  parallel_sort(keys.begin(), keys.end());
+
+  const auto key_hash = [&](const int64_t i) { return uint32_t(keys[i] >> 32); };
+  const auto key_index = [&](const int64_t i) { return int(keys[i] & 0xffffffff); };
+
+  threading::parallel_for(keys.index_range(), 4096, [&](const IndexRange range) {
+    /* Only handle the groups of equal hashes that start in this range. */
+    int64_t group_start = range.start();
+    while (group_start > 0 && group_start < range.one_after_last() &&
+           key_hash(group_start) == key_hash(group_start - 1))
+    {
+      group_start++;
+    }
+    while (group_start < range.one_after_last()) {
+      int64_t group_end = group_start + 1;
+      while (group_end < keys.size() && key_hash(group_end) == key_hash(group_start)) {
+        group_end++;
+      }
+      for (const int64_t i : IndexRange::from_begin_end(group_start, group_end)) {
+        const int index = key_index(i);
+        r_first[index] = index;
+        for (const int64_t j : IndexRange::from_begin_end(group_start, i)) {
+          const int other = key_index(j);
+          if (r_first[other] == other && is_equal(other, index)) {
+            r_first[index] = other;
+            break;
+          }
+        }
+      }
+      group_start = group_end;
+    }
+  });
 }
 
-bool STLMeshHelper::add_triangle(const PackedTriangle &data)
+/** Hash that is the same for all positions that compare equal, including signed zeros. */
+static uint64_t position_hash(float3 position)
 {
-  int v1_id = verts_.index_of_or_add(data.vertices[0]);
-  int v2_id = verts_.index_of_or_add(data.vertices[1]);
-  int v3_id = verts_.index_of_or_add(data.vertices[2]);
-  if ((v1_id == v2_id) || (v1_id == v3_id) || (v2_id == v3_id)) {
-    degenerate_tris_num_++;
-    return false;
-  }
-  if (!tris_.add({v1_id, v2_id, v3_id})) {
-    duplicate_tris_num_++;
-    return false;
+  for (const int i : IndexRange(3)) {
+    if (position[i] == 0.0f) {
+      position[i] = 0.0f;
+    }
   }
-
-  if (use_custom_normals_) {
-    loop_normals_.append_n_times(data.normal, 3);
-  }
-  return true;
+  return position.hash();
 }
 
-Mesh *STLMeshHelper::to_mesh()
+Mesh *create_mesh_from_triangles(const Span<PackedTriangle> tris, const bool use_custom_normals)
 {
-  if (degenerate_tris_num_ > 0) {
-    std::cout << "STL Importer: " << degenerate_tris_num_ << " degenerate triangles were removed"
+  const auto corner_position = [&](const int64_t corner) -> const float3 & {
+    return tris[corner / 3].vertices[corner % 3];
+  };
+
+  /* Weld vertices. */
+  Array<int> first_corner(tris.size() * 3);
+  find_first_occurrences(
+      [&](const int64_t corner) { return position_hash(corner_position(corner)); },
+      [&](const int64_t a, const int64_t b) { return corner_position(a) == corner_position(b); },
+      first_corner);
+
+  /* Vertices are numbered in the order of their first occurrence. */
+  Array<int> corner_to_vert(first_corner.size());
+  int verts_num = 0;
+  for (const int64_t corner : first_corner.index_range()) {
+    if (first_corner[corner] == corner) {
+      corner_to_vert[corner] = verts_num++;
+    }
+  }
+  threading::parallel_for(first_corner.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t corner : range) {
+      if (first_corner[corner] != corner) {
+        corner_to_vert[corner] = corner_to_vert[first_corner[corner]];
+      }
+    }
+  });
+
+  IndexMaskMemory memory;
+  const IndexMask valid_tris = IndexMask::from_predicate(
+      tris.index_range(), GrainSize(4096), memory, [&](const int64_t tri) {
+        const int v1 = corner_to_vert[tri * 3 + 0];
+        const int v2 = corner_to_vert[tri * 3 + 1];
+        const int v3 = corner_to_vert[tri * 3 + 2];
+        return (v1 != v2) && (v1 != v3) && (v2 != v3);
+      });
+  Array<int> valid_tri_indices(valid_tris.size());
+  valid_tris.to_indices<int>(valid_tri_indices);
+  Array<Triangle> valid_tri_verts(valid_tris.size());
+  valid_tris.foreach_index(GrainSize(4096), [&](const int tri, const int pos) {
+    valid_tri_verts[pos] = {
+        corner_to_vert[tri * 3 + 0], corner_to_vert[tri * 3 + 1], corner_to_vert[tri * 3 + 2]};
+  });
+
+  /* Remove duplicate triangles, regardless of their winding. */
+  Array<int> first_tri(valid_tri_verts.size());
+  find_first_occurrences([&](const int64_t i) { return valid_tri_verts[i].hash(); },
+                         [&](const int64_t a, const int64_t b) {
+                           return valid_tri_verts[a] == valid_tri_verts[b];
+                         },
+                         first_tri);
+  const IndexMask unique_tris = IndexMask::from_predicate(
+      valid_tri_verts.index_range(), GrainSize(4096), memory, [&](const int64_t i) {
+        return first_tri[i] == i;
+      });
+
+  const int64_t degenerate_tris_num = tris.size() - valid_tris.size();
+  const int64_t duplicate_tris_num = valid_tris.size() - unique_tris.size();
+  if (degenerate_tris_num > 0) {
+    std::cout << "STL Importer: " << degenerate_tris_num << " degenerate triangles were removed"
               << std::endl;
   }
-  if (duplicate_tris_num_ > 0) {
-    std::cout << "STL Importer: " << duplicate_tris_num_ << " duplicate triangles were removed"
+  if (duplicate_tris_num > 0) {
+    std::cout << "STL Importer: " << duplicate_tris_num << " duplicate triangles were removed"
               << std::endl;
   }
 
-  Mesh *mesh = BKE_mesh_new_nomain(verts_.size(), 0, tris_.size(), tris_.size() * 3);
-  mesh->vert_positions_for_write().copy_from(verts_);
+  Mesh *mesh = BKE_mesh_new_nomain(verts_num, 0, unique_tris.size(), unique_tris.size() * 3);
+  MutableSpan<float3> positions = mesh->vert_positions_for_write();
+  threading::parallel_for(first_corner.index_range(), 4096, [&](const IndexRange range) {
+    for (const int64_t corner : range) {
+      if (first_corner[corner] == corner) {
+        positions[corner_to_vert[corner]] = corner_position(corner);
+      }
+    }
+  });
   offset_indices::fill_constant_group_size(3, 0, mesh->face_offsets_for_write());
-  array_utils::copy(tris_.as_span().cast<int>(), mesh->corner_verts_for_write());
+  MutableSpan<Triangle> corner_verts = mesh->corner_verts_for_write().cast<Triangle>();
+  array_utils::gather(valid_tri_verts.as_span(), unique_tris, corner_verts);
 
   bke::mesh_smooth_set(*mesh, false);
 
   /* NOTE: edges must be calculated first before setting custom normals. */
   bke::mesh_calc_edges(*mesh, false, false);
 
-  if (use_custom_normals_ && loop_normals_.size() == mesh->corners_num) {
-    BKE_mesh_set_custom_normals(mesh, reinterpret_cast<float(*)[3]>(loop_normals_.data()));
+  if (use_custom_normals) {
+    Array<float3> corner_normals(mesh->corners_num);
+    unique_tris.foreach_index(GrainSize(4096), [&](const int i, const int pos) {
+      const float3 &normal = tris[valid_tri_indices[i]].normal;
+      corner_normals.as_mutable_span().slice(pos * 3, 3).fill(normal);
+    });
+    BKE_mesh_set_custom_normals(mesh, reinterpret_cast<float(*)[3]>(corner_normals.data()));
   }
 
   return mesh;
 }
 
+STLMeshHelper::STLMeshHelper(int tris_num, bool use_custom_normals)
+    : use_custom_normals_(use_custom_normals)
+{
+  tris_.reserve(tris_num);
+}
+
+void STLMeshHelper::add_triangle(const PackedTriangle &data)
+{
+  tris_.append(data);
+}
+
+Mesh *STLMeshHelper::to_mesh()
+{
+  return create_mesh_from_triangles(tris_, use_custom_normals_);
+}
+
 }  // namespace blender::io::stl
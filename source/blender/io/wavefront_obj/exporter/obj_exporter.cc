@@ -8,6 +8,7 @@
 
 #include <cstdio>
 #include <memory>
+#include <mutex>
 #include <system_error>
 
 #include "BKE_context.hh"
@@ -159,7 +160,7 @@ static void write_mesh_objects(const Span<std::unique_ptr<OBJMesh>> exportable_a
 {
   /* Parallelization is over meshes/objects, which means
    * we have to have the output text buffer for each object,
-   * and write them all into the file at the end. */
+   * and write them into the file in order. */
   size_t count = exportable_as_mesh.size();
   Array<FormatHandler> buffers(count);
 
@@ -204,6 +205,39 @@ static void write_mesh_objects(const Span<std::unique_ptr<OBJMesh>> exportable_a
     offsets.normal_offset += obj.get_normal_coords().size();
   }
 
+  /* Object text buffers are written into the output file as soon as the object and all the ones
+   * before it are formatted. This overlaps file writing with formatting the remaining objects,
+   * and frees each buffer as early as possible. Only one thread writes at a time, and it does so
+   * outside of the lock: the other threads only hand over their buffer and continue formatting. */
+  FILE *f = obj_writer.get_outfile();
+  std::mutex flush_mutex;
+  Array<bool> is_formatted(count, false);
+  size_t next_to_flush = 0;
+  bool is_flushing = false;
+  auto flush_formatted = [&](const int formatted_index) {
+    std::unique_lock lock(flush_mutex);
+    is_formatted[formatted_index] = true;
+    if (is_flushing) {
+      /* The writing thread picks this buffer up once all the ones before it are written. */
+      return;
+    }
+    is_flushing = true;
+    while (next_to_flush < count && is_formatted[next_to_flush]) {
+      const size_t flush_start = next_to_flush;
+      size_t flush_end = flush_start + 1;
+      while (flush_end < count && is_formatted[flush_end]) {
+        flush_end++;
+      }
+      lock.unlock();
+      for (size_t j = flush_start; j < flush_end; j++) {
+        buffers[j].write_to_file(f);
+      }
+      lock.lock();
+      next_to_flush = flush_end;
+    }
+    is_flushing = false;
+  };
+
   /* Parallel over meshes: main result writing. */
   threading::parallel_for(IndexRange(count), 1, [&](IndexRange range) {
     for (const int i : range) {
@@ -242,14 +276,11 @@ static void write_mesh_objects(const Span<std::unique_ptr<OBJMesh>> exportable_a
       /* Nothing will need this object's data after this point, release
        * various arrays here. */
       obj.clear();
+
+      flush_formatted(i);
     }
   });
-
-  /* Write all the object text buffers into the output file. */
-  FILE *f = obj_writer.get_outfile();
-  for (auto &b : buffers) {
-    b.write_to_file(f);
-  }
+  BLI_assert(next_to_flush == count);
 }
 
 /**
@@ -14,6 +14,7 @@
 #include "BLI_math_vector_types.hh"
 #include "BLI_string.h"
 #include "BLI_string_ref.hh"
+#include "BLI_task.hh"
 #include "BLI_vector.hh"
 
 #include "obj_export_mtl.hh"
@@ -202,10 +203,28 @@ static void geom_add_polyline(Geometry *geom,
   }
 }
 
+/**
+ * Amount of vertex positions, UVs and normals defined before some point in the file.
+ * This is all that face parsing needs to know about the global vertex data, which lets
+ * faces be parsed before the preceding vertex lines have been processed.
+ */
+struct VertexCounts {
+  int64_t vertices = 0;
+  int64_t uv_vertices = 0;
+  int64_t vert_normals = 0;
+};
+
+static VertexCounts vertex_counts(const GlobalVertices &global_vertices)
+{
+  return {global_vertices.vertices.size(),
+          global_vertices.uv_vertices.size(),
+          global_vertices.vert_normals.size()};
+}
+
 static void geom_add_polygon(Geometry *geom,
                              const char *p,
                              const char *end,
-                             const GlobalVertices &global_vertices,
+                             const VertexCounts &counts,
                              const int material_index,
                              const int group_index,
                              const bool shaded_smooth)
@@ -250,42 +269,38 @@ static void geom_add_polygon(Geometry *geom,
       }
     }
     /* Always keep stored indices non-negative and zero-based. */
-    corner.vert_index += corner.vert_index < 0 ? global_vertices.vertices.size() : -1;
-    if (corner.vert_index < 0 || corner.vert_index >= global_vertices.vertices.size()) {
+    corner.vert_index += corner.vert_index < 0 ? counts.vertices : -1;
+    if (corner.vert_index < 0 || corner.vert_index >= counts.vertices) {
       fprintf(stderr,
               "Invalid vertex index %i (valid range [0, %zu)), ignoring face\n",
               corner.vert_index,
-              size_t(global_vertices.vertices.size()));
+              size_t(counts.vertices));
       face_valid = false;
     }
     else {
       geom->track_vertex_index(corner.vert_index);
     }
     /* Ignore UV index, if the geometry does not have any UVs (#103212). */
-    if (got_uv && !global_vertices.uv_vertices.is_empty()) {
-      corner.uv_vert_index += corner.uv_vert_index < 0 ? global_vertices.uv_vertices.size() : -1;
-      if (corner.uv_vert_index < 0 || corner.uv_vert_index >= global_vertices.uv_vertices.size()) {
+    if (got_uv && counts.uv_vertices != 0) {
+      corner.uv_vert_index += corner.uv_vert_index < 0 ? counts.uv_vertices : -1;
+      if (corner.uv_vert_index < 0 || corner.uv_vert_index >= counts.uv_vertices) {
         fprintf(stderr,
                 "Invalid UV index %i (valid range [0, %zu)), ignoring face\n",
                 corner.uv_vert_index,
-                size_t(global_vertices.uv_vertices.size()));
+                size_t(counts.uv_vertices));
         face_valid = false;
       }
     }
     /* Ignore corner normal index, if the geometry does not have any normals.
      * Some obj files out there do have face definitions that refer to normal indices,
      * without any normals being present (#98782). */
-    if (got_normal && !global_vertices.vert_normals.is_empty()) {
-      corner.vertex_normal_index += corner.vertex_normal_index < 0 ?
-                                        global_vertices.vert_normals.size() :
-                                        -1;
-      if (corner.vertex_normal_index < 0 ||
-          corner.vertex_normal_index >= global_vertices.vert_normals.size())
-      {
+    if (got_normal && counts.vert_normals != 0) {
+      corner.vertex_normal_index += corner.vertex_normal_index < 0 ? counts.vert_normals : -1;
+      if (corner.vertex_normal_index < 0 || corner.vertex_normal_index >= counts.vert_normals) {
         fprintf(stderr,
                 "Invalid normal index %i (valid range [0, %zu)), ignoring face\n",
                 corner.vertex_normal_index,
-                size_t(global_vertices.vert_normals.size()));
+                size_t(counts.vert_normals));
         face_valid = false;
       }
     }
@@ -477,6 +492,193 @@ static void use_all_vertices_if_no_faces(Geometry *geom,
   }
 }
 
+/**
+ * A line-aligned part of the read buffer. Lines that only add vertex data (`v`, `vn`, `vt`)
+ * or only add faces do not depend on the parser state (current object, material, group),
+ * so chunks consisting of just one of those kinds are parsed on multiple threads.
+ * All other chunks are parsed serially, in file order, while the results are merged.
+ */
+struct ParseChunk {
+  enum class Type {
+    VertexData,
+    Faces,
+    Mixed,
+  };
+
+  StringRef text;
+  Type type = Type::Mixed;
+  int64_t line_count = 0;
+  int64_t face_line_count = 0;
+  /** Amount of each element added by the chunk, used to offset the following chunks. */
+  VertexCounts added;
+  /** Global vertex data of the chunk, for #Type::VertexData chunks. */
+  GlobalVertices vertices;
+  /** Faces of the chunk with final vertex indices, for #Type::Faces chunks. */
+  Geometry faces;
+};
+
+/**
+ * Target size of the chunks that a read buffer is split into. Big enough to make the
+ * threading overhead negligible, small enough to have enough tasks for many threads.
+ */
+static constexpr int64_t parse_chunk_size = 64 * 1024;
+
+static void split_into_chunks(const StringRef buffer_str, Vector<ParseChunk> &r_chunks)
+{
+  int64_t start = 0;
+  while (start < buffer_str.size()) {
+    int64_t end = std::min(start + parse_chunk_size, buffer_str.size());
+    /* The buffer always ends with a newline. */
+    const int64_t newline = buffer_str.find('\n', end - 1);
+    end = newline == StringRef::not_found ? buffer_str.size() : newline + 1;
+    r_chunks.append_as();
+    r_chunks.last().text = buffer_str.substr(start, end - start);
+    start = end;
+  }
+}
+
+/**
+ * Count the lines of the chunk that add elements and find out if it can be parsed
+ * independently from the rest of the file.
+ */
+static void classify_chunk(ParseChunk &chunk)
+{
+  bool has_other_lines = false;
+  StringRef text = chunk.text;
+  while (!text.is_empty()) {
+    StringRef line = read_next_line(text);
+    const char *p = line.begin(), *end = line.end();
+    p = drop_whitespace(p, end);
+    chunk.line_count++;
+    if (p == end) {
+      continue;
+    }
+    if (*p == 'v') {
+      if (parse_keyword(p, end, "v")) {
+        chunk.added.vertices++;
+      }
+      else if (parse_keyword(p, end, "vn")) {
+        chunk.added.vert_normals++;
+      }
+      else if (parse_keyword(p, end, "vt")) {
+        chunk.added.uv_vertices++;
+      }
+    }
+    else if (parse_keyword(p, end, "f")) {
+      chunk.face_line_count++;
+    }
+    else if (*p == '#' && !parse_keyword(p, end, "#MRGB")) {
+      /* Comments don't affect anything. */
+    }
+    else {
+      has_other_lines = true;
+    }
+  }
+
+  const bool has_vertex_data = chunk.added.vertices != 0 || chunk.added.uv_vertices != 0 ||
+                               chunk.added.vert_normals != 0;
+  if (has_other_lines || (has_vertex_data && chunk.face_line_count != 0)) {
+    chunk.type = ParseChunk::Type::Mixed;
+  }
+  else if (chunk.face_line_count != 0) {
+    chunk.type = ParseChunk::Type::Faces;
+  }
+  else {
+    chunk.type = ParseChunk::Type::VertexData;
+  }
+}
+
+static void parse_vertex_data_chunk(ParseChunk &chunk)
+{
+  GlobalVertices &vertices = chunk.vertices;
+  vertices.vertices.reserve(chunk.added.vertices);
+  vertices.uv_vertices.reserve(chunk.added.uv_vertices);
+  vertices.vert_normals.reserve(chunk.added.vert_normals);
+  StringRef text = chunk.text;
+  while (!text.is_empty()) {
+    StringRef line = read_next_line(text);
+    const char *p = line.begin(), *end = line.end();
+    p = drop_whitespace(p, end);
+    if (p == end || *p != 'v') {
+      continue;
+    }
+    if (parse_keyword(p, end, "v")) {
+      geom_add_vertex(p, end, vertices);
+    }
+    else if (parse_keyword(p, end, "vn")) {
+      geom_add_vertex_normal(p, end, vertices);
+    }
+    else if (parse_keyword(p, end, "vt")) {
+      geom_add_uv_vertex(p, end, vertices);
+    }
+  }
+}
+
+/**
+ * Parse the faces of the chunk, with the material, group and smooth state left at their
+ * defaults. Those are assigned when merging, once the state at the chunk is known.
+ */
+static void parse_faces_chunk(ParseChunk &chunk, const VertexCounts &counts)
+{
+  Geometry &faces = chunk.faces;
+  faces.face_elements_.reserve(chunk.face_line_count);
+  StringRef text = chunk.text;
+  while (!text.is_empty()) {
+    StringRef line = read_next_line(text);
+    const char *p = line.begin(), *end = line.end();
+    p = drop_whitespace(p, end);
+    if (parse_keyword(p, end, "f")) {
+      geom_add_polygon(&faces, p, end, counts, -1, -1, false);
+    }
+  }
+}
+
+static void merge_vertex_data_chunk(ParseChunk &chunk, GlobalVertices &r_global_vertices)
+{
+  const GlobalVertices &vertices = chunk.vertices;
+  if (!vertices.vertices.is_empty()) {
+    r_global_vertices.flush_mrgb_block();
+    const int64_t offset = r_global_vertices.vertices.size();
+    r_global_vertices.vertices.extend(vertices.vertices);
+    for (const int64_t i : vertices.vertex_colors.index_range()) {
+      if (vertices.has_vertex_color(i)) {
+        r_global_vertices.set_vertex_color(offset + i, vertices.vertex_colors[i]);
+      }
+    }
+  }
+  r_global_vertices.uv_vertices.extend(vertices.uv_vertices);
+  r_global_vertices.vert_normals.extend(vertices.vert_normals);
+  chunk.vertices = {};
+}
+
+static void merge_faces_chunk(ParseChunk &chunk,
+                              const int material_index,
+                              const int group_index,
+                              const bool shaded_smooth,
+                              Geometry *geom)
+{
+  Geometry &faces = chunk.faces;
+  const int corner_offset = geom->face_corners_.size();
+  geom->face_corners_.extend(faces.face_corners_);
+  geom->face_elements_.reserve(geom->face_elements_.size() + faces.face_elements_.size());
+  for (FaceElem face : faces.face_elements_) {
+    face.start_index_ += corner_offset;
+    face.material_index = material_index;
+    face.vertex_group_index = group_index;
+    face.shaded_smooth = shaded_smooth;
+    geom->face_elements_.append(face);
+  }
+  geom->total_corner_ += faces.total_corner_;
+  geom->has_invalid_faces_ |= faces.has_invalid_faces_;
+  if (group_index >= 0) {
+    geom->has_vertex_groups_ = true;
+  }
+  for (const int vertex_index : faces.vertices_) {
+    geom->track_vertex_index(vertex_index);
+  }
+  chunk.faces = {};
+}
+
 void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
                       GlobalVertices &r_global_vertices)
 {
@@ -499,58 +701,22 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
   string state_material_name;
   int state_material_index = -1;
 
-  /* Read the input file in chunks. We need up to twice the possible chunk size,
-   * to possibly store remainder of the previous input line that got broken mid-chunk. */
-  Array<char> buffer(read_buffer_size_ * 2);
-
-  size_t buffer_offset = 0;
   size_t line_number = 0;
-  while (true) {
-    /* Read a chunk of input from the file. */
-    size_t bytes_read = fread(buffer.data() + buffer_offset, 1, read_buffer_size_, obj_file_);
-    if (bytes_read == 0 && buffer_offset == 0) {
-      break; /* No more data to read. */
-    }
-
-    /* Take care of line continuations now (turn them into spaces);
-     * the rest of the parsing code does not need to worry about them anymore. */
-    fixup_line_continuations(buffer.data() + buffer_offset,
-                             buffer.data() + buffer_offset + bytes_read);
-
-    /* Ensure buffer ends in a newline. */
-    if (bytes_read < read_buffer_size_) {
-      if (bytes_read == 0 || buffer[buffer_offset + bytes_read - 1] != '\n') {
-        buffer[buffer_offset + bytes_read] = '\n';
-        bytes_read++;
-      }
-    }
-
-    size_t buffer_end = buffer_offset + bytes_read;
-    if (buffer_end == 0) {
-      break;
-    }
 
-    /* Find last newline. */
-    size_t last_nl = buffer_end;
-    while (last_nl > 0) {
-      --last_nl;
-      if (buffer[last_nl] == '\n') {
-        break;
-      }
-    }
-    if (buffer[last_nl] != '\n') {
-      /* Whole line did not fit into our read buffer. Warn and exit. */
-      fprintf(stderr,
-              "OBJ file contains a line #%zu that is too long (max. length %zu)\n",
-              line_number,
-              read_buffer_size_);
-      break;
+  /* If we don't have a material index assigned yet, get one.
+   * It means "usemtl" state came from the previous object. */
+  auto ensure_material_index = [&]() {
+    if (state_material_index == -1 && !state_material_name.empty() &&
+        curr_geom->material_indices_.is_empty())
+    {
+      curr_geom->material_indices_.add_new(state_material_name, 0);
+      curr_geom->material_order_.append(state_material_name);
+      state_material_index = 0;
     }
-    ++last_nl;
+  };
 
-    /* Parse the buffer (until last newline) that we have so far,
-     * line by line. */
-    StringRef buffer_str{buffer.data(), int64_t(last_nl)};
+  /* Parse the given text line by line, updating the parser state. */
+  auto parse_lines = [&](StringRef buffer_str) {
     while (!buffer_str.is_empty()) {
       StringRef line = read_next_line(buffer_str);
       const char *p = line.begin(), *end = line.end();
@@ -573,20 +739,11 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
       }
       /* Faces. */
       else if (parse_keyword(p, end, "f")) {
-        /* If we don't have a material index assigned yet, get one.
-         * It means "usemtl" state came from the previous object. */
-        if (state_material_index == -1 && !state_material_name.empty() &&
-            curr_geom->material_indices_.is_empty())
-        {
-          curr_geom->material_indices_.add_new(state_material_name, 0);
-          curr_geom->material_order_.append(state_material_name);
-          state_material_index = 0;
-        }
-
+        ensure_material_index();
         geom_add_polygon(curr_geom,
                          p,
                          end,
-                         r_global_vertices,
+                         vertex_counts(r_global_vertices),
                          state_material_index,
                          state_group_index,
                          state_shaded_smooth);
@@ -671,6 +828,107 @@ void OBJParser::parse(Vector<std::unique_ptr<Geometry>> &r_all_geometries,
         std::cout << "OBJ element not recognized: '" << std::string(p, end) << "'" << std::endl;
       }
     }
+  };
+
+  /* Read the input file in chunks. We need up to twice the possible chunk size,
+   * to possibly store remainder of the previous input line that got broken mid-chunk. */
+  Array<char> buffer(read_buffer_size_ * 2);
+
+  size_t buffer_offset = 0;
+  Vector<ParseChunk> chunks;
+  while (true) {
+    /* Read a chunk of input from the file. */
+    size_t bytes_read = fread(buffer.data() + buffer_offset, 1, read_buffer_size_, obj_file_);
+    if (bytes_read == 0 && buffer_offset == 0) {
+      break; /* No more data to read. */
+    }
+
+    /* Take care of line continuations now (turn them into spaces);
+     * the rest of the parsing code does not need to worry about them anymore. */
+    fixup_line_continuations(buffer.data() + buffer_offset,
+                             buffer.data() + buffer_offset + bytes_read);
+
+    /* Ensure buffer ends in a newline. */
+    if (bytes_read < read_buffer_size_) {
+      if (bytes_read == 0 || buffer[buffer_offset + bytes_read - 1] != '\n') {
+        buffer[buffer_offset + bytes_read] = '\n';
+        bytes_read++;
+      }
+    }
+
+    size_t buffer_end = buffer_offset + bytes_read;
+    if (buffer_end == 0) {
+      break;
+    }
+
+    /* Find last newline. */
+    size_t last_nl = buffer_end;
+    while (last_nl > 0) {
+      --last_nl;
+      if (buffer[last_nl] == '\n') {
+        break;
+      }
+    }
+    if (buffer[last_nl] != '\n') {
+      /* Whole line did not fit into our read buffer. Warn and exit. */
+      fprintf(stderr,
+              "OBJ file contains a line #%zu that is too long (max. length %zu)\n",
+              line_number,
+              read_buffer_size_);
+      break;
+    }
+    ++last_nl;
+
+    /* Parse the buffer (until last newline) that we have so far. Split it into chunks
+     * and parse the ones that don't depend on the parser state in parallel first. */
+    StringRef buffer_str{buffer.data(), int64_t(last_nl)};
+    chunks.clear();
+    split_into_chunks(buffer_str, chunks);
+    threading::parallel_for(chunks.index_range(), 1, [&](const IndexRange range) {
+      for (ParseChunk &chunk : chunks.as_mutable_span().slice(range)) {
+        classify_chunk(chunk);
+        if (chunk.type == ParseChunk::Type::VertexData) {
+          parse_vertex_data_chunk(chunk);
+        }
+      }
+    });
+
+    /* Faces need the amount of vertex data defined before them to resolve relative indices,
+     * which is known for each chunk now. */
+    Array<VertexCounts> counts_before(chunks.size());
+    VertexCounts counts = vertex_counts(r_global_vertices);
+    for (const int64_t i : chunks.index_range()) {
+      counts_before[i] = counts;
+      counts.vertices += chunks[i].added.vertices;
+      counts.uv_vertices += chunks[i].added.uv_vertices;
+      counts.vert_normals += chunks[i].added.vert_normals;
+    }
+    threading::parallel_for(chunks.index_range(), 1, [&](const IndexRange range) {
+      for (const int64_t i : range) {
+        if (chunks[i].type == ParseChunk::Type::Faces) {
+          parse_faces_chunk(chunks[i], counts_before[i]);
+        }
+      }
+    });
+
+    /* Merge the results in file order, parsing the remaining chunks on the way. */
+    for (ParseChunk &chunk : chunks) {
+      switch (chunk.type) {
+        case ParseChunk::Type::VertexData:
+          merge_vertex_data_chunk(chunk, r_global_vertices);
+          line_number += chunk.line_count;
+          break;
+        case ParseChunk::Type::Faces:
+          ensure_material_index();
+          merge_faces_chunk(
+              chunk, state_material_index, state_group_index, state_shaded_smooth, curr_geom);
+          line_number += chunk.line_count;
+          break;
+        case ParseChunk::Type::Mixed:
+          parse_lines(chunk.text);
+          break;
+      }
+    }
 
     /* We might have a line that was cut in the middle by the previous buffer;
      * copy it over for next chunk reading. */
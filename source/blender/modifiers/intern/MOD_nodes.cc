@@ -1017,7 +1017,7 @@ static void ensure_bake_loaded(bake::NodeBakeCache &bake_cache, bake::FrameCache
   if (!meta_path) {
     return;
   }
-  bake::DiskBlobReader blob_reader{*bake_cache.blobs_dir};
+  bake::MappedDiskBlobReader blob_reader{*bake_cache.blobs_dir};
   fstream meta_file{*meta_path};
   std::optional<bake::BakeState> bake_state = bake::deserialize_bake(
       meta_file, blob_reader, *bake_cache.blob_sharing);
@@ -1758,6 +1758,18 @@ static void add_data_block_items_writeback(const ModifierEvalContext &ctx,
       });
 }
 
+/**
+ * The node caches are stored in the generic modifier runtime data, which is preserved for the
+ * evaluated modifier when the object is copied for evaluation again.
+ */
+static nodes::GeoNodesModifierNodeCaches *ensure_node_caches(NodesModifierData &nmd)
+{
+  if (nmd.modifier.runtime == nullptr) {
+    nmd.modifier.runtime = MEM_new<nodes::GeoNodesModifierNodeCaches>(__func__);
+  }
+  return static_cast<nodes::GeoNodesModifierNodeCaches *>(nmd.modifier.runtime);
+}
+
 static void modifyGeometry(ModifierData *md,
                            const ModifierEvalContext *ctx,
                            bke::GeometrySet &geometry_set)
@@ -1817,6 +1829,7 @@ static void modifyGeometry(ModifierData *md,
   nodes::GeoNodesModifierData modifier_eval_data{};
   modifier_eval_data.depsgraph = ctx->depsgraph;
   modifier_eval_data.self_object = ctx->object;
+  modifier_eval_data.node_caches = ensure_node_caches(*nmd);
   auto eval_log = std::make_unique<geo_log::GeoModifierLog>();
   call_data.modifier_data = &modifier_eval_data;
 
@@ -1844,6 +1857,7 @@ static void modifyGeometry(ModifierData *md,
                                                            modifier_compute_context,
                                                            call_data,
                                                            std::move(geometry_set));
+  modifier_eval_data.node_caches->remove_unused();
 
   if (logging_enabled(ctx)) {
     nmd_orig->runtime->eval_log = std::move(eval_log);
@@ -2745,6 +2759,11 @@ void nodes_modifier_packed_bake_free(NodesModifierPackedBake *packed_bake)
   MEM_SAFE_FREE(packed_bake);
 }
 
+static void free_runtime_data(void *runtime_data_v)
+{
+  MEM_delete(static_cast<nodes::GeoNodesModifierNodeCaches *>(runtime_data_v));
+}
+
 static void free_data(ModifierData *md)
 {
   NodesModifierData *nmd = reinterpret_cast<NodesModifierData *>(md);
@@ -2773,6 +2792,7 @@ static void free_data(ModifierData *md)
 
   MEM_SAFE_FREE(nmd->bake_directory);
   MEM_delete(nmd->runtime);
+  free_runtime_data(nmd->modifier.runtime);
 }
 
 static void required_data_mask(ModifierData * /*md*/, CustomData_MeshMasks *r_cddata_masks)
@@ -2817,7 +2837,7 @@ ModifierTypeInfo modifierType_Nodes = {
     /*depends_on_normals*/ nullptr,
     /*foreach_ID_link*/ blender::foreach_ID_link,
     /*foreach_tex_link*/ blender::foreach_tex_link,
-    /*free_runtime_data*/ nullptr,
+    /*free_runtime_data*/ blender::free_runtime_data,
     /*panel_register*/ blender::panel_register,
     /*blend_write*/ blender::blend_write,
     /*blend_read*/ blender::blend_read,
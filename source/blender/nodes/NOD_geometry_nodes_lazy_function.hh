@@ -20,6 +20,7 @@
  * #lazy_function::Graph is build that can be used when evaluating the graph (e.g. for logging).
  */
 
+#include <mutex>
 #include <variant>
 
 #include "FN_lazy_function_graph.hh"
@@ -29,7 +30,9 @@
 #include "NOD_multi_function.hh"
 
 #include "BLI_compute_context.hh"
+#include "BLI_map.hh"
 #include "BLI_math_quaternion_types.hh"
+#include "BLI_set.hh"
 
 #include "BKE_bake_items.hh"
 #include "BKE_node_tree_zones.hh"
@@ -38,6 +41,10 @@ struct Object;
 struct Depsgraph;
 struct Scene;
 
+namespace blender::geometry {
+class RealizeInstancesCache;
+}
+
 namespace blender::nodes {
 
 using lf::LazyFunction;
@@ -156,6 +163,31 @@ struct GeoNodesSideEffectNodes {
   MultiValueMap<std::pair<ComputeContextHash, int32_t>, int> iterations_by_iteration_zone;
 };
 
+/**
+ * Per-node data that is kept alive between evaluations of the same modifier, so that nodes can
+ * reuse work from the previous evaluation. Entries are identified by the compute context of the
+ * node and its identifier. Entries that were not used in an evaluation are removed afterwards.
+ */
+class GeoNodesModifierNodeCaches : NonCopyable, NonMovable {
+ private:
+  std::mutex mutex_;
+  Map<ComputeContextHash, std::unique_ptr<geometry::RealizeInstancesCache>> realize_instances_;
+  Set<ComputeContextHash> used_;
+
+ public:
+  GeoNodesModifierNodeCaches();
+  ~GeoNodesModifierNodeCaches();
+
+  /**
+   * Get the cache for a specific Realize Instances node. The returned cache must only be used by
+   * that node, it is not safe to use it from multiple threads at the same time.
+   */
+  geometry::RealizeInstancesCache &realize_instances_cache(const ComputeContextHash &node_hash);
+
+  /** Free the caches of all nodes that have not been used since the last call. */
+  void remove_unused();
+};
+
 /**
  * Data that is passed into geometry nodes evaluation from the modifier.
  */
@@ -164,6 +196,8 @@ struct GeoNodesModifierData {
   const Object *self_object = nullptr;
   /** Depsgraph that is evaluating the modifier. */
   Depsgraph *depsgraph = nullptr;
+  /** Caches owned by the modifier that persist between evaluations. May be null. */
+  GeoNodesModifierNodeCaches *node_caches = nullptr;
 };
 
 struct GeoNodesOperatorDepsgraphs {
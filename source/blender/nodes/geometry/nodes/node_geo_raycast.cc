@@ -2,6 +2,8 @@
  *
  * SPDX-License-Identifier: GPL-2.0-or-later */
 
+#include "BLI_array.hh"
+
 #include "DNA_mesh_types.h"
 
 #include "BKE_attribute_math.hh"
@@ -109,22 +111,32 @@ static void raycast_to_mesh(const IndexMask &mask,
   /* We shouldn't be rebuilding the BVH tree when calling this function in parallel. */
   BLI_assert(tree_data.cached);
 
-  mask.foreach_index([&](const int i) {
-    const float ray_length = ray_lengths[i];
-    const float3 ray_origin = ray_origins[i];
-    const float3 ray_direction = ray_directions[i];
-
-    BVHTreeRayHit hit;
-    hit.index = -1;
-    hit.dist = ray_length;
-    if (BLI_bvhtree_ray_cast(tree_data.tree,
-                             ray_origin,
-                             ray_direction,
+  /* Gather the rays so that they can be traced in packets. Neighboring elements usually have
+   * similar rays, keeping them in the order of the mask preserves that coherence. */
+  const int64_t rays_num = mask.size();
+  Array<float3> origins(rays_num);
+  Array<float3> directions(rays_num);
+  Array<BVHTreeRayHit> hits(rays_num);
+  mask.foreach_index(GrainSize(4096), [&](const int64_t i, const int64_t pos) {
+    origins[pos] = ray_origins[i];
+    directions[pos] = ray_directions[i];
+    hits[pos].index = -1;
+    hits[pos].dist = ray_lengths[i];
+  });
+
+  BLI_bvhtree_ray_cast_batch(tree_data.tree,
+                             reinterpret_cast<const float(*)[3]>(origins.data()),
+                             reinterpret_cast<const float(*)[3]>(directions.data()),
+                             int(rays_num),
                              0.0f,
-                             &hit,
+                             hits.data(),
                              tree_data.raycast_callback,
-                             &tree_data) != -1)
-    {
+                             &tree_data,
+                             BVH_RAYCAST_DEFAULT | BVH_RAYCAST_USE_THREADING);
+
+  mask.foreach_index(GrainSize(4096), [&](const int64_t i, const int64_t pos) {
+    const BVHTreeRayHit &hit = hits[pos];
+    if (hit.index != -1) {
       if (!r_hit.is_empty()) {
         r_hit[i] = hit.index >= 0;
       }
@@ -156,7 +168,7 @@ static void raycast_to_mesh(const IndexMask &mask,
         r_hit_normals[i] = float3(0.0f, 0.0f, 0.0f);
       }
       if (!r_hit_distances.is_empty()) {
-        r_hit_distances[i] = ray_length;
+        r_hit_distances[i] = ray_lengths[i];
       }
     }
   });
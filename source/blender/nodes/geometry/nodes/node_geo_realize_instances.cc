@@ -31,6 +31,27 @@ static void node_declare(NodeDeclarationBuilder &b)
   b.add_output<decl::Geometry>("Geometry").propagate_all();
 }
 
+/**
+ * When evaluated by the modifier, each Realize Instances node gets its own cache that is kept
+ * alive between evaluations, so that data that did not change does not have to be copied again.
+ */
+static geometry::RealizeInstancesCache *get_realize_instances_cache(
+    const GeoNodeExecParams &params)
+{
+  const GeoNodesLFUserData *user_data = params.user_data();
+  if (!user_data || !user_data->compute_context) {
+    return nullptr;
+  }
+  const GeoNodesModifierData *modifier_data = user_data->call_data->modifier_data;
+  if (!modifier_data || !modifier_data->node_caches) {
+    return nullptr;
+  }
+  ComputeContextHash node_hash = user_data->compute_context->hash();
+  const int32_t node_identifier = params.node().identifier;
+  node_hash.mix_in(&node_identifier, sizeof(node_identifier));
+  return &modifier_data->node_caches->realize_instances_cache(node_hash);
+}
+
 static void node_geo_exec(GeoNodeExecParams params)
 {
   GeometrySet geometry_set = params.extract_input<GeometrySet>("Geometry");
@@ -78,6 +99,7 @@ static void node_geo_exec(GeoNodeExecParams params)
   options.realize_instance_attributes = true;
   const NodeAttributeFilter attribute_filter = params.get_attribute_filter("Geometry");
   options.attribute_filter = attribute_filter;
+  options.cache = get_realize_instances_cache(params);
   GeometrySet new_geometry_set = geometry::realize_instances(
       geometry_set, options, varied_depth_option);
   new_geometry_set.name = geometry_set.name;
@@ -55,6 +55,7 @@
 
 #include "GEO_extract_elements.hh"
 #include "GEO_join_geometries.hh"
+#include "GEO_realize_instances.hh"
 
 #include <fmt/format.h>
 #include <sstream>
@@ -5967,6 +5968,25 @@ const ID *GeoNodesOperatorDepsgraphs::get_evaluated_id(const ID &id_orig) const
   return nullptr;
 }
 
+GeoNodesModifierNodeCaches::GeoNodesModifierNodeCaches() = default;
+GeoNodesModifierNodeCaches::~GeoNodesModifierNodeCaches() = default;
+
+geometry::RealizeInstancesCache &GeoNodesModifierNodeCaches::realize_instances_cache(
+    const ComputeContextHash &node_hash)
+{
+  std::lock_guard lock{mutex_};
+  used_.add(node_hash);
+  return *realize_instances_.lookup_or_add_cb(
+      node_hash, []() { return std::make_unique<geometry::RealizeInstancesCache>(); });
+}
+
+void GeoNodesModifierNodeCaches::remove_unused()
+{
+  std::lock_guard lock{mutex_};
+  realize_instances_.remove_if([&](const auto &item) { return !used_.contains(item.key); });
+  used_.clear();
+}
+
 const Object *GeoNodesCallData::self_object() const
 {
   if (this->modifier_data) {
@@ -8,7 +8,15 @@
 
 #include <cstddef>
 #include <ctime>
+#include <fcntl.h>
 #include <memory.h>
+#include <string>
+
+#ifndef WIN32
+#  include <unistd.h>
+#else
+#  include <io.h>
+#endif
 
 #include "MEM_guardedalloc.h"
 
@@ -25,7 +33,9 @@
 #include "BLI_fileops.h"
 #include "BLI_fileops_types.h"
 #include "BLI_listbase.h"
+#include "BLI_map.hh"
 #include "BLI_path_utils.hh"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BKE_main.hh"
@@ -46,11 +56,23 @@
  * Each of these files contains header DiskCacheHeader followed by image data.
  * ZLIB compression with user definable level can be used to compress image data(per image)
  * Images are written in order in which they are rendered.
+ * Writing (including compression) happens on a background thread, so that rendering and playback
+ * don't wait for the disk. At most DCACHE_WRITE_QUEUE_MAX images can be waiting to be written.
  * Overwriting of individual entry is not possible.
  * Stored images are deleted by invalidation, or when size of all files exceeds maximum
  * size specified in user preferences.
  * To distinguish 2 blend files with same name, scene->ed->disk_cache_timestamp
  * is used as UID. Blend file can still be copied manually which may cause conflict.
+ *
+ * Known files are kept in least recently used order, so the file to delete when the size limit
+ * is exceeded is always the first one. The list is persisted in an index file (DCACHE_INDEX_NAME)
+ * in the cache directory, so the directory doesn't have to be listed on startup. The index starts
+ * with a snapshot of the list, changes are appended to it as journal records and it is compacted
+ * once the journal grows large. The directory is only listed when the index is missing or invalid.
+ * All Blender instances share the index. Compaction is done while holding a lock file, it replays
+ * the records appended by other instances before writing the snapshot and carries over records
+ * appended while the snapshot was written. Instances that still have the replaced index open
+ * reopen it before appending.
  */
 
 /* Format string:
@@ -58,7 +80,14 @@
 #define DCACHE_FNAME_FORMAT "%d-%dx%d-%d%%(%d)-%d.dcf"
 #define DCACHE_IMAGES_PER_FILE 100
 #define DCACHE_CURRENT_VERSION 2
+#define DCACHE_WRITE_QUEUE_MAX 8
 #define COLORSPACE_NAME_MAX 64 /* XXX: defined in IMB intern. */
+#define DCACHE_INDEX_NAME "seq_cache_index"
+#define DCACHE_INDEX_HEADER "SEQ_DCACHE_INDEX 1"
+/* Compact the index, when there are this many more journal records than cache files. */
+#define DCACHE_INDEX_JOURNAL_MAX 1024
+/* Lock files older than this many seconds are assumed to be left behind by a crashed instance. */
+#define DCACHE_INDEX_LOCK_TIMEOUT 60
 
 struct DiskCacheHeaderEntry {
   uchar encoding;
@@ -73,14 +102,6 @@ struct DiskCacheHeader {
   DiskCacheHeaderEntry entry[DCACHE_IMAGES_PER_FILE];
 };
 
-struct SeqDiskCache {
-  Main *bmain;
-  int64_t timestamp;
-  ListBase files;
-  ThreadMutex read_write_mutex;
-  size_t size_total;
-};
-
 struct DiskCacheFile {
   DiskCacheFile *next, *prev;
   char filepath[FILE_MAX];
@@ -95,6 +116,36 @@ struct DiskCacheFile {
   int start_frame;
 };
 
+struct SeqDiskCache {
+  Main *bmain;
+  int64_t timestamp;
+  /** #DiskCacheFile list, least recently used first. */
+  ListBase files;
+  /** Lookup of #files by lower case file path. */
+  blender::Map<std::string, DiskCacheFile *> files_by_path;
+  ThreadMutex read_write_mutex;
+  size_t size_total;
+
+  /** Index file, opened for appending journal records. */
+  FILE *index_file;
+  /** Number of journal records in the index, that don't correspond to a cache file. */
+  int64_t index_journal_len;
+
+  /** Serial background pool that writes images in the order they were queued. */
+  TaskPool *write_pool;
+  ThreadMutex write_queue_mutex;
+  ThreadCondition write_queue_cond;
+  /** Number of images queued for writing, but not written yet. */
+  int write_queue_len;
+};
+
+struct DiskCacheWriteTask {
+  char filepath[FILE_MAX];
+  float frame_index;
+  /** Referenced image, freed after writing. */
+  ImBuf *ibuf;
+};
+
 static ThreadMutex cache_create_lock = BLI_MUTEX_INITIALIZER;
 
 static const char *seq_disk_cache_base_dir()
@@ -128,6 +179,13 @@ bool seq_disk_cache_is_enabled(Main *bmain)
           bmain->filepath[0] != '\0');
 }
 
+static std::string seq_disk_cache_path_key(const char *filepath)
+{
+  std::string key = filepath;
+  BLI_str_tolower_ascii(key.data(), key.size());
+  return key;
+}
+
 static DiskCacheFile *seq_disk_cache_add_file_to_list(SeqDiskCache *disk_cache,
                                                       const char *filepath)
 {
@@ -149,14 +207,35 @@ static DiskCacheFile *seq_disk_cache_add_file_to_list(SeqDiskCache *disk_cache,
          &cache_file->start_frame);
   cache_file->start_frame *= DCACHE_IMAGES_PER_FILE;
   BLI_addtail(&disk_cache->files, cache_file);
+  disk_cache->files_by_path.add_overwrite(seq_disk_cache_path_key(filepath), cache_file);
   return cache_file;
 }
 
+static void seq_disk_cache_remove_file_from_list(SeqDiskCache *disk_cache, DiskCacheFile *file)
+{
+  disk_cache->size_total -= file->fstat.st_size;
+  disk_cache->files_by_path.remove(seq_disk_cache_path_key(file->filepath));
+  BLI_remlink(&disk_cache->files, file);
+  MEM_freeN(file);
+}
+
+static void seq_disk_cache_clear_files(SeqDiskCache *disk_cache)
+{
+  BLI_freelistN(&disk_cache->files);
+  disk_cache->files_by_path.clear();
+  disk_cache->size_total = 0;
+}
+
+static DiskCacheFile *seq_disk_cache_get_file_entry_by_path(SeqDiskCache *disk_cache,
+                                                            const char *filepath)
+{
+  return disk_cache->files_by_path.lookup_default(seq_disk_cache_path_key(filepath), nullptr);
+}
+
 static void seq_disk_cache_get_files(SeqDiskCache *disk_cache, const char *dirpath)
 {
   direntry *filelist, *fl;
   uint i;
-  disk_cache->size_total = 0;
 
   const int filelist_num = BLI_filelist_dir_contents(dirpath, &filelist);
   i = filelist_num;
@@ -193,86 +272,357 @@ static void seq_disk_cache_get_files(SeqDiskCache *disk_cache, const char *dirpa
   BLI_filelist_free(filelist, filelist_num);
 }
 
-static DiskCacheFile *seq_disk_cache_get_oldest_file(SeqDiskCache *disk_cache)
+static int seq_disk_cache_file_mtime_cmp(const void *a, const void *b)
 {
-  DiskCacheFile *oldest_file = static_cast<DiskCacheFile *>(disk_cache->files.first);
-  if (oldest_file == nullptr) {
-    return nullptr;
+  const DiskCacheFile *file_a = static_cast<const DiskCacheFile *>(a);
+  const DiskCacheFile *file_b = static_cast<const DiskCacheFile *>(b);
+  if (file_a->fstat.st_mtime < file_b->fstat.st_mtime) {
+    return -1;
+  }
+  return file_a->fstat.st_mtime > file_b->fstat.st_mtime;
+}
+
+static void seq_disk_cache_get_index_path(char *filepath, size_t filepath_maxncpy)
+{
+  BLI_path_join(filepath, filepath_maxncpy, seq_disk_cache_base_dir(), DCACHE_INDEX_NAME);
+}
+
+/* Set file size and mark it as most recently used. */
+static void seq_disk_cache_touch_file_entry(SeqDiskCache *disk_cache,
+                                            DiskCacheFile *cache_file,
+                                            const int64_t size)
+{
+  disk_cache->size_total += size - cache_file->fstat.st_size;
+  cache_file->fstat.st_size = size;
+  BLI_remlink(&disk_cache->files, cache_file);
+  BLI_addtail(&disk_cache->files, cache_file);
+}
+
+static bool seq_disk_cache_index_read_header(FILE *file)
+{
+  char line[sizeof(DCACHE_INDEX_HEADER) + 1];
+  return fgets(line, sizeof(line), file) && STREQ(line, DCACHE_INDEX_HEADER "\n");
+}
+
+/**
+ * Replay index records from the current position of the file to its end, return false if there
+ * is an invalid record. Records are `U <size> <filepath>` for written or read files and
+ * `D <filepath>` for deleted files. Replayed records are also appended to `copy_file`, if given.
+ */
+static bool seq_disk_cache_index_replay(SeqDiskCache *disk_cache,
+                                        FILE *file,
+                                        FILE *copy_file,
+                                        int64_t *r_records_num)
+{
+  char line[FILE_MAX + 32];
+  while (fgets(line, sizeof(line), file)) {
+    const size_t line_len = strlen(line);
+    if (line_len == 0 || line[line_len - 1] != '\n') {
+      /* Record is only partially written, it is read again when replaying the rest of the file. */
+      BLI_fseek(file, -int64_t(line_len), SEEK_CUR);
+      break;
+    }
+    if (copy_file) {
+      fputs(line, copy_file);
+    }
+    line[line_len - 1] = '\0';
+    (*r_records_num)++;
+
+    int64_t size;
+    int path_offset = 0;
+    if (sscanf(line, "U %" SCNd64 " %n", &size, &path_offset) == 1 && path_offset != 0) {
+      const char *cache_filepath = line + path_offset;
+      DiskCacheFile *cache_file = seq_disk_cache_get_file_entry_by_path(disk_cache,
+                                                                        cache_filepath);
+      if (!cache_file) {
+        cache_file = seq_disk_cache_add_file_to_list(disk_cache, cache_filepath);
+      }
+      seq_disk_cache_touch_file_entry(disk_cache, cache_file, size);
+    }
+    else if (STRPREFIX(line, "D ")) {
+      DiskCacheFile *cache_file = seq_disk_cache_get_file_entry_by_path(disk_cache, line + 2);
+      if (cache_file) {
+        seq_disk_cache_remove_file_from_list(disk_cache, cache_file);
+      }
+    }
+    else {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Create lock file, so only one Blender instance replaces the shared index at a time.
+ * Return false if another instance holds the lock.
+ */
+static bool seq_disk_cache_index_lock(const char *filepath_lock)
+{
+  for (int attempt = 0; attempt < 2; attempt++) {
+    const int file = BLI_open(filepath_lock, O_BINARY | O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if (file != -1) {
+      close(file);
+      return true;
+    }
+
+    BLI_stat_t lock_stat;
+    if (BLI_stat(filepath_lock, &lock_stat) == -1 ||
+        time(nullptr) - lock_stat.st_mtime < DCACHE_INDEX_LOCK_TIMEOUT)
+    {
+      return false;
+    }
+    /* Lock file was left behind by an instance that crashed. */
+    BLI_delete(filepath_lock, false, false);
+  }
+  return false;
+}
+
+/**
+ * Write snapshot of the file list to the index, this discards all journal records.
+ *
+ * When `merge` is true, the file list is rebuilt from the index first, so that files written or
+ * deleted by other instances aren't dropped. Records they append to the replaced index while the
+ * snapshot is written are carried over to the new index.
+ */
+static void seq_disk_cache_index_write(SeqDiskCache *disk_cache, const bool merge)
+{
+  char filepath[FILE_MAX];
+  char filepath_temp[FILE_MAX];
+  char filepath_lock[FILE_MAX];
+  seq_disk_cache_get_index_path(filepath, sizeof(filepath));
+  SNPRINTF(filepath_temp, "%s@", filepath);
+  SNPRINTF(filepath_lock, "%s.lock", filepath);
+
+  BLI_file_ensure_parent_dir_exists(filepath_lock);
+  if (!seq_disk_cache_index_lock(filepath_lock)) {
+    /* Another instance is replacing the index, keep appending records to it. */
+    if (!disk_cache->index_file) {
+      disk_cache->index_file = BLI_fopen(filepath, "ab");
+    }
+    disk_cache->index_journal_len = 0;
+    return;
+  }
+
+  if (disk_cache->index_file) {
+    fclose(disk_cache->index_file);
+    disk_cache->index_file = nullptr;
+  }
+
+  FILE *file_prev = merge ? BLI_fopen(filepath, "rb") : nullptr;
+  if (file_prev) {
+    int64_t records_num = 0;
+    seq_disk_cache_clear_files(disk_cache);
+    if (!seq_disk_cache_index_read_header(file_prev) ||
+        !seq_disk_cache_index_replay(disk_cache, file_prev, nullptr, &records_num))
+    {
+      fclose(file_prev);
+      file_prev = nullptr;
+      seq_disk_cache_clear_files(disk_cache);
+      seq_disk_cache_get_files(disk_cache, seq_disk_cache_base_dir());
+      BLI_listbase_sort(&disk_cache->files, seq_disk_cache_file_mtime_cmp);
+    }
+  }
+
+  FILE *file = BLI_fopen(filepath_temp, "wb");
+  if (file) {
+    fprintf(file, "%s\n", DCACHE_INDEX_HEADER);
+    LISTBASE_FOREACH (DiskCacheFile *, cache_file, &disk_cache->files) {
+      fprintf(
+          file, "U %" PRId64 " %s\n", int64_t(cache_file->fstat.st_size), cache_file->filepath);
+    }
+  }
+
+#ifdef WIN32
+  /* Open files can't be replaced, so other instances can't have the replaced index open either. */
+  if (file_prev) {
+    fclose(file_prev);
+    file_prev = nullptr;
+  }
+#endif
+
+  const bool is_replaced = file && fclose(file) == 0 &&
+                           BLI_rename_overwrite(filepath_temp, filepath) == 0;
+  if (!is_replaced) {
+    BLI_delete(filepath_temp, false, false);
   }
-  for (DiskCacheFile *cache_file = oldest_file->next; cache_file; cache_file = cache_file->next) {
-    if (cache_file->fstat.st_mtime < oldest_file->fstat.st_mtime) {
-      oldest_file = cache_file;
+
+  disk_cache->index_file = BLI_fopen(filepath, "ab");
+  disk_cache->index_journal_len = 0;
+  if (file_prev) {
+    if (is_replaced && disk_cache->index_file) {
+      seq_disk_cache_index_replay(
+          disk_cache, file_prev, disk_cache->index_file, &disk_cache->index_journal_len);
+      fflush(disk_cache->index_file);
     }
+    fclose(file_prev);
+  }
+
+  BLI_delete(filepath_lock, false, false);
+}
+
+/* Reopen the index, if it was replaced by another instance while compacting it. */
+static void seq_disk_cache_index_reopen_if_replaced(SeqDiskCache *disk_cache)
+{
+  char filepath[FILE_MAX];
+  seq_disk_cache_get_index_path(filepath, sizeof(filepath));
+
+  BLI_stat_t index_stat;
+  if (BLI_stat(filepath, &index_stat) == -1) {
+    /* Index was deleted with the cache directory. */
+    seq_disk_cache_index_write(disk_cache, false);
+    return;
+  }
+
+  BLI_stat_t open_stat;
+  if (BLI_fstat(fileno(disk_cache->index_file), &open_stat) == 0 &&
+      open_stat.st_ino == index_stat.st_ino && open_stat.st_dev == index_stat.st_dev)
+  {
+    return;
   }
 
-  return oldest_file;
+  fclose(disk_cache->index_file);
+  disk_cache->index_file = BLI_fopen(filepath, "ab");
+  disk_cache->index_journal_len = 0;
+}
+
+static void seq_disk_cache_index_append(SeqDiskCache *disk_cache,
+                                        const DiskCacheFile *cache_file,
+                                        const bool is_delete)
+{
+  if (disk_cache->index_file) {
+    seq_disk_cache_index_reopen_if_replaced(disk_cache);
+  }
+  if (!disk_cache->index_file) {
+    return;
+  }
+
+  if (is_delete) {
+    fprintf(disk_cache->index_file, "D %s\n", cache_file->filepath);
+  }
+  else {
+    fprintf(disk_cache->index_file,
+            "U %" PRId64 " %s\n",
+            int64_t(cache_file->fstat.st_size),
+            cache_file->filepath);
+  }
+  fflush(disk_cache->index_file);
+
+  /* Deleting a file removes its update record from the snapshot as well. */
+  disk_cache->index_journal_len += is_delete ? 2 : 1;
+}
+
+/**
+ * Compact the index once the journal grows large. This rebuilds the file list, so it must not be
+ * called while #DiskCacheFile pointers are in use.
+ */
+static void seq_disk_cache_index_compact_if_needed(SeqDiskCache *disk_cache)
+{
+  if (disk_cache->index_journal_len > disk_cache->files_by_path.size() + DCACHE_INDEX_JOURNAL_MAX)
+  {
+    seq_disk_cache_index_write(disk_cache, true);
+  }
+}
+
+/* Replay the index, return false if there is no valid index. */
+static bool seq_disk_cache_index_read(SeqDiskCache *disk_cache)
+{
+  char filepath[FILE_MAX];
+  seq_disk_cache_get_index_path(filepath, sizeof(filepath));
+
+  FILE *file = BLI_fopen(filepath, "rb");
+  if (!file) {
+    return false;
+  }
+
+  int64_t records_num = 0;
+  const bool is_valid = seq_disk_cache_index_read_header(file) &&
+                        seq_disk_cache_index_replay(disk_cache, file, nullptr, &records_num);
+  fclose(file);
+
+  if (!is_valid) {
+    seq_disk_cache_clear_files(disk_cache);
+    return false;
+  }
+
+  disk_cache->index_file = BLI_fopen(filepath, "ab");
+  disk_cache->index_journal_len = records_num - disk_cache->files_by_path.size();
+  seq_disk_cache_index_compact_if_needed(disk_cache);
+  return true;
+}
+
+/* List cache directory and rebuild the index from its content. */
+static void seq_disk_cache_rescan(SeqDiskCache *disk_cache)
+{
+  seq_disk_cache_clear_files(disk_cache);
+  seq_disk_cache_get_files(disk_cache, seq_disk_cache_base_dir());
+  BLI_listbase_sort(&disk_cache->files, seq_disk_cache_file_mtime_cmp);
+  seq_disk_cache_index_write(disk_cache, false);
 }
 
 static void seq_disk_cache_delete_file(SeqDiskCache *disk_cache, DiskCacheFile *file)
 {
-  disk_cache->size_total -= file->fstat.st_size;
   BLI_delete(file->filepath, false, false);
-  BLI_remlink(&disk_cache->files, file);
-  MEM_freeN(file);
+  seq_disk_cache_index_append(disk_cache, file, true);
+  seq_disk_cache_remove_file_from_list(disk_cache, file);
 }
 
-bool seq_disk_cache_enforce_limits(SeqDiskCache *disk_cache)
+static bool seq_disk_cache_enforce_limits(SeqDiskCache *disk_cache)
 {
   BLI_mutex_lock(&disk_cache->read_write_mutex);
   while (disk_cache->size_total > seq_disk_cache_size_limit()) {
-    DiskCacheFile *oldest_file = seq_disk_cache_get_oldest_file(disk_cache);
+    DiskCacheFile *oldest_file = static_cast<DiskCacheFile *>(disk_cache->files.first);
 
     if (!oldest_file) {
       /* We shouldn't enforce limits with no files, do re-scan. */
-      seq_disk_cache_get_files(disk_cache, seq_disk_cache_base_dir());
-      continue;
-    }
-
-    if (BLI_exists(oldest_file->filepath) == 0) {
-      /* File may have been manually deleted during runtime, do re-scan. */
-      BLI_freelistN(&disk_cache->files);
-      seq_disk_cache_get_files(disk_cache, seq_disk_cache_base_dir());
+      seq_disk_cache_rescan(disk_cache);
+      if (BLI_listbase_is_empty(&disk_cache->files)) {
+        break;
+      }
       continue;
     }
 
+    /* File may also have been manually deleted during runtime, this only removes the entry. */
     seq_disk_cache_delete_file(disk_cache, oldest_file);
   }
+  seq_disk_cache_index_compact_if_needed(disk_cache);
   BLI_mutex_unlock(&disk_cache->read_write_mutex);
 
   return true;
 }
 
-static DiskCacheFile *seq_disk_cache_get_file_entry_by_path(SeqDiskCache *disk_cache,
-                                                            const char *filepath)
+/* Get file entry, files not known yet may have been written by another Blender instance. */
+static DiskCacheFile *seq_disk_cache_ensure_file_entry(SeqDiskCache *disk_cache,
+                                                       const char *filepath)
 {
-  DiskCacheFile *cache_file = static_cast<DiskCacheFile *>(disk_cache->files.first);
-
-  for (; cache_file; cache_file = cache_file->next) {
-    if (BLI_strcasecmp(cache_file->filepath, filepath) == 0) {
-      return cache_file;
-    }
+  DiskCacheFile *cache_file = seq_disk_cache_get_file_entry_by_path(disk_cache, filepath);
+  if (cache_file) {
+    return cache_file;
   }
 
-  return nullptr;
+  cache_file = seq_disk_cache_add_file_to_list(disk_cache, filepath);
+  if (BLI_stat(filepath, &cache_file->fstat) == -1) {
+    memset(&cache_file->fstat, 0, sizeof(BLI_stat_t));
+  }
+  disk_cache->size_total += cache_file->fstat.st_size;
+  return cache_file;
 }
 
-/* Update file size and timestamp. */
+/* Update file size and mark it as most recently used. */
 static void seq_disk_cache_update_file(SeqDiskCache *disk_cache, const char *filepath)
 {
-  DiskCacheFile *cache_file;
-  int64_t size_before;
-  int64_t size_after;
-
-  cache_file = seq_disk_cache_get_file_entry_by_path(disk_cache, filepath);
-  size_before = cache_file->fstat.st_size;
+  DiskCacheFile *cache_file = seq_disk_cache_ensure_file_entry(disk_cache, filepath);
+  const int64_t size_before = cache_file->fstat.st_size;
 
   if (BLI_stat(filepath, &cache_file->fstat) == -1) {
     BLI_assert(false);
     memset(&cache_file->fstat, 0, sizeof(BLI_stat_t));
   }
 
-  size_after = cache_file->fstat.st_size;
-  disk_cache->size_total += size_after - size_before;
+  const int64_t size_after = cache_file->fstat.st_size;
+  cache_file->fstat.st_size = size_before;
+  seq_disk_cache_touch_file_entry(disk_cache, cache_file, size_after);
+  seq_disk_cache_index_append(disk_cache, cache_file, false);
+  seq_disk_cache_index_compact_if_needed(disk_cache);
 }
 
 /* Path format:
@@ -337,6 +687,21 @@ static void seq_disk_cache_create_version_file(const char *filepath)
   }
 }
 
+/* Remove entries of files in deleted directory. */
+static void seq_disk_cache_remove_dir_from_list(SeqDiskCache *disk_cache, const char *dirpath)
+{
+  char dirpath_slash[FILE_MAX];
+  STRNCPY(dirpath_slash, dirpath);
+  BLI_path_slash_ensure(dirpath_slash, sizeof(dirpath_slash));
+
+  LISTBASE_FOREACH_MUTABLE (DiskCacheFile *, cache_file, &disk_cache->files) {
+    if (BLI_strncasecmp(cache_file->filepath, dirpath_slash, strlen(dirpath_slash)) == 0) {
+      seq_disk_cache_index_append(disk_cache, cache_file, true);
+      seq_disk_cache_remove_file_from_list(disk_cache, cache_file);
+    }
+  }
+}
+
 static void seq_disk_cache_handle_versioning(SeqDiskCache *disk_cache)
 {
   char dirpath[FILE_MAX];
@@ -359,6 +724,7 @@ static void seq_disk_cache_handle_versioning(SeqDiskCache *disk_cache)
 
     if (version != DCACHE_CURRENT_VERSION) {
       BLI_delete(dirpath, true, true);
+      seq_disk_cache_remove_dir_from_list(disk_cache, dirpath);
       seq_disk_cache_create_version_file(path_version_file);
     }
   }
@@ -367,6 +733,16 @@ static void seq_disk_cache_handle_versioning(SeqDiskCache *disk_cache)
   }
 }
 
+/* Wait until all queued images are written. */
+static void seq_disk_cache_write_queue_flush(SeqDiskCache *disk_cache)
+{
+  BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  while (disk_cache->write_queue_len > 0) {
+    BLI_condition_wait(&disk_cache->write_queue_cond, &disk_cache->write_queue_mutex);
+  }
+  BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+}
+
 static void seq_disk_cache_delete_invalid_files(SeqDiskCache *disk_cache,
                                                 Scene *scene,
                                                 Sequence *seq,
@@ -403,12 +779,16 @@ void seq_disk_cache_invalidate(SeqDiskCache *disk_cache,
   int start;
   int end;
 
+  /* Queued images may belong to the invalidated range. */
+  seq_disk_cache_write_queue_flush(disk_cache);
+
   BLI_mutex_lock(&disk_cache->read_write_mutex);
 
   start = SEQ_time_left_handle_frame_get(scene, seq_changed) - DCACHE_IMAGES_PER_FILE;
   end = SEQ_time_right_handle_frame_get(scene, seq_changed);
 
   seq_disk_cache_delete_invalid_files(disk_cache, scene, seq, invalidate_types, start, end);
+  seq_disk_cache_index_compact_if_needed(disk_cache);
 
   BLI_mutex_unlock(&disk_cache->read_write_mutex);
 }
@@ -478,7 +858,7 @@ static size_t seq_disk_cache_write_header(FILE *file, const DiskCacheHeader *hea
   return fwrite(header, sizeof(*header), 1, file);
 }
 
-static int seq_disk_cache_add_header_entry(const SeqCacheKey *key,
+static int seq_disk_cache_add_header_entry(const float frame_index,
                                            ImBuf *ibuf,
                                            DiskCacheHeader *header)
 {
@@ -513,7 +893,7 @@ static int seq_disk_cache_add_header_entry(const SeqCacheKey *key,
   }
 
   header->entry[i].offset = offset;
-  header->entry[i].frameno = key->frame_index;
+  header->entry[i].frameno = frame_index;
 
   /* Store colorspace name of ibuf. */
   const char *colorspace_name;
@@ -541,13 +921,13 @@ static int seq_disk_cache_get_header_entry(const SeqCacheKey *key, const DiskCac
   return -1;
 }
 
-bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf *ibuf)
+static bool seq_disk_cache_write_file_ex(SeqDiskCache *disk_cache,
+                                         const char *filepath,
+                                         const float frame_index,
+                                         ImBuf *ibuf)
 {
   BLI_mutex_lock(&disk_cache->read_write_mutex);
 
-  char filepath[FILE_MAX];
-
-  seq_disk_cache_get_file_path(disk_cache, key, filepath, sizeof(filepath));
   BLI_file_ensure_parent_dir_exists(filepath);
 
   /* Touch the file. */
@@ -558,10 +938,9 @@ bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf
       BLI_mutex_unlock(&disk_cache->read_write_mutex);
       return false;
     }
-    seq_disk_cache_add_file_to_list(disk_cache, filepath);
   }
 
-  DiskCacheFile *cache_file = seq_disk_cache_get_file_entry_by_path(disk_cache, filepath);
+  DiskCacheFile *cache_file = seq_disk_cache_ensure_file_entry(disk_cache, filepath);
   DiskCacheHeader header;
   memset(&header, 0, sizeof(header));
   /* The file may be empty when touched (above).
@@ -572,7 +951,7 @@ bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf
     BLI_mutex_unlock(&disk_cache->read_write_mutex);
     return false;
   }
-  int entry_index = seq_disk_cache_add_header_entry(key, ibuf, &header);
+  int entry_index = seq_disk_cache_add_header_entry(frame_index, ibuf, &header);
 
   size_t bytes_written = deflate_imbuf_to_file(
       ibuf, file, seq_disk_cache_compression_level(), &header.entry[entry_index]);
@@ -590,10 +969,49 @@ bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf
     return true;
   }
 
+  fclose(file);
   BLI_mutex_unlock(&disk_cache->read_write_mutex);
   return false;
 }
 
+static void seq_disk_cache_write_task(TaskPool *__restrict pool, void *taskdata)
+{
+  SeqDiskCache *disk_cache = static_cast<SeqDiskCache *>(BLI_task_pool_user_data(pool));
+  DiskCacheWriteTask *task = static_cast<DiskCacheWriteTask *>(taskdata);
+
+  if (seq_disk_cache_write_file_ex(disk_cache, task->filepath, task->frame_index, task->ibuf)) {
+    seq_disk_cache_enforce_limits(disk_cache);
+  }
+  IMB_freeImBuf(task->ibuf);
+
+  BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  disk_cache->write_queue_len--;
+  BLI_condition_notify_all(&disk_cache->write_queue_cond);
+  BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+}
+
+bool seq_disk_cache_write_file(SeqDiskCache *disk_cache, SeqCacheKey *key, ImBuf *ibuf)
+{
+  DiskCacheWriteTask *task = static_cast<DiskCacheWriteTask *>(
+      MEM_callocN(sizeof(DiskCacheWriteTask), "DiskCacheWriteTask"));
+  /* The key may be freed before the image is written, so resolve the path now. */
+  seq_disk_cache_get_file_path(disk_cache, key, task->filepath, sizeof(task->filepath));
+  task->frame_index = key->frame_index;
+  IMB_refImBuf(ibuf);
+  task->ibuf = ibuf;
+
+  /* Only block when the writer falls far behind, this limits the memory used by queued images. */
+  BLI_mutex_lock(&disk_cache->write_queue_mutex);
+  while (disk_cache->write_queue_len >= DCACHE_WRITE_QUEUE_MAX) {
+    BLI_condition_wait(&disk_cache->write_queue_cond, &disk_cache->write_queue_mutex);
+  }
+  disk_cache->write_queue_len++;
+  BLI_mutex_unlock(&disk_cache->write_queue_mutex);
+
+  BLI_task_pool_push(disk_cache->write_pool, seq_disk_cache_write_task, task, true, nullptr);
+  return true;
+}
+
 ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *key)
 {
   BLI_mutex_lock(&disk_cache->read_write_mutex);
@@ -666,12 +1084,16 @@ ImBuf *seq_disk_cache_read_file(SeqDiskCache *disk_cache, SeqCacheKey *key)
 
 SeqDiskCache *seq_disk_cache_create(Main *bmain, Scene *scene)
 {
-  SeqDiskCache *disk_cache = static_cast<SeqDiskCache *>(
-      MEM_callocN(sizeof(SeqDiskCache), "SeqDiskCache"));
+  SeqDiskCache *disk_cache = MEM_new<SeqDiskCache>("SeqDiskCache");
   disk_cache->bmain = bmain;
   BLI_mutex_init(&disk_cache->read_write_mutex);
+  BLI_mutex_init(&disk_cache->write_queue_mutex);
+  BLI_condition_init(&disk_cache->write_queue_cond);
+  disk_cache->write_pool = BLI_task_pool_create_background_serial(disk_cache, TASK_PRIORITY_LOW);
+  if (!seq_disk_cache_index_read(disk_cache)) {
+    seq_disk_cache_rescan(disk_cache);
+  }
   seq_disk_cache_handle_versioning(disk_cache);
-  seq_disk_cache_get_files(disk_cache, seq_disk_cache_base_dir());
   disk_cache->timestamp = scene->ed->disk_cache_timestamp;
   BLI_mutex_unlock(&cache_create_lock);
   return disk_cache;
@@ -679,7 +1101,14 @@ SeqDiskCache *seq_disk_cache_create(Main *bmain, Scene *scene)
 
 void seq_disk_cache_free(SeqDiskCache *disk_cache)
 {
-  BLI_freelistN(&disk_cache->files);
+  BLI_task_pool_work_and_wait(disk_cache->write_pool);
+  BLI_task_pool_free(disk_cache->write_pool);
+  BLI_condition_end(&disk_cache->write_queue_cond);
+  BLI_mutex_end(&disk_cache->write_queue_mutex);
+  if (disk_cache->index_file) {
+    fclose(disk_cache->index_file);
+  }
+  seq_disk_cache_clear_files(disk_cache);
   BLI_mutex_end(&disk_cache->read_write_mutex);
-  MEM_freeN(disk_cache);
+  MEM_delete(disk_cache);
 }
@@ -916,6 +916,9 @@ static void wm_read_callback_post_wrapper(bContext *C, const char *filepath, con
 static void file_read_reports_finalize(BlendFileReadReport *bf_reports)
 {
   double duration_whole_minutes, duration_whole_seconds;
+  double duration_read_data_minutes, duration_read_data_seconds;
+  double duration_versioning_minutes, duration_versioning_seconds;
+  double duration_lib_link_minutes, duration_lib_link_seconds;
   double duration_libraries_minutes, duration_libraries_seconds;
   double duration_lib_override_minutes, duration_lib_override_seconds;
   double duration_lib_override_resync_minutes, duration_lib_override_resync_seconds;
@@ -928,6 +931,24 @@ static void file_read_reports_finalize(BlendFileReadReport *bf_reports)
                                   &duration_whole_minutes,
                                   &duration_whole_seconds,
                                   nullptr);
+  BLI_math_time_seconds_decompose(bf_reports->duration.read_data,
+                                  nullptr,
+                                  nullptr,
+                                  &duration_read_data_minutes,
+                                  &duration_read_data_seconds,
+                                  nullptr);
+  BLI_math_time_seconds_decompose(bf_reports->duration.versioning,
+                                  nullptr,
+                                  nullptr,
+                                  &duration_versioning_minutes,
+                                  &duration_versioning_seconds,
+                                  nullptr);
+  BLI_math_time_seconds_decompose(bf_reports->duration.lib_link,
+                                  nullptr,
+                                  nullptr,
+                                  &duration_lib_link_minutes,
+                                  &duration_lib_link_seconds,
+                                  nullptr);
   BLI_math_time_seconds_decompose(bf_reports->duration.libraries,
                                   nullptr,
                                   nullptr,
@@ -955,11 +976,26 @@ static void file_read_reports_finalize(BlendFileReadReport *bf_reports)
 
   CLOG_INFO(
       &LOG, 0, "Blender file read in %.0fm%.2fs", duration_whole_minutes, duration_whole_seconds);
+  CLOG_INFO(&LOG,
+            0,
+            " * Reading data-blocks: %.0fm%.2fs",
+            duration_read_data_minutes,
+            duration_read_data_seconds);
+  CLOG_INFO(&LOG,
+            0,
+            " * Versioning: %.0fm%.2fs",
+            duration_versioning_minutes,
+            duration_versioning_seconds);
   CLOG_INFO(&LOG,
             0,
             " * Loading libraries: %.0fm%.2fs",
             duration_libraries_minutes,
             duration_libraries_seconds);
+  CLOG_INFO(&LOG,
+            0,
+            "   * Linking data-blocks: %.0fm%.2fs",
+            duration_lib_link_minutes,
+            duration_lib_link_seconds);
   CLOG_INFO(&LOG,
             0,
             " * Applying overrides: %.0fm%.2fs",
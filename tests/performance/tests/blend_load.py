@@ -3,6 +3,7 @@
 # SPDX-License-Identifier: Apache-2.0
 
 import api
+import re
 
 
 def _run(filepath):
@@ -33,7 +34,21 @@ class BlendLoadTest(api.Test):
         return "blend_load"
 
     def run(self, env, device_id):
-        result, _ = env.run_in_blender(_run, str(self.filepath))
+        # Per-phase timings are only available from the file reading log.
+        result, lines = env.run_in_blender(_run, str(self.filepath), ['--log', 'wm.files'])
+
+        # Parse timings of the last file load, which is the measured one.
+        phases = {
+            'read_data': 'Reading data-blocks',
+            'versioning': 'Versioning',
+            'lib_link': 'Linking data-blocks',
+        }
+        for key, label in phases.items():
+            for line in lines:
+                match = re.search(label + r': (\d+)m([\d.]+)s', line)
+                if match:
+                    result[key] = int(match.group(1)) * 60 + float(match.group(2))
+
         return result
 
 
@@ -0,0 +1,46 @@
+# SPDX-FileCopyrightText: 2024 Blender Authors
+#
+# SPDX-License-Identifier: Apache-2.0
+
+import api
+import glob
+import os
+import pathlib
+
+
+def _run(filepath):
+    import bpy
+    import time
+
+    # Import once to ensure the file is cached by the OS.
+    bpy.ops.wm.obj_import(filepath=filepath)
+    bpy.ops.wm.read_homefile(use_empty=True, use_factory_startup=True)
+
+    # Measure importing the second time.
+    start_time = time.time()
+    bpy.ops.wm.obj_import(filepath=filepath)
+    elapsed_time = time.time() - start_time
+
+    megabytes = os.path.getsize(filepath) / (1024 * 1024)
+    result = {'time': elapsed_time, 'throughput': megabytes / elapsed_time}
+    return result
+
+
+class OBJImportTest(api.Test):
+    def __init__(self, filepath):
+        self.filepath = filepath
+
+    def name(self):
+        return self.filepath.stem
+
+    def category(self):
+        return "obj_import"
+
+    def run(self, env, device_id):
+        result, _ = env.run_in_blender(_run, str(self.filepath))
+        return result
+
+
+def generate(env):
+    filepaths = glob.iglob(str(env.benchmarks_dir / 'obj_import' / '*.obj'))
+    return [OBJImportTest(pathlib.Path(filepath)) for filepath in filepaths]